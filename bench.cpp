@@ -0,0 +1,359 @@
+#include "configs.h"
+#include "extent_manager.h"
+#include "extent_object_stripe.h"
+#include "extent_stack.h"
+#include "object_packer.h"
+#include "samplers.h"
+#include "stripe_manager.h"
+#include "stripers.h"
+#include "benchmark/benchmark.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+/*
+ * Microbenchmarks for the components on the simulation hot path. Each one
+ * is parameterized over sizes seen in a default simulator run so that an
+ * optimization can be measured in isolation before running the full
+ * simulation.
+ */
+
+static const int ext_size = 3 * 1024;
+static const int stripe_width = 14;
+
+/*
+ * Heap allocations made by the process, counted by the operator new
+ * replacement in bench_allocs.cpp so that the benchmarks can report
+ * allocations per object or per cycle.
+ */
+extern std::atomic<size_t> num_allocs;
+
+/****************************************
+ * Extent stacks
+ ****************************************/
+static vector<ext_ptr> create_extents(ExtentManager &e_m, int num_exts) {
+  vector<ext_ptr> exts;
+  exts.reserve(num_exts);
+  for (int i = 0; i < num_exts; i++)
+    exts.push_back(e_m.create_extent());
+  return exts;
+}
+
+template <typename Stack>
+static void BM_ExtentStackPushPop(benchmark::State &state) {
+  const int num_exts = state.range(0);
+  auto s_m = make_shared<StripeManager>(7, 2, 2, 2, 0.0);
+  ExtentManager e_m = ExtentManager(ext_size, nullptr);
+  vector<ext_ptr> exts = create_extents(e_m, num_exts);
+  for (auto _ : state) {
+    auto e_s = make_shared<Stack>(s_m);
+    for (int i = 0; i < num_exts; i++)
+      e_s->add_extent(i % 100, exts[i]);
+    while (e_s->num_stripes(stripe_width) > 0)
+      benchmark::DoNotOptimize(e_s->pop_stripe_num_exts(stripe_width));
+  }
+  state.SetItemsProcessed(state.iterations() * num_exts);
+}
+BENCHMARK_TEMPLATE(BM_ExtentStackPushPop, SingleExtentStack<>)
+    ->RangeMultiplier(4)
+    ->Range(1 << 10, 1 << 16);
+BENCHMARK_TEMPLATE(BM_ExtentStackPushPop, MultiExtentStack)
+    ->RangeMultiplier(4)
+    ->Range(1 << 10, 1 << 16);
+
+static void BM_WholeObjectExtentStackPushPop(benchmark::State &state) {
+  const int num_exts = state.range(0);
+  auto s_m = make_shared<StripeManager>(7, 2, 2, 2, 0.0);
+  ExtentManager e_m = ExtentManager(ext_size, nullptr);
+  vector<ext_ptr> exts = create_extents(e_m, num_exts);
+  // Objects spanning 1 to 4 extents
+  vector<stack_val> objs;
+  for (int i = 0; i < num_exts;) {
+    int len = min(1 + (i / 7) % 4, num_exts - i);
+    objs.emplace_back(exts.begin() + i, exts.begin() + i + len);
+    i += len;
+  }
+  for (auto _ : state) {
+    auto e_s = make_shared<WholeObjectExtentStack>(s_m);
+    for (auto &obj : objs)
+      e_s->add_extent(obj);
+    while (e_s->num_stripes(stripe_width) > 0)
+      benchmark::DoNotOptimize(e_s->pop_stripe_num_exts(stripe_width));
+  }
+  state.SetItemsProcessed(state.iterations() * num_exts);
+}
+BENCHMARK(BM_WholeObjectExtentStackPushPop)
+    ->RangeMultiplier(4)
+    ->Range(1 << 10, 1 << 16);
+
+/****************************************
+ * Object packers
+ ****************************************/
+/*
+ * Packs range(0) new objects into extents and reports the heap allocations
+ * per packed object. Besides the extents it creates, packing allocates an
+ * entry in the object map of the extent and a node in the extent list of
+ * the object for every object it packs.
+ */
+template <typename Packer, typename Stack>
+static void BM_PackObjects(benchmark::State &state) {
+  const int num_objs = state.range(0);
+  auto s_m = make_shared<StripeManager>(7, 2, 2, 2, 0.0);
+  size_t allocs = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto o_m = make_shared<ObjectManager>(
+        make_shared<EventManager>(),
+        make_shared<DeterministicDistributionSampler>(365));
+    auto e_m = make_shared<ExtentManager>(ext_size, nullptr);
+    auto o_p = make_shared<Packer>(o_m, e_m, make_shared<object_lst>(),
+                                   make_shared<current_extents>(), num_objs,
+                                   10, false);
+    auto e_s = make_shared<Stack>(s_m);
+    o_p->add_objs(o_m->create_new_object(num_objs));
+    auto objs = std::set<obj_ptr>();
+    state.ResumeTiming();
+    size_t before = num_allocs.load(std::memory_order_relaxed);
+    o_p->pack_objects(e_s, objs);
+    allocs += num_allocs.load(std::memory_order_relaxed) - before;
+  }
+  state.SetItemsProcessed(state.iterations() * num_objs);
+  state.counters["allocs_per_obj"] =
+      allocs / ((double)state.iterations() * num_objs);
+}
+BENCHMARK_TEMPLATE(BM_PackObjects, SimpleObjectPacker,
+                   SingleExtentStack<>)
+    ->RangeMultiplier(4)
+    ->Range(1 << 8, 1 << 14);
+BENCHMARK_TEMPLATE(BM_PackObjects, MixedObjObjectPacker, SingleExtentStack<>)
+    ->RangeMultiplier(4)
+    ->Range(1 << 8, 1 << 14);
+BENCHMARK_TEMPLATE(BM_PackObjects, SizeBasedObjectPackerBaseline,
+                   SingleExtentStack<>)
+    ->RangeMultiplier(4)
+    ->Range(1 << 8, 1 << 14);
+BENCHMARK_TEMPLATE(BM_PackObjects, SizeBasedObjectPackerSmallerWholeObj,
+                   WholeObjectExtentStack)
+    ->RangeMultiplier(4)
+    ->Range(1 << 8, 1 << 14);
+BENCHMARK_TEMPLATE(BM_PackObjects, SizeBasedObjectPackerSmallerObj,
+                   SingleExtentStack<>)
+    ->RangeMultiplier(4)
+    ->Range(1 << 8, 1 << 14);
+BENCHMARK_TEMPLATE(BM_PackObjects, SizeBasedObjectPackerLargerWholeObj,
+                   WholeObjectExtentStack)
+    ->RangeMultiplier(4)
+    ->Range(1 << 8, 1 << 14);
+
+/****************************************
+ * Stripers
+ ****************************************/
+/*
+ * Cost of replacing extents in a stripe with the given number of
+ * localities, where every locality has a different number of extents being
+ * replaced.
+ */
+template <typename Striper>
+static void BM_CostToReplaceExtents(benchmark::State &state) {
+  const int num_localities = state.range(0);
+  const int exts_per_locality = 7;
+  auto s_m = make_shared<StripeManager>(exts_per_locality, 2, 2,
+                                        num_localities, 0.0);
+  auto e_m = make_shared<ExtentManager>(ext_size, nullptr);
+  shared_ptr<AbstractStriperDecorator> striper =
+      make_shared<Striper>(make_shared<ExtentStackStriper>(
+          make_shared<SimpleStriper>(s_m, e_m)));
+  repl_data replaced;
+  for (int i = 0; i < num_localities; i++) {
+    int n = i % (exts_per_locality + 1);
+    replaced.add_locality(n, exts_per_locality);
+    replaced.obsolete += n * ext_size / 2;
+    replaced.valid += n * ext_size / 2;
+  }
+  for (auto _ : state)
+    benchmark::DoNotOptimize(
+        striper->cost_to_replace_extents(ext_size, replaced));
+}
+BENCHMARK_TEMPLATE(BM_CostToReplaceExtents, StriperWithEC)
+    ->RangeMultiplier(2)
+    ->Range(1, 16);
+BENCHMARK_TEMPLATE(BM_CostToReplaceExtents, EfficientStriperWithEC)
+    ->RangeMultiplier(2)
+    ->Range(1, 16);
+
+/****************************************
+ * Stripe GC
+ ****************************************/
+/*
+ * Stripes whose extents each hold a surviving and a deleted object, with
+ * everything a StripeLevelWithExtsGCStrategy needs to collect them.
+ */
+struct gc_cycle_world {
+  shared_ptr<StripeLevelWithExtsGCStrategy> strategy;
+  set<stripe_ptr> stripe_set;
+
+  gc_cycle_world(int num_stripes) {
+    auto s_m = make_shared<StripeManager>(7, 2, 2, 2, 0.0);
+    auto e_m =
+        make_shared<ExtentManager>(ext_size, &Extent::get_default_key);
+    auto o_m = make_shared<ObjectManager>(
+        make_shared<EventManager>(),
+        make_shared<SimpleSampler>(365), false);
+    auto o_p = make_shared<SimpleObjectPacker>(
+        o_m, e_m, make_shared<object_lst>(), make_shared<current_extents>(),
+        10, 10, false);
+    auto gc_o_p = make_shared<SimpleGCObjectPacker>(
+        o_m, e_m, make_shared<object_lst>(), make_shared<current_extents>(),
+        10, 10, false);
+    auto striper =
+        make_shared<ExtentStackStriper>(make_shared<SimpleStriper>(s_m, e_m));
+    auto coordinator = make_shared<StripingProcessCoordinator>(
+        o_p, gc_o_p, striper, striper, make_shared<SingleExtentStack<>>(s_m),
+        make_shared<SingleExtentStack<>>(s_m), s_m, 365);
+    strategy = make_shared<StripeLevelWithExtsGCStrategy>(
+        10, 10, e_m, coordinator, make_shared<EfficientStriperWithEC>(striper));
+    int id = 0;
+    for (int i = 0; i < num_stripes; i++) {
+      stripe_ptr s = s_m->create_new_stripe(ext_size);
+      for (int j = 0; j < s->num_slots(); j++) {
+        ext_ptr e = e_m->create_extent();
+        capacity_t dead_size = ext_size / 4 + j * 64;
+        auto survivor =
+            make_shared<ExtentObject>(id++, ext_size - dead_size, 1);
+        auto dead = make_shared<ExtentObject>(id++, dead_size, 1);
+        e->add_object(survivor, ext_size - dead_size);
+        e->add_object(dead, dead_size);
+        s->add_extent(e);
+        e->del_object(dead);
+        s->update_obsolete(dead_size, e->locality);
+      }
+      stripe_set.insert(s);
+    }
+  }
+};
+
+/*
+ * One GC cycle over range(0) eligible stripes with range(1) threads
+ * planning the stripe GCs. Besides the time of the whole cycle it reports
+ * how long the planning phase, which may run in parallel, and the serial
+ * collection phase take when run one after the other.
+ */
+static void BM_StripeGCCycle(benchmark::State &state) {
+  const int num_stripes = state.range(0);
+  const int num_threads = state.range(1);
+  auto pool = num_threads > 1 ? make_shared<ThreadPool>(num_threads) : nullptr;
+  double plan_ns = 0, collect_ns = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    gc_cycle_world world(num_stripes);
+    gc_cycle_world phases(num_stripes);
+    world.strategy->set_thread_pool(pool);
+    state.ResumeTiming();
+    benchmark::DoNotOptimize(world.strategy->gc_handler(world.stripe_set));
+    state.PauseTiming();
+
+    auto start = std::chrono::steady_clock::now();
+    vector<stripe_gc_plan> plans;
+    for (auto &stripe : phases.stripe_set)
+      plans.push_back(phases.strategy->plan_stripe_gc(stripe));
+    auto planned = std::chrono::steady_clock::now();
+    for (auto &plan : plans)
+      benchmark::DoNotOptimize(phases.strategy->collect_stripe(plan));
+    auto collected = std::chrono::steady_clock::now();
+    plan_ns +=
+        std::chrono::duration<double, std::nano>(planned - start).count();
+    collect_ns +=
+        std::chrono::duration<double, std::nano>(collected - planned).count();
+    state.ResumeTiming();
+  }
+  state.counters["plan_ms"] = plan_ns / 1e6 / state.iterations();
+  state.counters["collect_ms"] = collect_ns / 1e6 / state.iterations();
+  state.SetItemsProcessed(state.iterations() * num_stripes);
+}
+BENCHMARK(BM_StripeGCCycle)
+    ->Args({4096, 1})
+    ->Args({4096, 4})
+    ->Unit(benchmark::kMillisecond);
+
+/****************************************
+ * EventManager
+ ****************************************/
+static void BM_EventManagerPushDrain(benchmark::State &state) {
+  const int num_events = state.range(0);
+  vector<obj_ptr> objs;
+  vector<float> lives;
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<float> life_dist(0, 365);
+  for (int i = 0; i < num_events; i++) {
+    objs.push_back(make_shared<ExtentObject>(i, 1, 0));
+    lives.push_back(life_dist(rng));
+  }
+  for (auto _ : state) {
+    EventManager e_m = EventManager();
+    for (int i = 0; i < num_events; i++)
+      e_m.put_event(lives[i], objs[i]);
+    while (!e_m.empty()) {
+      benchmark::DoNotOptimize(e_m.events->top());
+      e_m.events->pop();
+    }
+    delete e_m.events;
+  }
+  state.SetItemsProcessed(state.iterations() * num_events);
+}
+BENCHMARK(BM_EventManagerPushDrain)
+    ->RangeMultiplier(8)
+    ->Range(1 << 10, 1 << 19);
+
+/****************************************
+ * Sampler
+ ****************************************/
+static void BM_SimpleSampler(benchmark::State &state) {
+  const int num_samples = state.range(0);
+  SimpleSampler sampler = SimpleSampler(365);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(sampler.get_size_age_sample(num_samples));
+  state.SetItemsProcessed(state.iterations() * num_samples);
+}
+BENCHMARK(BM_SimpleSampler)->RangeMultiplier(8)->Range(1, 1 << 15);
+
+/****************************************
+ * Whole simulation
+ ****************************************/
+/*
+ * Runs config_registry[range(0)] with the workload of main.cpp (1M objects
+ * a year in a data center of 3.5M average sized objects) for range(1)
+ * simulated days and reports the heap allocations per GC cycle. Every run
+ * takes long, so it happens once; filter for a single config to measure it
+ * on its own.
+ */
+static void BM_SimulationAllocations(benchmark::State &state) {
+  const auto &entry = config_registry[state.range(0)];
+  const float simul_time = state.range(1);
+  const float striping_cycle = 1.0 / 12.0;
+  const int num_objs_per_cycle = 1000000 / 365.0 * striping_cycle;
+  const unsigned long data_center_size = 3500000 * 35000UL;
+  size_t allocs = 0;
+  double cycles = 0;
+  for (auto _ : state) {
+    auto sampler = make_shared<SimpleSampler>(
+        DeterministicDistributionSampler(simul_time));
+    DataCenter dc = entry.second(data_center_size, striping_cycle, simul_time,
+                                 ext_size, 10, 10, sampler, 100,
+                                 striping_cycle, num_objs_per_cycle);
+    size_t before = num_allocs.load(std::memory_order_relaxed);
+    benchmark::DoNotOptimize(dc.run_simulation());
+    allocs += num_allocs.load(std::memory_order_relaxed) - before;
+    cycles += std::min((double)configtime, (double)simul_time) /
+              dc.get_gc_cycle();
+  }
+  state.SetLabel(entry.first);
+  state.counters["allocs"] = allocs / (double)state.iterations();
+  state.counters["allocs_per_cycle"] = cycles > 0 ? allocs / cycles : 0;
+}
+BENCHMARK(BM_SimulationAllocations)
+    ->Args({0, 200})
+    ->Args({1, 200})
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
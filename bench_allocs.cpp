@@ -0,0 +1,48 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+/*
+ * Replaces the global operator new and delete family for bench, counting
+ * the heap allocations made by the process in num_allocs. They are defined
+ * in a translation unit of their own so that the compiler cannot inline
+ * them into the benchmarks and pair their malloc and free calls with the
+ * new and delete expressions there. The nothrow forms of the library call
+ * the replaced ones.
+ */
+std::atomic<size_t> num_allocs{0};
+
+static void *count_alloc(size_t size, size_t align) {
+  num_allocs.fetch_add(1, std::memory_order_relaxed);
+  if (size == 0)
+    size = 1;
+  void *p = align <= alignof(std::max_align_t)
+                ? std::malloc(size)
+                : std::aligned_alloc(align, (size + align - 1) / align * align);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void *operator new(size_t size) { return count_alloc(size, 0); }
+void *operator new[](size_t size) { return count_alloc(size, 0); }
+void *operator new(size_t size, std::align_val_t align) {
+  return count_alloc(size, (size_t)align);
+}
+void *operator new[](size_t size, std::align_val_t align) {
+  return count_alloc(size, (size_t)align);
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept {
+  std::free(p);
+}
+void operator delete[](void *p, size_t, std::align_val_t) noexcept {
+  std::free(p);
+}
@@ -1,4 +1,4 @@
 #pragma once
 #include <random>
 static inline double configtime = 0.0;
-static inline std::mt19937 generator;
\ No newline at end of file
+static inline thread_local std::mt19937 generator;
\ No newline at end of file
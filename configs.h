@@ -19,7 +19,6 @@
 using std::make_shared;
 using std::static_pointer_cast;
 using object_lst = std::vector<obj_record>;
-using obj_pq = std::priority_queue<std::variant<obj_record, obj_pq_record>>;
 
 inline std::tuple<shared_ptr<StripeManager>, shared_ptr<EventManager>,
                   shared_ptr<ObjectManager>, shared_ptr<ExtentManager>>
@@ -78,10 +77,10 @@ inline DataCenter stripe_level_with_no_exts_config(
   shared_ptr<StriperWithEC> gc_striper =
       make_shared<StriperWithEC>(make_shared<ExtentStackStriper>(
           make_shared<SimpleStriper>(stripe_mngr, ext_mngr)));
-  static auto temp_op = make_shared<object_lst>();
-  static auto temp_op_gc = make_shared<object_lst>();
-  static auto temp_curr_exts = make_shared<current_extents>();
-  static auto temp_curr_exts_gc = make_shared<current_extents>();
+  auto temp_op = make_shared<object_lst>();
+  auto temp_op_gc = make_shared<object_lst>();
+  auto temp_curr_exts = make_shared<current_extents>();
+  auto temp_curr_exts_gc = make_shared<current_extents>();
   shared_ptr<SimpleObjectPacker> obj_packer = make_shared<SimpleObjectPacker>(
       obj_mngr, ext_mngr, temp_op, temp_curr_exts, num_objs,
       primary_threshold, true);
@@ -109,6 +108,76 @@ inline DataCenter stripe_level_with_no_exts_config(
   return data_center;
 }
 
+/*
+ * Same as stripe_level_with_no_exts_config, but only the
+ * gc_stripes_per_cycle eligible stripes with the best cost-benefit score
+ * are collected in each cycle.
+ */
+inline DataCenter stripe_level_with_no_exts_cost_benefit_config(
+    const unsigned long data_center_size, const float striping_cycle,
+    const float simul_time, const int ext_size, const short primary_threshold,
+    const short secondary_threshold, shared_ptr<SimpleSampler> sampler,
+    const short num_stripes_per_cycle, const float deletion_cycle,
+    const int num_objs) {
+  int num_data_exts = 1;
+  float coding_overhead = 18.0 / 14.0;
+  float num_global_parities = 2.0 / 14.0;
+  float num_local_parities = 2.0 / 14.0;
+  int num_localities = 1;
+  int gc_stripes_per_cycle = 8;
+  std::tuple<shared_ptr<StripeManager>, shared_ptr<EventManager>,
+             shared_ptr<ObjectManager>, shared_ptr<ExtentManager>>
+      mngrs = create_managers(num_data_exts, num_local_parities,
+                              num_global_parities, num_localities, sampler,
+                              ext_size, &Extent::get_default_key,
+                              coding_overhead);
+  shared_ptr<StripeManager> stripe_mngr =
+      std::get<shared_ptr<StripeManager>>(mngrs);
+  shared_ptr<ExtentManager> ext_mngr =
+      std::get<shared_ptr<ExtentManager>>(mngrs);
+  shared_ptr<ObjectManager> obj_mngr =
+      std::get<shared_ptr<ObjectManager>>(mngrs);
+  shared_ptr<EventManager> event_mngr =
+      std::get<shared_ptr<EventManager>>(mngrs);
+
+  shared_ptr<AbstractStriperDecorator> striper =
+      make_shared<StriperWithEC>(make_shared<ExtentStackStriper>(
+          make_shared<SimpleStriper>(stripe_mngr, ext_mngr)));
+  shared_ptr<StriperWithEC> gc_striper =
+      make_shared<StriperWithEC>(make_shared<ExtentStackStriper>(
+          make_shared<SimpleStriper>(stripe_mngr, ext_mngr)));
+  auto temp_op = make_shared<object_lst>();
+  auto temp_op_gc = make_shared<object_lst>();
+  auto temp_curr_exts = make_shared<current_extents>();
+  auto temp_curr_exts_gc = make_shared<current_extents>();
+  shared_ptr<SimpleObjectPacker> obj_packer = make_shared<SimpleObjectPacker>(
+      obj_mngr, ext_mngr, temp_op, temp_curr_exts, num_objs,
+      primary_threshold, true);
+
+  shared_ptr<SimpleGCObjectPacker> gc_obj_packer =
+      make_shared<SimpleGCObjectPacker>(obj_mngr, ext_mngr, temp_op_gc ,
+                                        temp_curr_exts_gc, num_objs,
+                                        primary_threshold, true);
+  shared_ptr<AbstractExtentStack> extent_stack =
+      make_shared<SingleExtentStack<>>(stripe_mngr);
+  shared_ptr<AbstractExtentStack> gc_extent_stack =
+      make_shared<SingleExtentStack<>>(stripe_mngr);
+  shared_ptr<StripingProcessCoordinator> coordinator =
+      make_shared<StripingProcessCoordinator>(
+          obj_packer, gc_obj_packer, striper, gc_striper, extent_stack,
+          gc_extent_stack, stripe_mngr, simul_time);
+  auto gc_strategy =
+      make_shared<CostBenefitGCStrategy<StripeLevelNoExtsGCStrategy>>(
+          gc_stripes_per_cycle, primary_threshold, secondary_threshold,
+          ext_mngr, coordinator, gc_striper, stripe_mngr);
+  DataCenter data_center =
+      DataCenter(data_center_size, striping_cycle, striper, stripe_mngr,
+                 ext_mngr, obj_mngr, event_mngr, gc_strategy, coordinator,
+                 simul_time, deletion_cycle);
+
+  return data_center;
+}
+
 inline DataCenter no_exts_mix_objs_config(
     const unsigned long data_center_size, const float striping_cycle,
     const float simul_time, const int ext_size, const short primary_threshold,
@@ -142,7 +211,7 @@ inline DataCenter no_exts_mix_objs_config(
       make_shared<StriperWithEC>(make_shared<SimpleStriper>(stripe_mngr, ext_mngr));
   shared_ptr<current_extents> current_exts = make_shared<current_extents>();
   current_exts->emplace(0, ext_mngr->create_extent());
-  static auto obj_pool = make_shared<object_lst>();
+  auto obj_pool = make_shared<object_lst>();
 
   shared_ptr<SimpleObjectPacker> obj_packer = make_shared<MixedObjObjectPacker>(
       obj_mngr, ext_mngr, obj_pool, current_exts, num_objs,
@@ -195,10 +264,10 @@ inline DataCenter stripe_level_with_extents_separate_pools_config(
       make_shared<StriperWithEC>(make_shared<ExtentStackStriper>(
           make_shared<SimpleStriper>(stripe_mngr, ext_mngr)));
   shared_ptr<AbstractStriperDecorator> gc_striper = striper;
-  static auto temp_op = make_shared<object_lst>();
-  static auto temp_op_gc = make_shared<object_lst>();
-    static auto temp_curr_exts = make_shared<current_extents>();
-  static auto temp_curr_exts_gc = make_shared<current_extents>();
+  auto temp_op = make_shared<object_lst>();
+  auto temp_op_gc = make_shared<object_lst>();
+  auto temp_curr_exts = make_shared<current_extents>();
+  auto temp_curr_exts_gc = make_shared<current_extents>();
   shared_ptr<SimpleObjectPacker> obj_packer = make_shared<SimpleObjectPacker>(
       obj_mngr, ext_mngr, temp_op, temp_curr_exts, num_objs,
       primary_threshold, false);
@@ -253,10 +322,10 @@ inline DataCenter stripe_level_with_extents_separate_pools_efficient_config(
       make_shared<EfficientStriperWithEC>(make_shared<ExtentStackStriper>(
           make_shared<SimpleStriper>(stripe_mngr, ext_mngr)));
   shared_ptr<AbstractStriperDecorator> gc_striper = striper;
-  static auto temp_op = make_shared<object_lst>();
-  static auto temp_op_gc = make_shared<object_lst>();
-    static auto temp_curr_exts = make_shared<current_extents>();
-  static auto temp_curr_exts_gc = make_shared<current_extents>();
+  auto temp_op = make_shared<object_lst>();
+  auto temp_op_gc = make_shared<object_lst>();
+  auto temp_curr_exts = make_shared<current_extents>();
+  auto temp_curr_exts_gc = make_shared<current_extents>();
   shared_ptr<SimpleObjectPacker> obj_packer = make_shared<SimpleObjectPacker>(
       obj_mngr, ext_mngr, temp_op, temp_curr_exts, num_objs);
   shared_ptr<SimpleGCObjectPacker> gc_obj_packer =
@@ -277,6 +346,69 @@ inline DataCenter stripe_level_with_extents_separate_pools_efficient_config(
   return data_center;
 }
 
+/*
+ * Same as stripe_level_with_extents_separate_pools_config, but the GC may
+ * only move gc_budget_exts extents worth of data per cycle. Stripes that do
+ * not fit into the budget are carried over to later cycles.
+ */
+inline DataCenter stripe_level_with_extents_gc_budget_config(
+    const unsigned long data_center_size, const float striping_cycle,
+    const float simul_time, const int ext_size, const short primary_threshold,
+    const short secondary_threshold, shared_ptr<SimpleSampler> sampler,
+    const short num_stripes_per_cycle, const float deletion_cycle,
+    const int num_objs) {
+  int num_data_exts = 7;
+  float num_global_parities = 2;
+  float num_local_parities = 2;
+  int num_localities = 2;
+  int gc_budget_exts = 32;
+  std::tuple<shared_ptr<StripeManager>, shared_ptr<EventManager>,
+             shared_ptr<ObjectManager>, shared_ptr<ExtentManager>>
+      mngrs = create_managers(num_data_exts, num_local_parities,
+                              num_global_parities, num_localities, sampler,
+                              ext_size, &Extent::get_default_key);
+  shared_ptr<StripeManager> stripe_mngr =
+      std::get<shared_ptr<StripeManager>>(mngrs);
+  shared_ptr<ExtentManager> ext_mngr =
+      std::get<shared_ptr<ExtentManager>>(mngrs);
+  shared_ptr<ObjectManager> obj_mngr =
+      std::get<shared_ptr<ObjectManager>>(mngrs);
+  shared_ptr<EventManager> event_mngr =
+      std::get<shared_ptr<EventManager>>(mngrs);
+
+  shared_ptr<AbstractStriperDecorator> striper =
+      make_shared<StriperWithEC>(make_shared<ExtentStackStriper>(
+          make_shared<SimpleStriper>(stripe_mngr, ext_mngr)));
+  shared_ptr<AbstractStriperDecorator> gc_striper = striper;
+  auto temp_op = make_shared<object_lst>();
+  auto temp_op_gc = make_shared<object_lst>();
+  auto temp_curr_exts = make_shared<current_extents>();
+  auto temp_curr_exts_gc = make_shared<current_extents>();
+  shared_ptr<SimpleObjectPacker> obj_packer = make_shared<SimpleObjectPacker>(
+      obj_mngr, ext_mngr, temp_op, temp_curr_exts, num_objs,
+      primary_threshold, false);
+  shared_ptr<SimpleGCObjectPacker> gc_obj_packer =
+      make_shared<SimpleGCObjectPacker>(obj_mngr, ext_mngr, temp_op_gc,
+                                        temp_curr_exts_gc, num_objs,
+                                        primary_threshold, false);
+  shared_ptr<AbstractExtentStack> extent_stack =
+      make_shared<SingleExtentStack<>>(stripe_mngr);
+  shared_ptr<AbstractExtentStack> gc_extent_stack = extent_stack;
+  shared_ptr<StripingProcessCoordinator> coordinator =
+      make_shared<StripingProcessCoordinator>(
+          obj_packer, gc_obj_packer, striper, gc_striper, extent_stack,
+          gc_extent_stack, stripe_mngr, simul_time);
+  shared_ptr<GarbageCollectionStrategy> gc_strategy =
+      make_shared<BandwidthBudgetGCStrategy<StripeLevelWithExtsGCStrategy>>(
+          (long double)gc_budget_exts * ext_size, primary_threshold,
+          secondary_threshold, ext_mngr, coordinator, gc_striper);
+  DataCenter data_center =
+      DataCenter(data_center_size, striping_cycle, striper, stripe_mngr,
+                 ext_mngr, obj_mngr, event_mngr, gc_strategy, coordinator,
+                 simul_time, deletion_cycle);
+  return data_center;
+}
+
 inline float get_timestamp() { return configtime; }
 
 inline DataCenter age_based_config_no_exts(
@@ -309,10 +441,10 @@ inline DataCenter age_based_config_no_exts(
       make_shared<StriperWithEC>(make_shared<ExtentStackStriper>(
           make_shared<SimpleStriper>(stripe_mngr, ext_mngr)));
   shared_ptr<AbstractStriperDecorator> gc_striper = striper;
-  static auto temp_op = make_shared<obj_pq>();
-  static auto temp_op_gc = make_shared<obj_pq>();
-  static auto temp_curr_exts = make_shared<current_extents>();
-  static auto temp_curr_exts_gc = make_shared<current_extents>();
+  auto temp_op = make_shared<obj_pq>();
+  auto temp_op_gc = make_shared<obj_pq>();
+  auto temp_curr_exts = make_shared<current_extents>();
+  auto temp_curr_exts_gc = make_shared<current_extents>();
   shared_ptr<SimpleObjectPacker> obj_packer = make_shared<AgeBasedObjectPacker>(
       obj_mngr, ext_mngr, temp_op, temp_curr_exts, num_objs,
       primary_threshold);
@@ -370,10 +502,10 @@ inline DataCenter age_based_config(
       make_shared<StriperWithEC>(make_shared<ExtentStackStriper>(
           make_shared<SimpleStriper>(stripe_mngr, ext_mngr)));
   shared_ptr<AbstractStriperDecorator> gc_striper = striper;
-  static auto temp_op = make_shared<obj_pq>();
-  static auto temp_op_gc = make_shared<obj_pq>();
-  static auto temp_curr_exts = make_shared<current_extents>();
-  static auto temp_curr_exts_gc = make_shared<current_extents>();
+  auto temp_op = make_shared<obj_pq>();
+  auto temp_op_gc = make_shared<obj_pq>();
+  auto temp_curr_exts = make_shared<current_extents>();
+  auto temp_curr_exts_gc = make_shared<current_extents>();
   shared_ptr<SimpleObjectPacker> obj_packer = make_shared<AgeBasedObjectPacker>(
       obj_mngr, ext_mngr, temp_op, temp_curr_exts, num_objs);
   shared_ptr<SimpleGCObjectPacker> gc_obj_packer =
@@ -427,10 +559,10 @@ inline DataCenter size_based_stripe_level_no_exts_baseline_config(
       make_shared<StriperWithEC>(make_shared<ExtentStackStriper>(
           make_shared<SimpleStriper>(stripe_mngr, ext_mngr)));
   shared_ptr<AbstractStriperDecorator> gc_striper = striper;
-  static auto temp_op = make_shared<object_lst>();
-  static auto temp_op_gc = make_shared<object_lst>();
-  static auto temp_curr_exts = make_shared<current_extents>();
-  static auto temp_curr_exts_gc = make_shared<current_extents>();
+  auto temp_op = make_shared<object_lst>();
+  auto temp_op_gc = make_shared<object_lst>();
+  auto temp_curr_exts = make_shared<current_extents>();
+  auto temp_curr_exts_gc = make_shared<current_extents>();
   shared_ptr<SimpleObjectPacker> obj_packer =
       make_shared<SizeBasedObjectPackerBaseline>(
           obj_mngr, ext_mngr, temp_op, temp_curr_exts, num_objs,
@@ -490,10 +622,10 @@ inline DataCenter size_based_stripe_level_no_exts_smaller_obj_config(
       make_shared<StriperWithEC>(make_shared<ExtentStackStriper>(
           make_shared<SimpleStriper>(stripe_mngr, ext_mngr)));
   shared_ptr<AbstractStriperDecorator> gc_striper = striper;
-  static auto temp_op = make_shared<object_lst>();
-  static auto temp_op_gc = make_shared<object_lst>();
-  static auto temp_curr_exts = make_shared<current_extents>();
-  static auto temp_curr_exts_gc = make_shared<current_extents>();
+  auto temp_op = make_shared<object_lst>();
+  auto temp_op_gc = make_shared<object_lst>();
+  auto temp_curr_exts = make_shared<current_extents>();
+  auto temp_curr_exts_gc = make_shared<current_extents>();
   shared_ptr<SimpleObjectPacker> obj_packer =
       make_shared<SizeBasedObjectPackerSmallerObj>(
           obj_mngr, ext_mngr, temp_op, temp_curr_exts, num_objs,
@@ -554,10 +686,10 @@ inline DataCenter size_based_stripe_level_no_exts_dynamic_strategy_config(
       make_shared<StriperWithEC>(make_shared<ExtentStackStriper>(
           make_shared<SimpleStriper>(stripe_mngr, ext_mngr)));
   shared_ptr<AbstractStriperDecorator> gc_striper = striper;
-  static auto temp_op = make_shared<object_lst>();
-  static auto temp_op_gc = make_shared<object_lst>();
-  static auto temp_curr_exts = make_shared<current_extents>();
-  static auto temp_curr_exts_gc = make_shared<current_extents>();
+  auto temp_op = make_shared<object_lst>();
+  auto temp_op_gc = make_shared<object_lst>();
+  auto temp_curr_exts = make_shared<current_extents>();
+  auto temp_curr_exts_gc = make_shared<current_extents>();
   shared_ptr<SimpleObjectPacker> obj_packer =
       make_shared<SizeBasedObjectPackerDynamicStrategy>(
           obj_mngr, ext_mngr, temp_op, temp_curr_exts, num_objs,
@@ -618,10 +750,10 @@ inline DataCenter size_based_whole_obj_config(
       make_shared<StriperWithEC>(make_shared<ExtentStackStriper>(
           make_shared<SimpleStriper>(stripe_mngr, ext_mngr)));
   shared_ptr<AbstractStriperDecorator> gc_striper = striper;
-  static auto temp_op = make_shared<object_lst>();
-  static auto temp_op_gc = make_shared<object_lst>();
-  static auto temp_curr_exts = make_shared<current_extents>();
-  static auto temp_curr_exts_gc = make_shared<current_extents>();
+  auto temp_op = make_shared<object_lst>();
+  auto temp_op_gc = make_shared<object_lst>();
+  auto temp_curr_exts = make_shared<current_extents>();
+  auto temp_curr_exts_gc = make_shared<current_extents>();
   shared_ptr<SimpleObjectPacker> obj_packer =
       make_shared<SizeBasedObjectPackerSmallerWholeObjFillGap>(
           obj_mngr, ext_mngr, temp_op, temp_curr_exts, num_objs,
@@ -685,10 +817,10 @@ inline DataCenter size_based_stripe_level_no_exts_larger_whole_obj_config(
       make_shared<StriperWithEC>(make_shared<ExtentStackStriper>(
           make_shared<SimpleStriper>(stripe_mngr, ext_mngr)));
   shared_ptr<AbstractStriperDecorator> gc_striper = striper;
-  static auto temp_op = make_shared<object_lst>();
-  static auto temp_op_gc = make_shared<object_lst>();
-  static auto temp_curr_exts = make_shared<current_extents>();
-  static auto temp_curr_exts_gc = make_shared<current_extents>();
+  auto temp_op = make_shared<object_lst>();
+  auto temp_op_gc = make_shared<object_lst>();
+  auto temp_curr_exts = make_shared<current_extents>();
+  auto temp_curr_exts_gc = make_shared<current_extents>();
   shared_ptr<SimpleObjectPacker> obj_packer =
       make_shared<SizeBasedObjectPackerLargerWholeObj>(
           obj_mngr, ext_mngr, temp_op, temp_curr_exts, num_objs,
@@ -759,10 +891,10 @@ inline DataCenter mortal_immortal_no_exts_config(
       make_shared<StriperWithEC>(make_shared<ExtentStackStriper>(
           make_shared<SimpleStriper>(stripe_mngr, ext_mngr)));
   shared_ptr<AbstractStriperDecorator> gc_striper = striper;
-  static auto temp_op = make_shared<object_lst>();
-  static auto temp_op_gc = make_shared<object_lst>();
-  static auto temp_curr_exts = make_shared<current_extents>();
-  static auto temp_curr_exts_gc = make_shared<current_extents>();
+  auto temp_op = make_shared<object_lst>();
+  auto temp_op_gc = make_shared<object_lst>();
+  auto temp_curr_exts = make_shared<current_extents>();
+  auto temp_curr_exts_gc = make_shared<current_extents>();
   shared_ptr<SimpleObjectPacker> obj_packer =
       make_shared<MortalImmortalObjectPacker>(obj_mngr, ext_mngr, temp_op,
                                               temp_curr_exts, num_objs,
@@ -883,10 +1015,10 @@ inline DataCenter randomized_obj_placement_joined_pools_config(
       make_shared<StriperWithEC>(make_shared<ExtentStackStriper>(
           make_shared<SimpleStriper>(stripe_mngr, ext_mngr)));
   shared_ptr<AbstractStriperDecorator> gc_striper = striper;
-  static auto temp_op = make_shared<object_lst>();
-  static auto temp_op_gc = make_shared<object_lst>();
-  static auto temp_curr_exts = make_shared<current_extents>();
-  static auto temp_curr_exts_gc = make_shared<current_extents>();
+  auto temp_op = make_shared<object_lst>();
+  auto temp_op_gc = make_shared<object_lst>();
+  auto temp_curr_exts = make_shared<current_extents>();
+  auto temp_curr_exts_gc = make_shared<current_extents>();
   shared_ptr<SimpleObjectPacker> obj_packer =
       make_shared<RandomizedObjectPacker>(obj_mngr, ext_mngr, temp_op,
                                           temp_curr_exts, num_objs,
@@ -952,10 +1084,10 @@ inline DataCenter randomized_objs_no_exts_config(
   shared_ptr<AbstractStriperDecorator> gc_striper =
       make_shared<StriperWithEC>(make_shared<ExtentStackStriper>(
           make_shared<SimpleStriper>(stripe_mngr, ext_mngr)));
-  static auto temp_op = make_shared<object_lst>();
-  static auto temp_op_gc = make_shared<object_lst>();
-  static auto temp_curr_exts = make_shared<current_extents>();
-  static auto temp_curr_exts_gc = make_shared<current_extents>();
+  auto temp_op = make_shared<object_lst>();
+  auto temp_op_gc = make_shared<object_lst>();
+  auto temp_curr_exts = make_shared<current_extents>();
+  auto temp_curr_exts_gc = make_shared<current_extents>();
   shared_ptr<SimpleObjectPacker> obj_packer =
       make_shared<RandomizedObjectPacker>(obj_mngr, ext_mngr, temp_op,
                                           temp_curr_exts, num_objs,
@@ -1074,10 +1206,10 @@ inline DataCenter age_based_rand_config_no_exts(
       make_shared<StriperWithEC>(make_shared<ExtentStackStriper>(
           make_shared<SimpleStriper>(stripe_mngr, ext_mngr)));
   shared_ptr<AbstractStriperDecorator> gc_striper = striper;
-  static auto temp_op = make_shared<obj_pq>();
-  static auto temp_op_gc = make_shared<obj_pq>();
-  static auto temp_curr_exts = make_shared<current_extents>();
-  static auto temp_curr_exts_gc = make_shared<current_extents>();
+  auto temp_op = make_shared<obj_pq>();
+  auto temp_op_gc = make_shared<obj_pq>();
+  auto temp_curr_exts = make_shared<current_extents>();
+  auto temp_curr_exts_gc = make_shared<current_extents>();
   shared_ptr<SimpleObjectPacker> obj_packer =
       make_shared<AgeBasedRandomizedObjectPacker>(obj_mngr, ext_mngr, temp_op,
                                                   temp_curr_exts, num_objs,
@@ -1137,8 +1269,8 @@ inline DataCenter generational_config(
       make_shared<StriperWithEC>(make_shared<ExtentStackStriper>(
           make_shared<SimpleStriper>(stripe_mngr, ext_mngr)));
   shared_ptr<AbstractStriperDecorator> gc_striper = striper;
-  static auto temp_op = make_shared<obj_pq>();
-  static auto temp_op_gc = make_shared<obj_pq>();
+  auto temp_op = make_shared<obj_pq>();
+  auto temp_op_gc = make_shared<obj_pq>();
   auto temp_curr_exts = make_shared<current_extents>();
   auto temp_curr_exts_gc = make_shared<current_extents>();
   shared_ptr<SimpleObjectPacker> obj_packer =
@@ -1169,4 +1301,62 @@ secondary_threshold, ext_mngr, coordinator, gc_striper, stripe_mngr)
 
   return data_center;
 }
+using config_fnc = DataCenter (*)(const unsigned long, const float,
+                                  const float, const int, const short,
+                                  const short, shared_ptr<SimpleSampler>,
+                                  const short, const float, const int);
+
+/*
+ * All configurations that can be selected by name. Since we can't just
+ * evaluate function name like Python, the simulator and the benchmark
+ * drivers look configurations up here. mortal_immortal_no_exts_config takes
+ * an additional argument and is handled separately by the callers.
+ */
+inline const std::vector<std::pair<string, config_fnc>> config_registry = {
+    // Baseline
+    {"stripe_level_with_no_exts_config", stripe_level_with_no_exts_config},
+    {"no_exts_mix_objs_config", no_exts_mix_objs_config},
+    // Cross-extent erasure coding
+    {"stripe_level_with_extents_separate_pools_config",
+     stripe_level_with_extents_separate_pools_config},
+    {"stripe_level_with_extents_separate_pools_efficient_config",
+     stripe_level_with_extents_separate_pools_efficient_config},
+    // GC strategies
+    {"stripe_level_with_no_exts_cost_benefit_config",
+     stripe_level_with_no_exts_cost_benefit_config},
+    {"stripe_level_with_extents_gc_budget_config",
+     stripe_level_with_extents_gc_budget_config},
+    // Placement strategies
+    {"age_based_config", age_based_config},
+    {"generational_config", generational_config},
+    {"size_based_stripe_level_no_exts_baseline_config",
+     size_based_stripe_level_no_exts_baseline_config},
+    {"size_based_stripe_level_no_exts_larger_whole_obj_config",
+     size_based_stripe_level_no_exts_larger_whole_obj_config},
+    {"size_based_stripe_level_no_exts_smaller_obj_config",
+     size_based_stripe_level_no_exts_smaller_obj_config},
+    {"size_based_stripe_level_no_exts_dynamic_strategy_config",
+     size_based_stripe_level_no_exts_dynamic_strategy_config},
+    {"size_based_whole_obj_config", size_based_whole_obj_config},
+    {"age_based_config_no_exts", age_based_config_no_exts},
+    {"age_based_rand_config_no_exts", age_based_rand_config_no_exts},
+    {"randomized_objs_no_exts_config", randomized_objs_no_exts_config},
+    {"randomized_ext_placement_joined_pools_config",
+     randomized_ext_placement_joined_pools_config},
+    {"randomized_obj_placement_joined_pools_config",
+     randomized_obj_placement_joined_pools_config},
+    {"randomized_objs_no_exts_mix_objs_config",
+     randomized_objs_no_exts_mix_objs_config},
+};
+
+/*
+ * Returns the configuration registered under confname, or nullptr if there
+ * is none.
+ */
+inline config_fnc parse_config(const string &confname) {
+  for (auto &entry : config_registry)
+    if (entry.first == confname)
+      return entry.second;
+  return nullptr;
+}
 #endif // __CONFIGS_H_
@@ -7,13 +7,18 @@
 #pragma once
 #include <iomanip>
 #include "config.h"
+#include "device_model.h"
 #include "event_manager.h"
 #include "extent_manager.h"
 #include "gc_strategies.h"
 #include "object_manager.h"
+#include "memory_accounting.h"
+#include "profiler.h"
+#include "steady_state.h"
 #include "stripe_manager.h"
 #include "stripers.h"
 #include "striping_process_coordinator.h"
+#include "time_series.h"
 #include <algorithm>
 #include <iostream>
 #include <set>
@@ -40,40 +45,47 @@ inline std::ostream &operator<<(std::ostream &os,  unordered_map<string, double>
 
 inline double sum_map_string_double(unordered_map<string, double>const &map )
 {
-  return std::accumulate(map.begin(), map.end(), 0,
-              [] (int value, const std::map<string, double>::value_type& p)
+  return std::accumulate(map.begin(), map.end(), 0.0,
+              [] (double value, const std::map<string, double>::value_type& p)
                    { return value + p.second; }
               );
 }
 struct del_result {
-  double total_added_obsolete = 0;
+  capacity_t total_added_obsolete = 0;
   set<stripe_ptr> gc_stripes_set = set<stripe_ptr>();
-  unordered_map<string, double> ext_types = unordered_map<string, double>();
+  unordered_map<string, capacity_t> ext_types =
+      unordered_map<string, capacity_t>();
 };
 
 // Event handler result
 struct eh_result {
-  int total_reclaimed_space = 0;
+  capacity_t total_reclaimed_space = 0;
   unsigned long total_obsolete = 0;
    unsigned long total_used_space = 0;
   unsigned long dc_size = 0;
   int total_leftovers = 0;
-  double total_global_parity_reads = 0;
-  double total_global_parity_writes = 0;
-  double total_local_parity_reads = 0;
-  double total_local_parity_writes = 0;
-  int total_obsolete_data_reads = 0;
-  int total_absent_data_reads = 0;
-  int total_valid_obj_transfers = 0;
-  int total_storage_node_to_parity_calculator = 0;
+  capacity_t total_global_parity_reads = 0;
+  capacity_t total_global_parity_writes = 0;
+  capacity_t total_local_parity_reads = 0;
+  capacity_t total_local_parity_writes = 0;
+  capacity_t total_obsolete_data_reads = 0;
+  capacity_t total_absent_data_reads = 0;
+  capacity_t total_valid_obj_transfers = 0;
+  capacity_t total_storage_node_to_parity_calculator = 0;
   double max_obs_perc = 0;
   int total_exts_gced = 0;
-  double new_obj_writes = 0;
-  double new_obj_reads = 0;
-  double striper_parities = 0;
-  unordered_map<string, int> total_reclaimed_space_by_ext_type =
-      unordered_map<string, int>();
+  capacity_t new_obj_writes = 0;
+  capacity_t new_obj_reads = 0;
+  capacity_t striper_parities = 0;
+  unordered_map<string, capacity_t> total_reclaimed_space_by_ext_type =
+      unordered_map<string, capacity_t>();
   vector<double> obs_percentages = vector<double>();
+  // GC budget over all cycles and the GC traffic spent out of it, and the
+  // largest backlog of obsolete space left by a budgeted strategy
+  long double total_gc_budget = 0;
+  capacity_t total_gc_traffic = 0;
+  capacity_t max_gc_backlog = 0;
+  steady_state_result steady_state;
 };
 
 // Run simulator metric
@@ -91,11 +103,11 @@ struct sim_metric {
   double total_user_data_writes = 0;
   long double total_gc_bandwidth = 0;
   long double total_bandwidth = 0;
-  int total_absent_data_reads = 0;
-  int total_obsolete_data_reads = 0;
-  int total_pool_to_parity_calculator = 0;
-  int total_parity_calculator_to_storage_node = 0;
-  int total_storage_node_to_parity_calculator = 0;
+  capacity_t total_absent_data_reads = 0;
+  capacity_t total_obsolete_data_reads = 0;
+  capacity_t total_pool_to_parity_calculator = 0;
+  capacity_t total_parity_calculator_to_storage_node = 0;
+  capacity_t total_storage_node_to_parity_calculator = 0;
   int num_objs = 0;
   int num_exts = 0;
   int num_stripes = 0;
@@ -106,11 +118,26 @@ struct sim_metric {
   unordered_map<string, double> cost_by_ext = unordered_map<string, double>();
   unordered_map<string, long double> obs_by_ext_types = unordered_map<string, long double>();
   gc_ext_type_num_map gced_by_type = gc_ext_type_num_map();
+  double gc_budget_utilization = 0;
+  capacity_t max_gc_backlog = 0;
+  steady_state_result steady_state;
+  // Lanes of an approximate run and how many of them were simulated, with
+  // the 95% error bounds of the estimated metrics
+  int num_lanes = 0;
+  int sampled_lanes = 0;
+  unordered_map<string, double> error_bounds = unordered_map<string, double>();
+  // Largest traffic of a single storage node in a cycle, overall and of the
+  // GC, and the GC traffic of the busiest node over that of the average one
+  double peak_node_traffic = 0;
+  double peak_node_gc_traffic = 0;
+  double node_gc_imbalance = 0;
+  device_result device;
+  ftl_result ftl;
 };
 
 class DataCenter {
   unsigned long max_size;
-  double gced_space;
+  capacity_t gced_space;
   float simul_time;
   float striping_cycle, gc_cycle;
 
@@ -122,6 +149,31 @@ class DataCenter {
   shared_ptr<GarbageCollectionStrategy> gc_strategy;
   shared_ptr<StripingProcessCoordinator> coordinator;
   unordered_map<string, long double> obs_by_ext_types;
+  shared_ptr<TimeSeriesWriter> time_series;
+  int time_series_interval;
+  MemoryTracker memory_tracker;
+  int memory_report_interval;
+  int gc_threads = 1;
+  shared_ptr<SteadyStateMonitor> steady_state;
+  shared_ptr<StorageNodes> storage_nodes;
+  shared_ptr<DeviceModel> device_model;
+  bool skip_idle_cycles = true;
+
+  // State event_handler carries from one cycle to the next
+  struct run_state {
+    eh_result ret;
+    capacity_t net_obsolete = 0;
+    capacity_t used_space = 0;
+    double daily_max_perc = 0.0;
+    double obs_perc = -1.0;
+    double obs_timestamp = -1.0;
+    float next_del_time = 0;
+    vector<double> obs_percentages = vector<double>();
+    unordered_map<string, capacity_t> net_obs_by_ext_type =
+        unordered_map<string, capacity_t>();
+    obj_ptr next_del_obj = nullptr;
+    long num_cycles = 0;
+  } run;
 
 public:
   DataCenter(unsigned long max_size, float striping_cycle,
@@ -138,7 +190,156 @@ public:
         gc_strategy(gc_strategy), coordinator(coordinator),
         simul_time(simul_time), gc_cycle(gc_cycle), gced_space(0),
         obs_by_ext_types(unordered_map<string, long double>()),
-        stripe_mngr(stripe_mngr) {}
+        stripe_mngr(stripe_mngr), time_series(nullptr),
+        time_series_interval(0), memory_report_interval(0) {}
+
+  /*
+   * Whether cycles skip their deletion and GC phases when there is nothing
+   * to delete or collect, and their striping phase when there is nothing to
+   * stripe. The results are the same either way.
+   */
+  void set_skip_idle_cycles(bool skip) { this->skip_idle_cycles = skip; }
+
+  /*
+   * Records per-cycle metrics into the given sink every `interval` cycles.
+   * Passing a nullptr disables the time series.
+   */
+  void set_time_series(shared_ptr<TimeSeriesWriter> ts, int interval = 1) {
+    this->time_series = ts;
+    this->time_series_interval = interval > 0 ? interval : 1;
+  }
+
+  /*
+   * Samples the memory usage of the managers, packers and extent stacks
+   * every `interval` cycles and prints the samples at the end of the
+   * simulation. 0 disables the report.
+   */
+  void set_memory_report(int interval) {
+    this->memory_report_interval = interval;
+  }
+
+  /*
+   * Plans the stripe GCs of a cycle on `num_threads` threads. The stripes
+   * are still collected in id order on the simulation thread, so the
+   * results do not depend on the number of threads. 1 or less keeps the
+   * whole GC on the simulation thread.
+   */
+  void set_gc_threads(int num_threads) {
+    this->gc_threads = num_threads;
+    this->gc_strategy->set_thread_pool(
+        num_threads > 1 ? make_shared<ThreadPool>(num_threads) : nullptr);
+  }
+
+  /*
+   * Samples new objects from a SampleStream seeded with the sampler's seed,
+   * ahead of the simulation on a producer thread if enabled. The stream
+   * gives the same objects in the same order either way, so turning the
+   * pipeline on does not change the results. Samplers that can only sample
+   * in batches keep sampling on the simulation thread.
+   */
+  void set_sample_pipeline(bool enabled) {
+    if (!set_sample_stream(obj_mngr->sampler->get_seed(), enabled))
+      this->obj_mngr->set_sample_source(nullptr);
+  }
+
+  /*
+   * Samples new objects from a SampleStream with the given seed instead of
+   * the global random state, on a producer thread if pipelined. Returns
+   * false for samplers that can only sample in batches.
+   */
+  bool set_sample_stream(unsigned seed, bool pipelined = false) {
+    shared_ptr<Sampler> sampler = this->obj_mngr->sampler;
+    if (!sampler->streamable())
+      return false;
+    if (pipelined)
+      this->obj_mngr->set_sample_source(
+          make_shared<PipelinedSampleSource>(sampler, seed));
+    else
+      this->obj_mngr->set_sample_source(
+          make_shared<SampleStream>(sampler, seed));
+    return true;
+  }
+
+  float get_gc_cycle() { return gc_cycle; }
+
+  /*
+   * Places the extents of the stripes created from now on on the given
+   * storage nodes and tallies the GC and striping traffic of every node in
+   * every cycle.
+   */
+  void set_storage_nodes(shared_ptr<StorageNodes> nodes) {
+    this->storage_nodes = nodes;
+    this->stripe_mngr->nodes = nodes;
+    this->gc_strategy->set_storage_nodes(nodes);
+  }
+
+  /*
+   * Turns the traffic of the storage nodes into device busy time and
+   * foreground latency in every cycle. Needs the storage nodes to be set.
+   */
+  void set_device_model(shared_ptr<DeviceModel> model) {
+    this->device_model = model;
+  }
+
+  /*
+   * Ends the run once the monitor finds that the obsolete percentage and
+   * the GC ratio have converged, instead of at simul_time. The totals of
+   * the results then cover the run up to that point.
+   */
+  void set_steady_state(shared_ptr<SteadyStateMonitor> monitor) {
+    this->steady_state = monitor;
+  }
+
+  /*
+   * Changes the obsolete percentages at which stripes and extents are
+   * garbage collected from the next cycle on. The object packers keep the
+   * thresholds they were configured with.
+   */
+  void set_gc_thresholds(short primary_threshold, short secondary_threshold) {
+    this->gc_strategy->set_thresholds(primary_threshold, secondary_threshold);
+  }
+
+  /*
+   * Joins the helper threads of the data center, so that only the calling
+   * thread is left to be copied by fork(). The time series is closed for
+   * good, as forked copies of the data center cannot share its file.
+   */
+  void pause_threads() {
+    if (this->time_series) {
+      this->time_series->close();
+      this->time_series = nullptr;
+    }
+    if (this->obj_mngr->sample_source)
+      this->obj_mngr->sample_source->pause();
+    this->gc_strategy->set_thread_pool(nullptr);
+  }
+
+  void resume_threads() {
+    if (this->obj_mngr->sample_source)
+      this->obj_mngr->sample_source->resume();
+    this->set_gc_threads(this->gc_threads);
+  }
+
+  mem_report memory_usage() {
+    auto packer = coordinator->object_packer;
+    auto gc_packer = coordinator->gc_object_packer;
+    mem_usage pools = packer->pool_memory_usage();
+    mem_usage current_exts = packer->current_exts_memory_usage();
+    if (gc_packer->get_obj_pool() != packer->get_obj_pool())
+      pools += gc_packer->pool_memory_usage();
+    if (gc_packer->get_current_exts() != packer->get_current_exts())
+      current_exts += gc_packer->current_exts_memory_usage();
+    mem_usage stacks = coordinator->extent_stack->memory_usage();
+    if (coordinator->gc_extent_stack != coordinator->extent_stack)
+      stacks += coordinator->gc_extent_stack->memory_usage();
+    return {{"objects", obj_mngr->memory_usage()},
+            {"extents", ext_mngr->memory_usage()},
+            {"stripes", stripe_mngr->memory_usage()},
+            {"event heap", event_mngr->memory_usage()},
+            {"obj pools", pools},
+            {"current exts", current_exts},
+            {"extent stacks", stacks}};
+  }
 
   /*
    * Returns the amount of added obsolete data, a set of stripes affected by
@@ -147,14 +348,16 @@ public:
    */
   del_result del_object(obj_ptr obj) {
     del_result ret;
-    auto ext_lst = obj->extents;
+    // The object is dropped from all its extents, take the list over
+    // instead of copying it and removing the extents one by one
+    list<ext_ptr> ext_lst;
+    ext_lst.swap(obj->extents);
     //  std::reverse(ext_lst.begin(), ext_lst.end());
-    for (auto ex : ext_lst) {
+    for (auto &ex : ext_lst) {
       // cout << ex->type << endl;
-      obj->remove_extent(ex);
 
       // Size of obj in extent
-      float temp = ex->get_obj_size(obj);
+      capacity_t temp = ex->get_obj_size(obj);
       this->gced_space += temp;
       ex->del_object(obj);
 
@@ -168,7 +371,7 @@ public:
 
         // Update stripe level obsolete data amount
         // std::cout << temp << std::endl;
-        ex->stripe->update_obsolete(temp);
+        ex->stripe->update_obsolete(temp, ex->locality);
         ret.gc_stripes_set.emplace(ex->stripe);
         ret.total_added_obsolete += temp;
       } else if (this->coordinator->extent_in_extent_stacks(ex)) {
@@ -180,38 +383,68 @@ public:
         ex->free_space += temp;
       }
     }
+    this->coordinator->object_deleted(obj);
     this->obj_mngr->remove_object(obj);
     obj = nullptr;
     return ret;
   }
 
   /*
-   * Returns the metrics from the simulation
+   * Starts a run of the event handler at the current configtime. The run
+   * then advances one cycle at a time with run_cycle, with the caller moving
+   * configtime on by gc_cycle between cycles, until running() turns false.
    */
-  eh_result event_handler() {
-    eh_result ret;
-    configtime = 0.0;
-    double net_obsolete = 0;
-    double used_space = 0;
-    double daily_max_perc = 0.0;
-    double obs_perc = -1.0;
-    double obs_timestamp = -1.0;
-    float next_del_time = this->simul_time + 1.0;
-    vector<double> obs_percentages = vector<double>();
-    unordered_map<string, double> net_obs_by_ext_type =
-        unordered_map<string, double>();
-    obj_ptr next_del_obj = nullptr;
-    while (configtime <= this->simul_time &&
-           ret.dc_size < this->max_size) {
-      double added_obsolete_this_gc = 0;
-      unordered_map<string, double> added_obsolete_by_type =
-          unordered_map<string, double>();
-      // std::cout << "next_del_time" << next_del_time << "configtime " << configtime << "ret.dc_size" << ret.dc_size << std::endl;
-      for (auto it : this->obs_by_ext_types)
-        added_obsolete_by_type[it.first] = 0;
-
-      // Find all candidates for GC
-      set<stripe_ptr> * gc_stripes_set = new set<stripe_ptr>();
+  void start_run() {
+    this->run = run_state();
+    this->run.next_del_time = this->simul_time + 1.0;
+  }
+
+  bool running() {
+    return configtime <= this->simul_time && run.ret.dc_size < this->max_size &&
+           !(this->steady_state && this->steady_state->converged());
+  }
+
+  /*
+   * Runs the deletion, GC and striping phases of the cycle at configtime
+   * and accumulates its metrics. It only reads configtime, so data centers
+   * sharing the clock can run their cycles concurrently.
+   */
+  void run_cycle() {
+    eh_result &ret = run.ret;
+    capacity_t &net_obsolete = run.net_obsolete;
+    capacity_t &used_space = run.used_space;
+    double &daily_max_perc = run.daily_max_perc;
+    double &obs_perc = run.obs_perc;
+    double &obs_timestamp = run.obs_timestamp;
+    float &next_del_time = run.next_del_time;
+    vector<double> &obs_percentages = run.obs_percentages;
+    unordered_map<string, capacity_t> &net_obs_by_ext_type =
+        run.net_obs_by_ext_type;
+    obj_ptr &next_del_obj = run.next_del_obj;
+    long &num_cycles = run.num_cycles;
+
+    capacity_t added_obsolete_this_gc = 0;
+    unordered_map<string, capacity_t> added_obsolete_by_type =
+        unordered_map<string, capacity_t>();
+    // std::cout << "next_del_time" << next_del_time << "configtime " << configtime << "ret.dc_size" << ret.dc_size << std::endl;
+    for (auto it : this->obs_by_ext_types)
+      added_obsolete_by_type[it.first] = 0;
+
+    // The phases of a cycle are skipped when they would leave the stripes as
+    // they are, with the same per-cycle arithmetic for the metrics so that
+    // the results do not change. Deletion and GC are skipped in cycles
+    // without deletions or backlogged GC work, which are common in regular
+    // runs, while striping is only skipped once new objects stop arriving,
+    // i.e. with num_objs_in_pool of 0, as the object packers top their pools
+    // up every cycle.
+    bool gc_idle = this->skip_idle_cycles &&
+                   (next_del_time > configtime || event_mngr->empty()) &&
+                   !this->gc_strategy->has_pending_work();
+
+    // Find all candidates for GC
+    set<stripe_ptr> * gc_stripes_set = new set<stripe_ptr>();
+    if (!gc_idle) {
+      PROFILE_PHASE(Phase::Deletion);
       while (next_del_time <= configtime && !event_mngr->empty()) {
         del_result dr = this->del_object(next_del_obj);
         gc_stripes_set->insert(dr.gc_stripes_set.begin(),
@@ -242,102 +475,169 @@ public:
           next_del_obj = std::get<1>(e);
         }
       }
-      this->event_mngr->put_event(next_del_time, next_del_obj);
-      auto gc_ret = this->gc_strategy->gc_handler(*gc_stripes_set);
-      delete gc_stripes_set;
-      if (!this->event_mngr->empty()) {
-        auto e = this->event_mngr->events->top();
-        this->event_mngr->events->pop();
-        next_del_time = std::get<0>(e);
-        next_del_obj = std::get<1>(e);
-      }
-
-      ret.total_reclaimed_space += gc_ret.reclaimed_space;
-      ret.total_exts_gced += gc_ret.total_num_exts_replaced;
-      ret.new_obj_reads += gc_ret.total_user_reads;
-      ret.new_obj_writes += gc_ret.total_user_writes;
+      this->coordinator->repack_sealed_extents();
+    }
+    this->event_mngr->put_event(next_del_time, next_del_obj);
+    gc_handler_ret gc_ret;
+    if (!gc_idle) {
+      PROFILE_PHASE(Phase::GCHandler);
+      if (this->storage_nodes)
+        this->storage_nodes->set_gc_phase(true);
+      gc_ret = this->gc_strategy->gc_handler(*gc_stripes_set);
+      if (this->storage_nodes)
+        this->storage_nodes->set_gc_phase(false);
+    } else {
+      gc_ret = this->gc_strategy->idle_result();
+    }
+    delete gc_stripes_set;
+    if (!this->event_mngr->empty()) {
+      auto e = this->event_mngr->events->top();
+      this->event_mngr->events->pop();
+      next_del_time = std::get<0>(e);
+      next_del_obj = std::get<1>(e);
+    }
 
-      ret.total_valid_obj_transfers += gc_ret.total_valid_obj_transfers;
-      ret.total_storage_node_to_parity_calculator +=
-          gc_ret.total_storage_node_to_parity_calculator;
+    ret.total_reclaimed_space += gc_ret.reclaimed_space;
+    ret.total_exts_gced += gc_ret.total_num_exts_replaced;
+    ret.new_obj_reads += gc_ret.total_user_reads;
+    ret.new_obj_writes += gc_ret.total_user_writes;
+
+    ret.total_valid_obj_transfers += gc_ret.total_valid_obj_transfers;
+    ret.total_storage_node_to_parity_calculator +=
+        gc_ret.total_storage_node_to_parity_calculator;
+
+    ret.total_global_parity_reads += gc_ret.total_global_parity_reads;
+    ret.total_global_parity_writes += gc_ret.total_global_parity_writes;
+    ret.total_local_parity_reads += gc_ret.total_local_parity_reads;
+    ret.total_local_parity_writes += gc_ret.total_local_parity_writes;
+    ret.total_obsolete_data_reads += gc_ret.total_obsolete_data_reads;
+    ret.total_absent_data_reads += gc_ret.total_absent_data_reads;
+    if (gc_ret.gc_budget > 0) {
+      ret.total_gc_budget += gc_ret.gc_budget;
+      ret.total_gc_traffic += gc_ret.bandwidth();
+      ret.max_gc_backlog = std::max(ret.max_gc_backlog, gc_ret.backlog_space);
+    }
 
-      ret.total_global_parity_reads += gc_ret.total_global_parity_reads;
-      ret.total_global_parity_writes += gc_ret.total_global_parity_writes;
-      ret.total_local_parity_reads += gc_ret.total_local_parity_reads;
-      ret.total_local_parity_writes += gc_ret.total_local_parity_writes;
-      ret.total_obsolete_data_reads += gc_ret.total_obsolete_data_reads;
-      ret.total_absent_data_reads += gc_ret.total_absent_data_reads;
+    net_obsolete += added_obsolete_this_gc - gc_ret.reclaimed_space;
 
-      net_obsolete += added_obsolete_this_gc - gc_ret.reclaimed_space;
+    for (auto it : gc_ret.total_reclaimed_space_by_ext_type) {
+      if (ret.total_reclaimed_space_by_ext_type.find(it.first) ==
+          ret.total_reclaimed_space_by_ext_type.end())
+        ret.total_reclaimed_space_by_ext_type[it.first] = it.second;
+      else
+        ret.total_reclaimed_space_by_ext_type[it.first] += it.second;
+    }
+    for (auto it : this->obs_by_ext_types) {
+      const string type = it.first;
+      auto net_obs_it = net_obs_by_ext_type.find(type);
+      auto total_rec_it = gc_ret.total_reclaimed_space_by_ext_type.find(type);
+
+      if (net_obs_it != net_obs_by_ext_type.end() &&
+          total_rec_it != gc_ret.total_reclaimed_space_by_ext_type.end())
+        net_obs_by_ext_type[type] +=
+            added_obsolete_by_type[type] -
+            gc_ret.total_reclaimed_space_by_ext_type[type];
+      else if (net_obs_it != net_obs_by_ext_type.end())
+        net_obs_by_ext_type[type] += added_obsolete_by_type[type];
+      else if (total_rec_it != gc_ret.total_reclaimed_space_by_ext_type.end())
+        net_obs_by_ext_type[type] =
+            added_obsolete_by_type[type] -
+            gc_ret.total_reclaimed_space_by_ext_type[type];
+      else
+        net_obs_by_ext_type[type] = added_obsolete_by_type[type];
 
-      for (auto it : gc_ret.total_reclaimed_space_by_ext_type) {
-        if (ret.total_reclaimed_space_by_ext_type.find(it.first) ==
-            ret.total_reclaimed_space_by_ext_type.end())
-          ret.total_reclaimed_space_by_ext_type[it.first] = it.second;
-        else
-          ret.total_reclaimed_space_by_ext_type[it.first] += it.second;
-      }
-      for (auto it : this->obs_by_ext_types) {
-        const string type = it.first;
-        auto net_obs_it = net_obs_by_ext_type.find(type);
-        auto total_rec_it = gc_ret.total_reclaimed_space_by_ext_type.find(type);
-
-        if (net_obs_it != net_obs_by_ext_type.end() &&
-            total_rec_it != gc_ret.total_reclaimed_space_by_ext_type.end())
-          net_obs_by_ext_type[type] +=
-              added_obsolete_by_type[type] -
-              gc_ret.total_reclaimed_space_by_ext_type[type];
-        else if (net_obs_it != net_obs_by_ext_type.end())
-          net_obs_by_ext_type[type] += added_obsolete_by_type[type];
-        else if (total_rec_it != gc_ret.total_reclaimed_space_by_ext_type.end())
-          net_obs_by_ext_type[type] =
-              added_obsolete_by_type[type] -
-              gc_ret.total_reclaimed_space_by_ext_type[type];
-        else
-          net_obs_by_ext_type[type] = added_obsolete_by_type[type];
+      this->obs_by_ext_types[type] +=
+          net_obs_by_ext_type[type] * this->gc_cycle;
+    }
 
-        this->obs_by_ext_types[type] +=
-            net_obs_by_ext_type[type] * this->gc_cycle;
-      }
+    if (next_del_obj)
+      this->event_mngr->put_event(next_del_time, next_del_obj);
 
-      if (next_del_obj)
-        this->event_mngr->put_event(next_del_time, next_del_obj);
+    // Deletion and GC may have given the object packer objects to repack
+    bool striping_idle =
+        this->skip_idle_cycles && this->coordinator->striping_idle();
+    str_costs str_result = {0};
+    if (!striping_idle) {
+      PROFILE_PHASE(Phase::GenerateStripes);
+      str_result = this->coordinator->generate_stripes();
+    }
+    if (!this->event_mngr->empty()) {
+      auto e = this->event_mngr->events->top();
+      this->event_mngr->events->pop();
+      next_del_time = std::get<0>(e);
+      next_del_obj = std::get<1>(e);
+    }
+    ret.total_used_space += used_space * this->striping_cycle;
+    ret.new_obj_writes += str_result.writes;
+    ret.new_obj_reads += str_result.reads;
+    
+    ret.striper_parities += (str_result.writes - str_result.reads);
+
+    used_space = this->stripe_mngr->get_data_dc_size();
+
+    ret.total_obsolete += net_obsolete * this->gc_cycle;
+    obs_perc = -1;
+    if (used_space > 0)
+      obs_perc = (double)(added_obsolete_this_gc + net_obsolete) /
+                 used_space * 100;
+    daily_max_perc = std::max(obs_perc, daily_max_perc);
+
+    // Keep a record of the daily maximum obsolete percentage, ignore
+    // the first month since the data center is too small at that point
+    if (configtime > 30 && obs_perc > ret.max_obs_perc)
+      ret.max_obs_perc = obs_perc;
+    if (std::round(configtime) - round(obs_timestamp) >= 1) {
+      obs_percentages.emplace_back(daily_max_perc);
+      obs_timestamp = configtime;
+      daily_max_perc = 0;
+    }
 
-      auto str_result = this->coordinator->generate_stripes();
-      if (!this->event_mngr->empty()) {
-        auto e = this->event_mngr->events->top();
-        this->event_mngr->events->pop();
-        next_del_time = std::get<0>(e);
-        next_del_obj = std::get<1>(e);
-      }
-      ret.total_used_space += used_space * this->striping_cycle;
-      ret.new_obj_writes += str_result.writes;
-      ret.new_obj_reads += str_result.reads;
-      
-      ret.striper_parities += (str_result.writes - str_result.reads);
-
-      used_space = this->stripe_mngr->get_data_dc_size();
-
-      ret.total_obsolete += net_obsolete * this->gc_cycle;
-      obs_perc = -1;
-      if (used_space > 0)
-        obs_perc =
-            (added_obsolete_this_gc + net_obsolete) / used_space * 100;
-      daily_max_perc = std::max(obs_perc, daily_max_perc);
-
-      // Keep a record of the daily maximum obsolete percentage, ignore
-      // the first month since the data center is too small at that point
-      if (configtime > 30 && obs_perc > ret.max_obs_perc)
-        ret.max_obs_perc = obs_perc;
-      if (std::round(configtime) - round(obs_timestamp) >= 1) {
-        obs_percentages.emplace_back(daily_max_perc);
-        obs_timestamp = configtime;
-        daily_max_perc = 0;
-      }
+    if (this->steady_state)
+      this->steady_state->add_cycle(configtime, obs_perc, gc_ret.bandwidth(),
+                                    str_result.writes);
+
+    double max_node_gc_traffic = 0;
+    if (this->storage_nodes) {
+      if (this->device_model)
+        this->device_model->add_cycle(
+            this->storage_nodes->get_cycle_traffic(),
+            this->gc_cycle * 24 * 60 * 60);
+      max_node_gc_traffic = this->storage_nodes->end_cycle();
+    }
 
-      configtime += this->gc_cycle;
-      ret.dc_size = this->stripe_mngr->get_total_dc_size();
+    ret.dc_size = this->stripe_mngr->get_total_dc_size();
+    if (this->time_series && num_cycles % this->time_series_interval == 0) {
+      cycle_record rec;
+      rec.time = configtime;
+      rec.obs_perc = obs_perc;
+      rec.dc_size = ret.dc_size;
+      rec.used_space = used_space;
+      rec.added_obsolete = added_obsolete_this_gc;
+      rec.reclaimed_space = gc_ret.reclaimed_space;
+      rec.gc_bandwidth = gc_ret.bandwidth();
+      rec.user_writes = str_result.writes;
+      rec.num_exts_gced = gc_ret.total_num_exts_replaced;
+      if (gc_ret.gc_budget > 0)
+        rec.gc_budget_utilization = gc_ret.bandwidth() / gc_ret.gc_budget;
+      rec.gc_backlog = gc_ret.backlog_space;
+      rec.gc_backlog_stripes = gc_ret.backlog_stripes;
+      rec.num_stripes = this->stripe_mngr->get_num_stripes();
+      rec.max_node_gc_traffic = max_node_gc_traffic;
+      this->time_series->append(rec);
     }
+    if (this->memory_report_interval > 0 &&
+        num_cycles % this->memory_report_interval == 0)
+      this->memory_tracker.add_sample(configtime, this->memory_usage());
+    num_cycles++;
+  }
+
+  // Ends the run and returns its metrics
+  eh_result finish_run() {
+    eh_result &ret = run.ret;
+    if (this->time_series)
+      this->time_series->flush();
+    if (this->memory_report_interval > 0)
+      this->memory_tracker.add_sample(configtime, this->memory_usage());
 
     cout << "Number of objects in dc: " << this->obj_mngr->get_num_objs()
          << endl;
@@ -348,13 +648,30 @@ public:
     cout << "Ave number of exts gc'ed per cycle "
          << ret.total_exts_gced / ((configtime)*1 / this->striping_cycle)
          << endl;
-    ret.obs_percentages = obs_percentages;
+    if (this->steady_state)
+      ret.steady_state = this->steady_state->result();
+    ret.obs_percentages = run.obs_percentages;
     return ret;
   }
 
-  sim_metric run_simulation() {
+  /*
+   * Returns the metrics from the simulation
+   */
+  eh_result event_handler() {
+    configtime = 0.0;
+    start_run();
+    while (running()) {
+      run_cycle();
+      configtime += this->gc_cycle;
+    }
+    return finish_run();
+  }
+
+  sim_metric run_simulation() { return this->get_sim_metric(this->event_handler()); }
+
+  // Metrics of the simulation from the result of its event handler
+  sim_metric get_sim_metric(eh_result eh) {
     sim_metric ret;
-    eh_result eh = this->event_handler();
     ret.obs_percentages = eh.obs_percentages;
     ret.total_obsolete = eh.total_obsolete;
     ret.dc_size = eh.dc_size;
@@ -410,9 +727,47 @@ public:
     ret.gc_ratio = ret.total_gc_bandwidth / total_user_bandwidth;
 
     printf("Total reclaimed space %.0f\n", ret.total_reclaimed_space);
-    printf("Total deleted %.0f\n", this->gced_space);
+    printf("Total deleted %.0f\n", (double)this->gced_space);
     printf("Total data size of dc %.0f\n", stripe_mngr->get_data_dc_size());
     printf("GC bandwidth %.8Le\n", ret.total_gc_bandwidth);
+    if (eh.total_gc_budget > 0) {
+      ret.gc_budget_utilization = eh.total_gc_traffic / eh.total_gc_budget;
+      ret.max_gc_backlog = eh.max_gc_backlog;
+      printf("GC budget utilization %.4f, max backlog %.0f\n",
+             ret.gc_budget_utilization, (double)ret.max_gc_backlog);
+    }
+    ret.steady_state = eh.steady_state;
+    if (eh.steady_state.converged)
+      printf("Steady state on day %.2f: obsolete %% %.4f +- %.4f, GC ratio "
+             "%.4f +- %.4f\n",
+             eh.steady_state.time, eh.steady_state.obs_perc.mean,
+             eh.steady_state.obs_perc.error, eh.steady_state.gc_ratio.mean,
+             eh.steady_state.gc_ratio.error);
+    if (this->storage_nodes) {
+      ret.peak_node_traffic = this->storage_nodes->get_peak_node_traffic();
+      ret.peak_node_gc_traffic = this->storage_nodes->get_peak_node_gc_traffic();
+      ret.node_gc_imbalance = this->storage_nodes->gc_imbalance();
+      this->storage_nodes->print();
+    }
+    if (this->storage_nodes && this->device_model) {
+      ret.device = this->device_model->result();
+      this->device_model->print();
+    }
+    if (this->storage_nodes && this->storage_nodes->has_ftl()) {
+      ret.ftl = this->storage_nodes->get_ftl_result();
+      // total_user_data_reads is the user data written over the run
+      if (ret.total_user_data_reads > 0)
+        ret.ftl.end_to_end_waf =
+            ret.ftl.flash_writes / ret.total_user_data_reads;
+      printf("FTL host writes %.4e, flash writes %.4e, device WAF %.4f, "
+             "end-to-end WAF %.4f\n",
+             ret.ftl.host_writes, ret.ftl.flash_writes, ret.ftl.device_waf,
+             ret.ftl.end_to_end_waf);
+      printf("Flash erases %lld, per block mean %.4f max %d, extra blocks "
+             "%lld\n",
+             ret.ftl.erases, ret.ftl.mean_block_erases,
+             ret.ftl.max_block_erases, ret.ftl.extra_blocks);
+    }
     ret.gced_by_type = this->gc_strategy->get_gc_ed_exts_by_type();
 
     ret.types = this->coordinator->get_extent_types();
@@ -470,6 +825,8 @@ public:
       printf( "Obs %% per ext for %s: %.6Lf \n", it.first.c_str(), it.second);
       total_obs_percent += it.second;
     }
+    PROFILE_REPORT();
+    this->memory_tracker.print();
 
     return ret;
   }
@@ -0,0 +1,137 @@
+#ifndef __DEVICE_MODEL_H_
+#define __DEVICE_MODEL_H_
+
+#include "placement.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using std::vector;
+
+struct device_params {
+  // Sustained throughput of a storage node's device in size units (those of
+  // ext_size) per second
+  double read_throughput = 2e6;
+  double write_throughput = 1e6;
+  // Requests the device serves in parallel
+  int queue_depth = 32;
+  // Latency of a foreground request on an idle device and the latency it
+  // should stay under, in milliseconds
+  double base_latency = 0.1;
+  double slo_latency = 1.0;
+};
+
+struct device_result {
+  // Device time spent on all traffic and on GC traffic, in seconds summed
+  // over the nodes
+  double busy_time = 0;
+  double gc_busy_time = 0;
+  // Largest utilization of a device in a cycle
+  double max_utilization = 0;
+  // Foreground latency percentiles in milliseconds, and the fraction of
+  // foreground traffic served slower than the SLO
+  double latency_p50 = 0;
+  double latency_p99 = 0;
+  double latency_p999 = 0;
+  double slo_violation = 0;
+};
+
+/*
+ * Turns the traffic every storage node sees in a cycle into device busy
+ * time and an estimated latency of the foreground (striping) writes of the
+ * cycle. A device is busy for reads / read_throughput + writes /
+ * write_throughput of every cycle, and its utilization rho is its busy time
+ * over the length of the cycle. Foreground requests see the latency curve
+ *
+ *   base_latency * (1 + rho / (queue_depth * (1 - rho)))
+ *
+ * that grows with the queueing behind the GC and the other foreground
+ * traffic; a saturated device (rho >= 1) gets the largest latency the
+ * histogram tracks. The latency percentiles are over the foreground bytes,
+ * so nodes and cycles with more user writes weigh more.
+ */
+class DeviceModel {
+  device_params params;
+  device_result res;
+  // Foreground bytes by latency, in buckets growing by 10^(1/50) from
+  // base_latency
+  vector<double> histogram;
+  static constexpr int buckets_per_decade = 50;
+  static constexpr int num_decades = 5;
+  double total_foreground = 0, slow_foreground = 0;
+
+  double bucket_latency(size_t i) {
+    return params.base_latency * std::pow(10.0, (double)i / buckets_per_decade);
+  }
+
+  double percentile(double p) {
+    double target = p * total_foreground, seen = 0;
+    for (size_t i = 0; i < histogram.size(); i++) {
+      seen += histogram[i];
+      if (seen >= target && histogram[i] > 0)
+        return bucket_latency(i);
+    }
+    return 0;
+  }
+
+public:
+  DeviceModel(device_params params)
+      : params(params),
+        histogram(buckets_per_decade * num_decades + 1, 0) {}
+
+  double latency(double utilization) {
+    if (utilization >= 1)
+      return bucket_latency(histogram.size() - 1);
+    return params.base_latency *
+           (1 + utilization / (params.queue_depth * (1 - utilization)));
+  }
+
+  // Adds the traffic of a cycle of cycle_seconds
+  void add_cycle(const vector<node_cycle_traffic> &traffic,
+                 double cycle_seconds) {
+    for (auto &t : traffic) {
+      double gc_busy = t.gc_reads / params.read_throughput +
+                       t.gc_writes / params.write_throughput;
+      double busy = gc_busy + t.striping_writes / params.write_throughput;
+      res.gc_busy_time += gc_busy;
+      res.busy_time += busy;
+      double utilization = busy / cycle_seconds;
+      res.max_utilization = std::max(res.max_utilization, utilization);
+      if (t.striping_writes <= 0)
+        continue;
+      double lat = latency(utilization);
+      int bucket = std::ceil(std::log10(lat / params.base_latency) *
+                             buckets_per_decade - 1e-9);
+      bucket = std::min(std::max(bucket, 0), (int)histogram.size() - 1);
+      histogram[bucket] += t.striping_writes;
+      total_foreground += t.striping_writes;
+      if (lat > params.slo_latency)
+        slow_foreground += t.striping_writes;
+    }
+  }
+
+  device_result result() {
+    device_result ret = res;
+    if (total_foreground > 0) {
+      ret.latency_p50 = percentile(0.5);
+      ret.latency_p99 = percentile(0.99);
+      ret.latency_p999 = percentile(0.999);
+      ret.slo_violation = slow_foreground / total_foreground;
+    }
+    return ret;
+  }
+
+  void print() {
+    device_result r = result();
+    printf("Device busy time %.4e s, of which GC %.4e s, max utilization "
+           "%.4f\n",
+           r.busy_time, r.gc_busy_time, r.max_utilization);
+    printf("Foreground latency p50 %.4f ms, p99 %.4f ms, p99.9 %.4f ms, "
+           "over SLO (%.4f ms) %.4f%%\n",
+           r.latency_p50, r.latency_p99, r.latency_p999, params.slo_latency,
+           r.slo_violation * 100);
+  }
+};
+
+#endif // __DEVICE_MODEL_H_
@@ -1,5 +1,6 @@
 #pragma once
 #include "extent_object_stripe.h"
+#include "memory_accounting.h"
 #include <list>
 #include <queue>
 
@@ -8,7 +9,21 @@ using std::priority_queue;
 
 // im using std tuple
 using event = std::tuple<float, obj_ptr>;
-using e_queue = std::priority_queue<event, std::vector<event>, std::greater<event>>;
+
+// Earliest event first; objects deleted at the same time go by id rather than
+// by where they were allocated, so that runs are reproducible. Events without
+// an object come before the others, as they did when ordered by pointer.
+struct event_order {
+  bool operator()(const event &a, const event &b) const {
+    if (std::get<0>(a) != std::get<0>(b))
+      return std::get<0>(a) > std::get<0>(b);
+    const obj_ptr &o1 = std::get<1>(a), &o2 = std::get<1>(b);
+    if (o1 == nullptr || o2 == nullptr)
+      return o1 != nullptr && o2 == nullptr;
+    return o1->id > o2->id;
+  }
+};
+using e_queue = std::priority_queue<event, std::vector<event>, event_order>;
 
 class EventManager {
 public:
@@ -16,7 +31,7 @@ public:
 
   EventManager() : events(new e_queue()) {}
 
-  void put_event(float life, obj_ptr obj) {
+  void put_event(float life, const obj_ptr &obj) {
     events->emplace(event(life, obj));
   }
 
@@ -26,4 +41,12 @@ public:
     }
   }
   bool empty() { return events->empty(); }
+
+  // The heap's capacity is hidden by priority_queue, so only count its size
+  mem_usage memory_usage() {
+    mem_usage ret;
+    ret.count = events->size();
+    ret.bytes = events->size() * sizeof(event);
+    return ret;
+  }
 };
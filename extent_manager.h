@@ -1,15 +1,16 @@
 #pragma once
 #include "extent_object_stripe.h"
+#include "memory_accounting.h"
 #include <any>
 #include <unordered_map>
 #include <set>
 class ExtentManager {
 public:
-  int ext_size;
+  capacity_t ext_size;
   std::set<ext_ptr > exts;
   int max_id;
   float (Extent::*key_fnc)();
-  ExtentManager(int s, float (Extent::*k_f)())
+  ExtentManager(capacity_t s, float (Extent::*k_f)())
       : ext_size(s), key_fnc(k_f), exts(std::set<ext_ptr >()) {
         max_id = 0;
       }
@@ -18,7 +19,20 @@ public:
 
   int get_num_ext() { return exts.size(); }
 
-  ext_ptr create_extent(int s = 0, int secondary_threshold = 15) {
+  /*
+   * Live extents, including the object to shard map of every extent.
+   */
+  mem_usage memory_usage() {
+    mem_usage ret;
+    ret.count = exts.size();
+    ret.bytes = mem_size::of(exts);
+    for (auto &e : exts)
+      ret.bytes += mem_size::shared_block + sizeof(Extent) +
+                   mem_size::of(e->objects);
+    return ret;
+  }
+
+  ext_ptr create_extent(capacity_t s = 0, int secondary_threshold = 15) {
     ext_ptr e;
     if (!s)
       e = make_shared<Extent>(ext_size, secondary_threshold, max_id);
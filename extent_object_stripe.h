@@ -1,8 +1,10 @@
 #pragma once
 #include "config.h"
+#include <algorithm>
 #include <memory>
 #include <ctime>
 #include <iostream>
+#include <cstdint>
 #include <list>
 #include <numeric>
 #include <unordered_map>
@@ -19,21 +21,25 @@ using std::make_shared;
 using obj_ptr = std::shared_ptr<ExtentObject>;
 using ext_ptr = std::shared_ptr<Extent>;
 using stripe_ptr = std::shared_ptr<Stripe>;
-using obj_record = std::pair<obj_ptr, float>;
+// Capacity is accounted in whole size units (the unit of the sampled object
+// sizes and of ext_size). Integer sums are exact, so two runs can be
+// compared bit for bit; convert to floating point only when reporting.
+using capacity_t = std::int64_t;
+using obj_record = std::pair<obj_ptr, capacity_t>;
 using object_lst = std::vector<obj_record>;
 
 class ExtentObject: public std::enable_shared_from_this<ExtentObject> {
 protected:
 public:
   int id;
-  float size;
+  capacity_t size;
   double life;
   int generation;
   float creation_time;
   int num_times_gced;
   list<ext_ptr> extents;
 
-  ExtentObject(int id, float s, float l)
+  ExtentObject(int id, capacity_t s, float l)
       : id(id), size(s), life(l), generation(0), num_times_gced(0),
         creation_time(configtime), extents(list<ext_ptr>()) {}
 
@@ -53,7 +59,7 @@ public:
 
   void add_extent(ext_ptr e) { this->extents.emplace_back(e); }
 
-  void remove_extent(ext_ptr e) {
+  void remove_extent(const ext_ptr &e) {
     for (auto it = this->extents.begin(); it != this->extents.end(); it++) {
       if (*it == e) {
         this->extents.erase(it);
@@ -68,15 +74,22 @@ public:
 
 class Extent: public std::enable_shared_from_this<Extent> {
 public:
-  double obsolete_space;
-  double free_space;
+  capacity_t obsolete_space;
+  capacity_t free_space;
   int id;
-  double ext_size;
+  capacity_t ext_size;
 
   //unordered_map<obj_ptr, list<shard_ptr>> objects;
-  unordered_map<obj_ptr, vector<float>> objects;
+  // Objects of the extent along with the total size of their shards in it
+  unordered_map<obj_ptr, capacity_t> objects;
+  // Size of the largest object in the extent (-1 if there is none), kept up
+  // to date as objects are added and deleted so that the extent type can
+  // be found without walking the objects
+  capacity_t largest_obj;
   stripe_ptr stripe;
   int locality;
+  // Slot of the extent in its stripe (-1 if it is not in one)
+  int slot;
   int generation;
   float timestamp;
   string type;
@@ -92,23 +105,55 @@ public:
 
   float get_generation() { return generation; }
 
-  Extent(double e_s, int s_t, int i)
+  Extent(capacity_t e_s, int s_t, int i)
       : obsolete_space(0), free_space(e_s), ext_size(e_s), id(i),
-        objects(unordered_map<obj_ptr, vector<float>>()),
-        locality(0), generation(0), timestamp(configtime), type("0"),
-        secondary_threshold(s_t), stripe(nullptr) {}
+        objects(unordered_map<obj_ptr, capacity_t>()),
+        largest_obj(-1), locality(0), slot(-1), generation(0), timestamp(configtime),
+        type("0"), secondary_threshold(s_t), stripe(nullptr) {}
 
   double get_age() { return difftime(time(nullptr), timestamp); }
 
-  float get_obj_size(obj_ptr obj) {
-    auto sizes = this->objects[obj];
-    return std::accumulate(sizes.begin(), sizes.end(), 0);
+  capacity_t get_obj_size(const obj_ptr &obj) {
+    auto it = this->objects.find(obj);
+    if (it == this->objects.end())
+      return 0;
+    return it->second;
+  }
+
+  // Objects of the extent along with their size in it, ordered by object id
+  // so that repacking does not depend on where the objects were allocated
+  object_lst get_obj_records() {
+    object_lst records;
+    records.reserve(objects.size());
+    for (auto &obj_kv : objects)
+      records.emplace_back(obj_kv.first, obj_kv.second);
+    sort_by_id(records.begin(), records.end());
+    return records;
+  }
+
+  // Smallest id of the objects of the extent, -1 if it has none
+  int min_obj_id() {
+    int ret = -1;
+    for (auto &kv : objects)
+      if (ret == -1 || kv.first->id < ret)
+        ret = kv.first->id;
+    return ret;
+  }
+
+  static void sort_by_id(object_lst::iterator first,
+                         object_lst::iterator last) {
+    std::sort(first, last, [](const obj_record &a, const obj_record &b) {
+      return a.first->id < b.first->id;
+    });
   }
 
-  double get_obsolete_percentage() { return obsolete_space / ext_size * 100; }
+  double get_obsolete_percentage() {
+    return (double)obsolete_space / ext_size * 100;
+  }
 
-  float add_object(obj_ptr obj, float size, int generation = 0) {
-    float temp_size = size < free_space ? size : free_space;
+  capacity_t add_object(const obj_ptr &obj, capacity_t size,
+                        int generation = 0) {
+    capacity_t temp_size = size < free_space ? size : free_space;
     int obj_id = obj->id;
     if (timestamp == 0)
       timestamp = obj->creation_time;
@@ -120,85 +165,114 @@ public:
     else if (generation > this->generation)
       this->generation = obj->generation;
 
-    if (this->objects.find(obj) != this->objects.end()) {
-      this->objects[obj].emplace_back(temp_size);
+    auto it = this->objects.find(obj);
+    if (it != this->objects.end()) {
+      it->second += temp_size;
     } else {
       obj->add_extent(shared_from_this());
-      auto shard_lst = vector<float>();
-      shard_lst.push_back(temp_size);
-      this->objects.emplace(std::make_pair(obj, shard_lst));
+      it = this->objects.emplace(obj, temp_size).first;
     }
+    capacity_t obj_size = it->second;
+    if (obj_size > largest_obj)
+      largest_obj = obj_size;
     free_space -= temp_size;
     return temp_size;
   }
 
   void remove_objects() {
-    for (auto obj : this->objects) {
-      obj.first->remove_extent(shared_from_this());
+    ext_ptr self = shared_from_this();
+    for (auto &obj : this->objects) {
+      obj.first->remove_extent(self);
     }
     this->objects.clear();
+    largest_obj = -1;
   }
 
   double del_object(obj_ptr obj) { 
     auto it = this->objects.find(obj);
     if (it != this->objects.end()) {
-      this->obsolete_space += std::accumulate(it->second.begin(), it->second.end(), 0);
-      this->objects[obj].clear();
-      this->objects.erase(obj);
+      capacity_t obj_size = it->second;
+      this->obsolete_space += obj_size;
+      this->objects.erase(it);
+      if (obj_size >= largest_obj)
+        update_largest_obj();
     }
-    return obsolete_space / ext_size * 100;
+    return (double)obsolete_space / ext_size * 100;
   }
 
-  object_lst delete_ext() {
-    object_lst ret;
-
-    for (auto & it : objects) {
-      float sum = 0;
-      for (auto s : it.second) {
-        sum += s;
-      }
-      it.first->extents.remove(shared_from_this());
-      ret.push_back(std::make_pair(it.first, sum));
-    }
+  void update_largest_obj() {
+    largest_obj = -1;
+    for (auto &kv : this->objects)
+      if (kv.second > largest_obj)
+        largest_obj = kv.second;
+  }
 
-    for (auto & it : objects) {
-      float sum = 0;
-      for (auto shard : it.second)
-        sum += shard;
+  /*
+   * Detaches the extent from its objects and appends each object with the
+   * size it had in this extent to out, so that callers can reuse a buffer.
+   * The appended records are ordered by object id.
+   */
+  void delete_ext(object_lst &out) {
+    size_t first = out.size();
+    out.reserve(out.size() + objects.size());
+    ext_ptr self = shared_from_this();
+    for (auto &it : objects) {
+      it.first->extents.remove(self);
+      out.emplace_back(it.first, it.second);
     }
+    sort_by_id(out.begin() + first, out.end());
 
     generation = 0;
     free_space = ext_size;
-    return ret;
   }
 };
 
 class Stripe: public std::enable_shared_from_this<Stripe> {
 public:
   int id;
-  double obsolete;
+  capacity_t obsolete;
   int num_data_blocks;
   int num_localities;
   double free_space;
   vector<int> localities;
-  int ext_size;
+  capacity_t ext_size;
   double timestamp;
-  int stripe_size;
+  capacity_t stripe_size;
   int primary_threshold;
-  list<ext_ptr> extents;
+  // The stripe has a fixed slot for every data extent, grouped by locality
+  // so that slot i belongs to locality i / num_data_blocks. Empty slots hold
+  // nullptr and have their bit set in free_slots.
+  vector<ext_ptr> slots;
+  vector<std::uint64_t> free_slots;
+  // Obsolete and valid data of the extents in each locality, kept up to date
+  // as extents are added and deleted and as their objects die
+  vector<capacity_t> locality_obsolete;
+  vector<capacity_t> locality_valid;
+  // Storage nodes of the data slots followed by those of the parities,
+  // empty unless the data center models its storage nodes
+  vector<int> nodes;
+  // First logical page of the extent of every slot in the FTL of its node,
+  // empty unless the storage nodes model their FTLs
+  vector<std::uint32_t> ftl_extents;
 
   Stripe(int id, int num_data_extents_per_locality, int num_localities,
-         int ext_size, int primary_threshold)
+         capacity_t ext_size, int primary_threshold)
       : id(id), obsolete(0), num_data_blocks(num_data_extents_per_locality),
         num_localities(num_localities),
         free_space(num_localities * num_data_extents_per_locality),
         localities(vector<int>(num_localities, 0)), ext_size(ext_size),
         timestamp(0), primary_threshold(primary_threshold),
-        extents(list<ext_ptr>()) {
+        slots(num_localities * num_data_extents_per_locality),
+        free_slots((slots.size() + 63) / 64, ~std::uint64_t(0)),
+        locality_obsolete(num_localities, 0),
+        locality_valid(num_localities, 0) {
     this->stripe_size = 0;
     for (int i = 0; i < num_data_blocks * num_localities; ++i) {
       this->stripe_size += ext_size;
     }
+    // Clear the bits past the last slot so they are never handed out
+    if (slots.size() % 64)
+      free_slots.back() = (std::uint64_t(1) << (slots.size() % 64)) - 1;
   }
 
   //????the python code doesnt seem right, need to ask///
@@ -211,41 +285,82 @@ public:
   :rtype: float
   """
   self.obsolete += obsolete*/
-  double update_obsolete(double obsolete) {
+  capacity_t update_obsolete(capacity_t obsolete) {
     this->obsolete += obsolete;
     return this->obsolete;
   }
 
-  double get_obsolete_percentage() { return obsolete / stripe_size * 100; }
+  /*
+   * Same as above for data that became obsolete in an extent of the given
+   * locality, which also moves it from the valid to the obsolete total of
+   * that locality.
+   */
+  capacity_t update_obsolete(capacity_t obsolete, int locality) {
+    locality_obsolete[locality] += obsolete;
+    locality_valid[locality] -= obsolete;
+    return update_obsolete(obsolete);
+  }
+
+  double get_obsolete_percentage() {
+    return (double)obsolete / stripe_size * 100;
+  }
 
   int get_num_data_exts() { return num_data_blocks * num_localities; }
 
+  int num_slots() { return slots.size(); }
+
+  int slot_locality(int slot) { return slot / num_data_blocks; }
+
+  // Lowest free slot, or -1 if the stripe is full
+  int first_free_slot() {
+    for (size_t i = 0; i < free_slots.size(); i++)
+      if (free_slots[i])
+        return i * 64 + __builtin_ctzll(free_slots[i]);
+    return -1;
+  }
+
+  /*
+   * Puts the extent in the lowest free slot, which is in the first locality
+   * that is not full yet.
+   */
   void add_extent(ext_ptr ext) {
-    if (free_space > 0) {
-      extents.push_back(ext);
-      ext->stripe = shared_from_this();
-      free_space -= 1;
-      int locality = 0;
-      while (localities[locality] == num_data_blocks) {
-        locality += 1;
-      }
-      localities[locality] += 1;
-      ext->locality = locality;
-      if (ext->timestamp > timestamp) {
-        this->timestamp = ext->timestamp;
-      }
-    } else {
+    int slot = first_free_slot();
+    if (slot < 0) {
       std::cerr << "Attempt to add extent to a full stripe";
+      return;
+    }
+    slots[slot] = ext;
+    free_slots[slot / 64] &= ~(std::uint64_t(1) << (slot % 64));
+    ext->stripe = shared_from_this();
+    free_space -= 1;
+    int locality = slot_locality(slot);
+    localities[locality] += 1;
+    locality_obsolete[locality] += ext->obsolete_space;
+    locality_valid[locality] += ext->ext_size - ext->obsolete_space;
+    ext->locality = locality;
+    ext->slot = slot;
+    if (ext->timestamp > timestamp) {
+      this->timestamp = ext->timestamp;
     }
   }
 
-  void del_extent(ext_ptr ext) {
+  // Removes the extent in the given slot from the stripe
+  void del_extent(int slot) {
+    ext_ptr ext = std::move(slots[slot]);
+    free_slots[slot / 64] |= std::uint64_t(1) << (slot % 64);
     ext->stripe = nullptr;
     ext->remove_objects();
     localities[ext->locality] -= 1;
+    locality_obsolete[ext->locality] -= ext->obsolete_space;
+    locality_valid[ext->locality] -= ext->ext_size - ext->obsolete_space;
     obsolete -= ext->obsolete_space;
-    extents.remove(ext);
     free_space += 1;
+    ext->slot = -1;
+  }
+
+  void del_extent(const ext_ptr &ext) {
+    if (ext->slot >= 0 && ext->slot < num_slots() && slots[ext->slot] == ext)
+      del_extent(ext->slot);
   }
 };
 inline bool operator<(const ExtentObject &a, const ExtentObject &b) {
@@ -1,4 +1,5 @@
 #pragma once
+#include "memory_accounting.h"
 #include "stripe_manager.h"
 #include <algorithm>
 #include <functional>
@@ -47,12 +48,23 @@ public:
   virtual int get_length_of_extent_stack() = 0;
   virtual int get_length_at_key(float key) = 0;
   virtual ext_ptr get_extent_at_key(float key) = 0;
-  virtual bool contains_extent(ext_ptr extent) = 0;
-  virtual void remove_extent(ext_ptr extent) = 0;
+  virtual bool contains_extent(const ext_ptr &extent) = 0;
+  virtual void remove_extent(const ext_ptr &extent) = 0;
   virtual ext_ptr get_extent_at_closest_key(float key) { std::cerr<<"should never be called virtual get_ext_at_closet_key"; return nullptr; };
   virtual void add_extent(stack_val &ext_lst) {
     std::cerr << "extent stack virtual add extent!";
   }
+
+  /*
+   * Number of extents in the stack and the space taken by the stack
+   * itself. The extents are accounted for by the ExtentManager.
+   */
+  virtual mem_usage memory_usage() {
+    mem_usage ret;
+    ret.count = get_length_of_extent_stack();
+    ret.bytes = ret.count * sizeof(ext_ptr);
+    return ret;
+  }
 };
 template<typename ext_stack_T = ext_stack_desc>
 class ExtentStack : public AbstractExtentStack {
@@ -83,6 +95,16 @@ public:
     return length;
   }
 
+  mem_usage memory_usage() override {
+    mem_usage ret;
+    ret.bytes = mem_size::of(this->extent_stack);
+    for (auto &kv : this->extent_stack) {
+      ret.count += kv.second.size();
+      ret.bytes += mem_size::of(kv.second);
+    }
+    return ret;
+  }
+
   virtual int get_length_at_key(float key) override {
     auto it = extent_stack.find(key);
     return it == extent_stack.end() ? 0 : it->second.size();
@@ -109,7 +131,7 @@ public:
     return ret;
   }
 
-  virtual bool contains_extent(ext_ptr extent) override {
+  virtual bool contains_extent(const ext_ptr &extent) override {
     for (auto &kv : extent_stack) {
       if (find(kv.second.begin(), kv.second.end(), extent) != kv.second.end())
         return true;
@@ -118,7 +140,7 @@ public:
   }
 
   // can end early
-  virtual void remove_extent(ext_ptr extent) override {
+  virtual void remove_extent(const ext_ptr &extent) override {
     auto it =  extent_stack.begin();
     while (it != extent_stack.end()) {
       auto found = std::find(it->second.begin(), it->second.end(), extent);
@@ -260,12 +282,13 @@ public:
   int get_length_of_extent_stack() override {
     return extent_stack->get_length_of_extent_stack();
   }
-  bool contains_extent(ext_ptr extent) override {
+  bool contains_extent(const ext_ptr &extent) override {
     return extent_stack->contains_extent(extent);
   }
-  void remove_extent(ext_ptr extent) override {
+  void remove_extent(const ext_ptr &extent) override {
     extent_stack->remove_extent(extent);
   }
+  mem_usage memory_usage() override { return extent_stack->memory_usage(); }
   list<ext_ptr > pop_stripe_num_exts(int stripe_size) override {
     auto it = extent_stack->get_extent_stack()->begin();
     while (it != extent_stack->get_extent_stack()->end() ) {
@@ -334,6 +357,19 @@ public:
     return length;
   }
 
+  mem_usage memory_usage() override {
+    mem_usage ret;
+    ret.bytes = mem_size::of(extent_stack);
+    for (auto &kv : extent_stack) {
+      ret.bytes += mem_size::of(kv.second);
+      for (auto &l : kv.second) {
+        ret.count += l.size();
+        ret.bytes += mem_size::of(l);
+      }
+    }
+    return ret;
+  }
+
   /*def fill_gap(self, num_left_to_add):
         exts = []
         keys = list(self.extent_stack.keys())
@@ -361,14 +397,16 @@ public:
       auto it = extent_stack.upper_bound(temp);
       
       it = it == extent_stack.begin()? extent_stack.begin():prev(it);
-      temp -= it->second.begin()->size();
       stack_val it_second_back;
       if(it->second.size() != 0)
       {
+        // The lists may have lost extents since they were keyed, so count
+        // the extents actually moved
         while(!it->second.back().empty())
         {
           ret.push_back(it->second.back().back());
           it->second.back().pop_back();
+          temp--;
         }
         it->second.pop_back();
       }
@@ -442,7 +480,7 @@ public:
       return ext;
   }
 
-  bool contains_extent(ext_ptr extent) override {
+  bool contains_extent(const ext_ptr &extent) override {
     for (auto &kv : extent_stack) {
       for (auto &l : kv.second) {
         if (find(l.begin(), l.end(), extent) != l.end())
@@ -452,7 +490,7 @@ public:
     return false;
   }
 
-  void remove_extent(ext_ptr extent) override {
+  void remove_extent(const ext_ptr &extent) override {
     auto it = extent_stack.begin();
     while(it != extent_stack.end())
     {
@@ -0,0 +1,306 @@
+#ifndef __FTL_H_
+#define __FTL_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+// How the FTL picks the flash block to collect
+enum class ftl_victim_policy {
+  // The block with the fewest valid pages
+  greedy,
+  // The block with the most free space gained per page copied, weighted by
+  // the age of its data
+  cost_benefit,
+};
+
+inline bool parse_ftl_victim_policy(const string &name,
+                                    ftl_victim_policy &policy) {
+  if (name == "greedy")
+    policy = ftl_victim_policy::greedy;
+  else if (name == "cost_benefit")
+    policy = ftl_victim_policy::cost_benefit;
+  else
+    return false;
+  return true;
+}
+
+struct ftl_params {
+  // Mapping unit of the FTL in size units (those of ext_size)
+  double page_size = 16;
+  int pages_per_block = 256;
+  // Spare flash as a fraction of the logical capacity
+  double over_provisioning = 0.07;
+  // Logical capacity of a node in size units
+  double node_capacity = 0;
+  ftl_victim_policy victim = ftl_victim_policy::greedy;
+};
+
+struct ftl_result {
+  // Data the storage nodes wrote to their FTLs and the FTLs wrote to flash,
+  // in size units
+  double host_writes = 0;
+  double flash_writes = 0;
+  // Flash writes over host writes
+  double device_waf = 0;
+  // Flash writes per unit of user data, compounding the GC of the data
+  // center with that of the FTLs
+  double end_to_end_waf = 0;
+  long long erases = 0;
+  int max_block_erases = 0;
+  double mean_block_erases = 0;
+  // Blocks added beyond the configured flash because the valid data of a
+  // node did not fit in it
+  long long extra_blocks = 0;
+};
+
+/*
+ * Page-mapped flash translation layer of a storage node. Every extent the
+ * node stores gets a range of logical pages, and writing a logical page
+ * programs the next page of the block being written and invalidates the
+ * page that held it before. Flash blocks are only reused after an erase.
+ *
+ * Once fewer than two blocks are free the FTL collects victim blocks,
+ * copying their valid pages to the block being written and erasing them,
+ * until two are free again. The flash holds node_capacity * (1 +
+ * over_provisioning) of pages; blocks are allocated as they are first
+ * written, so a node that is never filled up never collects.
+ */
+class FlashTranslationLayer {
+  static constexpr std::uint32_t unmapped =
+      std::numeric_limits<std::uint32_t>::max();
+
+  struct block {
+    int valid = 0;
+    int erases = 0;
+    bool free = false;
+    // Flash clock when the last page of the block was programmed
+    std::uint64_t written = 0;
+    // Index of the block in its bucket of sealed, -1 while it is free or
+    // being written
+    int slot = -1;
+  };
+
+  ftl_params params;
+  size_t num_blocks;
+  vector<block> blocks;
+  vector<std::uint32_t> free_blocks;
+  // Fully written blocks by their number of valid pages, so that the greedy
+  // policy finds its victim without going through every block
+  vector<vector<std::uint32_t>> sealed;
+  // Logical page of every flash page, unmapped once the page is invalid,
+  // and flash page of every logical page
+  vector<std::uint32_t> p2l, l2p;
+  // Freed ranges of logical pages by their length
+  unordered_map<int, vector<std::uint32_t>> free_extents;
+  std::uint32_t next_lpn = 0;
+  // Block being written and its next page
+  std::uint32_t active = unmapped;
+  int next_page = 0;
+  // Flash pages programmed so far, the clock of the cost-benefit ages
+  std::uint64_t clock = 0;
+  long long host_pages = 0, erases = 0, extra_blocks = 0;
+
+  size_t num_free() {
+    return free_blocks.size() + (num_blocks - blocks.size());
+  }
+
+  std::uint32_t take_block() {
+    std::uint32_t b;
+    if (!free_blocks.empty()) {
+      b = free_blocks.back();
+      free_blocks.pop_back();
+    } else {
+      if (blocks.size() == num_blocks) {
+        num_blocks++;
+        extra_blocks++;
+      }
+      b = blocks.size();
+      blocks.emplace_back();
+      p2l.resize(p2l.size() + params.pages_per_block, unmapped);
+    }
+    blocks[b].free = false;
+    return b;
+  }
+
+  void seal(std::uint32_t b) {
+    auto &bucket = sealed[blocks[b].valid];
+    blocks[b].slot = bucket.size();
+    bucket.push_back(b);
+  }
+
+  void unseal(std::uint32_t b) {
+    auto &bucket = sealed[blocks[b].valid];
+    std::uint32_t last = bucket.back();
+    bucket[blocks[b].slot] = last;
+    blocks[last].slot = blocks[b].slot;
+    bucket.pop_back();
+    blocks[b].slot = -1;
+  }
+
+  void program(std::uint32_t lpn) {
+    if (active == unmapped || next_page == params.pages_per_block) {
+      if (active != unmapped)
+        seal(active);
+      active = take_block();
+      next_page = 0;
+    }
+    std::uint32_t ppn = active * params.pages_per_block + next_page++;
+    p2l[ppn] = lpn;
+    l2p[lpn] = ppn;
+    blocks[active].valid++;
+    blocks[active].written = ++clock;
+  }
+
+  void invalidate(std::uint32_t lpn) {
+    std::uint32_t ppn = l2p[lpn];
+    if (ppn == unmapped)
+      return;
+    p2l[ppn] = unmapped;
+    std::uint32_t b = ppn / params.pages_per_block;
+    bool is_sealed = blocks[b].slot >= 0;
+    if (is_sealed)
+      unseal(b);
+    blocks[b].valid--;
+    if (is_sealed)
+      seal(b);
+    l2p[lpn] = unmapped;
+  }
+
+  /*
+   * A greedy victim comes from the first non-empty bucket, in
+   * O(pages_per_block). Cost-benefit scores depend on the age of every
+   * block, so that policy scans all the blocks, in O(blocks) per collection.
+   */
+  std::uint32_t choose_victim() {
+    if (params.victim == ftl_victim_policy::greedy) {
+      for (int v = 0; v < params.pages_per_block; v++)
+        if (!sealed[v].empty())
+          return sealed[v].back();
+      return unmapped;
+    }
+    std::uint32_t victim = unmapped;
+    double best = -1;
+    for (std::uint32_t b = 0; b < blocks.size(); b++) {
+      if (b == active || blocks[b].free ||
+          blocks[b].valid == params.pages_per_block)
+        continue;
+      double u = (double)blocks[b].valid / params.pages_per_block;
+      double score;
+      if (u == 0)
+        score = std::numeric_limits<double>::infinity();
+      else
+        score = (1 - u) / (2 * u) * (clock - blocks[b].written);
+      if (score > best) {
+        best = score;
+        victim = b;
+      }
+    }
+    return victim;
+  }
+
+  // Collects a victim block and returns false if no block has invalid pages
+  bool collect() {
+    std::uint32_t victim = choose_victim();
+    if (victim == unmapped)
+      return false;
+    unseal(victim);
+    std::uint32_t first = victim * params.pages_per_block;
+    for (int i = 0; i < params.pages_per_block; i++) {
+      std::uint32_t lpn = p2l[first + i];
+      if (lpn == unmapped)
+        continue;
+      invalidate(lpn);
+      program(lpn);
+    }
+    blocks[victim].erases++;
+    blocks[victim].free = true;
+    erases++;
+    free_blocks.push_back(victim);
+    return true;
+  }
+
+  void write(std::uint32_t lpn) {
+    invalidate(lpn);
+    if (active == unmapped || next_page == params.pages_per_block)
+      while (num_free() < 2 && collect())
+        ;
+    program(lpn);
+    host_pages++;
+  }
+
+public:
+  FlashTranslationLayer(ftl_params params) : params(params) {
+    this->params.pages_per_block = std::max(params.pages_per_block, 1);
+    sealed.resize(this->params.pages_per_block + 1);
+    num_blocks = std::max(
+        (size_t)std::ceil(params.node_capacity *
+                          (1 + params.over_provisioning) / params.page_size /
+                          this->params.pages_per_block),
+        (size_t)2);
+  }
+
+  double page_size() { return params.page_size; }
+
+  // Flash blocks, including those added beyond the configured flash
+  size_t flash_blocks() { return num_blocks; }
+
+  int pages_of(double size) {
+    return std::max((int)std::ceil(size / params.page_size), 1);
+  }
+
+  // Writes a new extent of the given number of pages and returns its first
+  // logical page
+  std::uint32_t write_extent(int pages) {
+    std::uint32_t start;
+    auto &freed = free_extents[pages];
+    if (!freed.empty()) {
+      start = freed.back();
+      freed.pop_back();
+    } else {
+      start = next_lpn;
+      next_lpn += pages;
+      l2p.resize(next_lpn, unmapped);
+    }
+    for (int i = 0; i < pages; i++)
+      write(start + i);
+    return start;
+  }
+
+  // Overwrites n pages of an extent from its start, wrapping around
+  void rewrite_extent(std::uint32_t start, int pages, long long n) {
+    for (long long i = 0; i < n; i++)
+      write(start + i % pages);
+  }
+
+  // Frees the pages of an extent for the FTL to reclaim
+  void trim_extent(std::uint32_t start, int pages) {
+    for (int i = 0; i < pages; i++)
+      invalidate(start + i);
+    free_extents[pages].push_back(start);
+  }
+
+  // Device-level totals, without end_to_end_waf
+  ftl_result result() {
+    ftl_result ret;
+    ret.host_writes = host_pages * params.page_size;
+    ret.flash_writes = clock * params.page_size;
+    ret.device_waf = host_pages > 0 ? (double)clock / host_pages : 0;
+    ret.erases = erases;
+    for (auto &b : blocks)
+      ret.max_block_erases = std::max(ret.max_block_erases, b.erases);
+    ret.mean_block_erases = (double)erases / num_blocks;
+    ret.extra_blocks = extra_blocks;
+    return ret;
+  }
+};
+
+#endif // __FTL_H_
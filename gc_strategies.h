@@ -3,42 +3,106 @@
 #include "config.h"
 #include "extent_manager.h"
 #include "extent_object_stripe.h"
+#include "profiler.h"
 #include "stripers.h"
 #include "striping_process_coordinator.h"
+#include "thread_pool.h"
 #include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <memory>
+#include <queue>
 #include <set>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
-typedef unordered_map<string, float> ext_type_cost_map;
-typedef unordered_map<string, int> obj_ext_type_map;
+typedef unordered_map<string, capacity_t> ext_type_cost_map;
+typedef unordered_map<string, capacity_t> obj_ext_type_map;
 typedef unordered_map<string, int> gc_ext_type_num_map;
-typedef unordered_map<string, int> space_ext_type_map;
+typedef unordered_map<string, capacity_t> space_ext_type_map;
 using std::set;
 
 struct gc_handler_ret {
-  long double reclaimed_space = 0, total_user_reads = 0, total_user_writes = 0,
-        total_global_parity_reads = 0, total_global_parity_writes = 0,
-        total_local_parity_reads = 0, total_local_parity_writes = 0,
-        total_obsolete_data_reads = 0, total_absent_data_reads = 0,
-        total_valid_obj_transfers = 0,
-        total_storage_node_to_parity_calculator = 0,
-        total_num_exts_replaced = 0;
+  capacity_t reclaimed_space = 0, total_obsolete_data_reads = 0,
+             total_absent_data_reads = 0, total_valid_obj_transfers = 0,
+             total_storage_node_to_parity_calculator = 0;
+  capacity_t total_user_reads = 0, total_user_writes = 0,
+             total_global_parity_reads = 0, total_global_parity_writes = 0,
+             total_local_parity_reads = 0, total_local_parity_writes = 0;
+  long total_num_exts_replaced = 0;
   space_ext_type_map total_reclaimed_space_by_ext_type = space_ext_type_map();
-  ;
+  // Only set by budgeted strategies: the GC traffic allowed this cycle, and
+  // the obsolete space and number of eligible stripes left for later cycles
+  long double gc_budget = 0;
+  capacity_t backlog_space = 0;
+  long backlog_stripes = 0;
+
+  // Total GC traffic of the cycle
+  capacity_t bandwidth() const {
+    return total_global_parity_reads + total_global_parity_writes +
+           total_local_parity_reads + total_local_parity_writes +
+           total_obsolete_data_reads + total_absent_data_reads +
+           total_storage_node_to_parity_calculator + total_user_reads +
+           total_user_writes;
+  }
 };
 struct stripe_gc_ret {
-  long double temp_space = 0, user_reads = 0, user_writes = 0,
-        global_parity_reads = 0, global_parity_writes = 0,
-        local_parity_reads = 0, local_parity_writes = 0,
-        obsolete_data_reads = 0, absent_data_reads = 0, valid_obj_transfers = 0,
-        storage_node_to_parity_calculator = 0, num_exts_replaced = 0;
+  capacity_t temp_space = 0, obsolete_data_reads = 0, absent_data_reads = 0,
+             valid_obj_transfers = 0, storage_node_to_parity_calculator = 0;
+  capacity_t user_reads = 0, user_writes = 0, global_parity_reads = 0,
+             global_parity_writes = 0, local_parity_reads = 0,
+             local_parity_writes = 0;
+  long num_exts_replaced = 0;
   space_ext_type_map reclaimed_space_by_ext_types = space_ext_type_map();
+  // The writes went to new stripes rather than to the collected one, and
+  // the storage nodes already charged them when placing the new stripes
+  bool writes_placed = false;
+
+  // Total GC traffic of collecting the stripe
+  capacity_t bandwidth() const {
+    return global_parity_reads + global_parity_writes + local_parity_reads +
+           local_parity_writes + obsolete_data_reads + absent_data_reads +
+           storage_node_to_parity_calculator + user_reads + user_writes;
+  }
 };
 inline bool stripe_cmpr(stripe_ptr s1, stripe_ptr s2) { return s1->id < s2->id; }
+
+/*
+ * The part of a stripe GC that only reads the stripe: the slots of the
+ * extents it replaces, in the order it replaces them, the valid objects of
+ * each of those extents, and what replacing them adds to the GC statistics
+ * and costs. Collecting the stripe only applies it.
+ */
+struct stripe_gc_plan {
+  stripe_ptr stripe;
+  vector<int> slots;
+  vector<object_lst> survivors;
+  // Obsolete and valid data of the replaced extents and their localities
+  repl_data replaced;
+  // Size of the replaced extents
+  capacity_t ext_size = 0;
+  // Reclaimed space, valid data and number of the replaced extents of every
+  // extent type, which are few per stripe
+  struct type_stats {
+    string type;
+    capacity_t reclaimed = 0, valid = 0;
+    int num_exts = 0;
+  };
+  vector<type_stats> by_type;
+  // Parity and data reads and writes of replacing the extents, only set by
+  // strategies that replace some of the extents of a stripe
+  repl_costs costs = {0, 0, 0, 0, 0, 0, 0};
+
+  type_stats &stats_of(const string &type) {
+    for (auto &t : by_type)
+      if (t.type == type)
+        return t;
+    by_type.push_back({type});
+    return by_type.back();
+  }
+};
+
 class GarbageCollectionStrategy {
 protected:
   short primary_threshold, secondary_threshold;
@@ -46,6 +110,12 @@ protected:
   shared_ptr<AbstractStriper> gc_striper;
   shared_ptr<StripingProcessCoordinator> striping_process_coordinator;
   short num_gc_cycles, num_exts_gced, num_localities_in_gc;
+  // Plans the stripe GCs of a cycle concurrently when set
+  shared_ptr<ThreadPool> thread_pool;
+  // Tallies the GC traffic of every storage node when set
+  shared_ptr<StorageNodes> storage_nodes;
+  // Fewer eligible stripes than this are planned on the calling thread
+  static constexpr size_t min_parallel_stripes = 32;
   ext_type_cost_map ext_types_to_cost;
   obj_ext_type_map valid_objs_by_ext_type;
   gc_ext_type_num_map gc_ed_exts_by_type;
@@ -85,12 +155,191 @@ public:
   virtual stripe_gc_ret stripe_gc(stripe_ptr stripe) = 0;
   // Mechanism for determining which stripes are ready for gc
   virtual gc_handler_ret gc_handler(set<stripe_ptr> &stripe_set) = 0;
+  // Work left at the end of a gc cycle once the stripes are collected
+  virtual void finish_gc_cycle(gc_handler_ret &ret) {}
+  // Whether gc_handler has work to do in a cycle without deletions
+  virtual bool has_pending_work() { return false; }
+  // Result of a cycle whose gc_handler is skipped for lack of work
+  virtual gc_handler_ret idle_result() { return gc_handler_ret(); }
+
+  void set_thread_pool(shared_ptr<ThreadPool> pool) { thread_pool = pool; }
+
+  void set_storage_nodes(shared_ptr<StorageNodes> nodes) {
+    storage_nodes = nodes;
+  }
+
+  void set_thresholds(short p_thresh, short s_thresh) {
+    this->primary_threshold = p_thresh;
+    this->secondary_threshold = s_thresh;
+  }
+
+  // Whether stripe_gc replaces the given extent of the stripe it collects
+  virtual bool replaces_extent(const ext_ptr &ext) { return true; }
+
+  /*
+   * Works out which extents the GC of the stripe replaces and which objects
+   * it writes again, without changing anything. Strategies that do not
+   * split their stripe GC leave the plan empty.
+   */
+  virtual stripe_gc_plan plan_stripe_gc(const stripe_ptr &stripe) {
+    stripe_gc_plan plan;
+    plan.stripe = stripe;
+    return plan;
+  }
+
+  // Collects a stripe following the plan made for it
+  virtual stripe_gc_ret collect_stripe(stripe_gc_plan &plan) {
+    return stripe_gc(plan.stripe);
+  }
+
+  /*
+   * Replacement pattern that stripe_gc would produce for the stripe,
+   * without changing it. Strategies that replace every extent of the stripe
+   * read it from the stripe's per-locality totals.
+   */
+  virtual repl_data replacement_data(const stripe_ptr &stripe) {
+    repl_data data;
+    for (int i = 0; i < stripe->num_localities; i++) {
+      data.add_locality(stripe->localities[i], stripe->num_data_blocks);
+      data.obsolete += stripe->locality_obsolete[i];
+      data.valid += stripe->locality_valid[i];
+    }
+    return data;
+  }
+
+  /*
+   * GC traffic of collecting a stripe with the given replacement pattern,
+   * estimated as the striper's replacement costs plus reading and writing
+   * back the valid data of the replaced extents.
+   */
+  capacity_t estimate_gc_traffic(const stripe_ptr &stripe,
+                                 const repl_data &data) {
+    repl_costs costs =
+        gc_striper->estimate_replacement_costs(stripe->ext_size, data);
+    return costs.global_parity_reads + costs.global_parity_writes +
+           costs.local_parity_reads + costs.local_parity_writes +
+           costs.obsolete_data_reads + costs.absent_data_reads +
+           costs.valid_obj_reads + 2 * data.valid;
+  }
+
+  void add_stripe_gc_result(gc_handler_ret &ret, stripe_gc_ret &res,
+                            const stripe_ptr &stripe) {
+    if (storage_nodes)
+      storage_nodes->add_gc_traffic(
+          *stripe,
+          res.obsolete_data_reads + res.absent_data_reads +
+              res.storage_node_to_parity_calculator + res.user_reads,
+          res.writes_placed ? 0 : res.user_writes,
+          res.global_parity_reads + res.local_parity_reads,
+          res.writes_placed
+              ? 0
+              : res.global_parity_writes + res.local_parity_writes);
+    for (auto &kv : res.reclaimed_space_by_ext_types)
+      ret.total_reclaimed_space_by_ext_type[kv.first] += kv.second;
+    ret.reclaimed_space += res.temp_space;
+    ret.total_user_reads += res.user_reads;
+    ret.total_user_writes += res.user_writes;
+    ret.total_valid_obj_transfers += res.valid_obj_transfers;
+    ret.total_storage_node_to_parity_calculator +=
+        res.storage_node_to_parity_calculator;
+    ret.total_global_parity_reads += res.global_parity_reads;
+    ret.total_global_parity_writes += res.global_parity_writes;
+    ret.total_local_parity_reads += res.local_parity_reads;
+    ret.total_local_parity_writes += res.local_parity_writes;
+    ret.total_obsolete_data_reads += res.obsolete_data_reads;
+    ret.total_absent_data_reads += res.absent_data_reads;
+    ret.total_num_exts_replaced += res.num_exts_replaced;
+  }
 
   vector<stripe_ptr> sorted_stripe_set(set<stripe_ptr> &stripes) {
     std::vector<stripe_ptr> v(stripes.begin(), stripes.end());
     std::sort(v.begin(), v.end(), stripe_cmpr);
     return v;
   }
+
+  stripe_gc_plan plan_extents(const stripe_ptr &stripe) {
+    stripe_gc_plan plan;
+    plan.stripe = stripe;
+    for (int locality = 0; locality < stripe->num_localities; locality++) {
+      int exts_replaced = 0;
+      int end = (locality + 1) * stripe->num_data_blocks;
+      for (int slot = locality * stripe->num_data_blocks; slot < end; slot++) {
+        const ext_ptr &ext = stripe->slots[slot];
+        if (ext == nullptr || !replaces_extent(ext))
+          continue;
+        assert(ext->get_obsolete_percentage() <= 100);
+        capacity_t valid_objs = ext->ext_size - ext->obsolete_space;
+        plan.slots.push_back(slot);
+        plan.survivors.push_back(ext->get_obj_records());
+        plan.ext_size = ext->ext_size;
+        stripe_gc_plan::type_stats &t = plan.stats_of(ext->type);
+        t.reclaimed += ext->obsolete_space;
+        t.valid += valid_objs;
+        t.num_exts += 1;
+        plan.replaced.obsolete += ext->obsolete_space;
+        plan.replaced.valid += valid_objs;
+        exts_replaced += 1;
+      }
+      plan.replaced.add_locality(exts_replaced, stripe->num_data_blocks);
+    }
+    return plan;
+  }
+
+  /*
+   * Adds the statistics of the planned extents to the strategy and to the
+   * result of collecting the stripe. The extents themselves are replaced by
+   * the caller.
+   */
+  void apply_plan(const stripe_gc_plan &plan, stripe_gc_ret &ret) {
+    for (auto &t : plan.by_type) {
+      ext_types_to_cost[t.type] += t.valid * 2;
+      valid_objs_by_ext_type[t.type] += t.valid;
+      gc_ed_exts_by_type[t.type] += t.num_exts;
+      ret.reclaimed_space_by_ext_types[t.type] += t.reclaimed;
+    }
+    ret.temp_space += plan.replaced.obsolete;
+    ret.valid_obj_transfers += plan.replaced.valid;
+    ret.num_exts_replaced += plan.slots.size();
+    add_num_gc_cycles(1);
+    add_num_exts_gced(ret.num_exts_replaced);
+  }
+
+  /*
+   * Collects the eligible stripes of the set in two phases. The stripe GCs
+   * are planned first, concurrently on the thread pool if there is one,
+   * since planning only reads the stripes and collecting a stripe never
+   * changes the extents of another one. The stripes are then collected one
+   * by one in id order, which repacks and restripes their valid objects
+   * exactly as collecting them serially would.
+   */
+  void collect_stripes(set<stripe_ptr> &stripe_set, gc_handler_ret &ret) {
+    vector<stripe_ptr> eligible;
+    for (auto &stripe : sorted_stripe_set(stripe_set)) {
+      // what should obsolete's type be? pr what type should get
+      // percentage return?
+      double obsolete = stripe->get_obsolete_percentage();
+      if (obsolete >= primary_threshold && stripe != nullptr)
+        eligible.push_back(stripe);
+    }
+    vector<stripe_gc_plan> plans(eligible.size());
+    auto plan = [&](size_t i) { plans[i] = plan_stripe_gc(eligible[i]); };
+    if (thread_pool && eligible.size() >= min_parallel_stripes)
+      thread_pool->parallel_for(eligible.size(), plan);
+    else
+      for (size_t i = 0; i < eligible.size(); i++)
+        plan(i);
+
+    set<stripe_ptr> deleted;
+    for (auto &p : plans) {
+      // fprintf(stderr, "%f %d", configtime, p.stripe->id);
+      stripe_gc_ret stripe_gc_res = collect_stripe(p);
+      add_stripe_gc_result(ret, stripe_gc_res, p.stripe);
+      if (stripe_gc_res.temp_space > 0)
+        deleted.insert(p.stripe);
+    }
+    for (auto &d : deleted)
+      stripe_set.erase(d);
+  }
 };
 
 class StripeLevelNoExtsGCStrategy : public GarbageCollectionStrategy {
@@ -107,53 +356,33 @@ public:
         stripe_manager(s_m) {}
 
   stripe_gc_ret stripe_gc(stripe_ptr stripe) override {
+    stripe_gc_plan plan = plan_stripe_gc(stripe);
+    return collect_stripe(plan);
+  }
+
+  stripe_gc_plan plan_stripe_gc(const stripe_ptr &stripe) override {
+    return plan_extents(stripe);
+  }
+
+  stripe_gc_ret collect_stripe(stripe_gc_plan &plan) override {
+    PROFILE_PHASE(Phase::StripeGC);
+    const stripe_ptr &stripe = plan.stripe;
     stripe_gc_ret ret;
-    vector<int> exts_per_locality;
-    vector<int> obs_data_per_locality;
-    vector<int> valid_objs_per_locality;
-    for (int i = 0; i < stripe->num_localities; ++i) {
-      exts_per_locality.push_back(0);
-      obs_data_per_locality.push_back(0);
-      valid_objs_per_locality.push_back(0);
-    }
-    add_num_gc_cycles(1);
     set<obj_ptr> objs;
-    set<int> local_parities;
-    std::list<ext_ptr > extent_list = stripe->extents;
-    space_ext_type_map reclaimed_space_by_ext_types;
-    for (ext_ptr ext : extent_list) {
-      assert(ext->get_obsolete_percentage() <= 100);
-      ret.temp_space += ext->obsolete_space;
-      double valid_objs = ext->ext_size - ext->obsolete_space;
-      if (ext_types_to_cost.find(ext->type) != ext_types_to_cost.end()) {
-        ext_types_to_cost[ext->type] += valid_objs * 2;
-        valid_objs_by_ext_type[ext->type] += valid_objs;
-        gc_ed_exts_by_type[ext->type] += 1;
-      } else {
-        ext_types_to_cost[ext->type] = valid_objs * 2;
-        valid_objs_by_ext_type[ext->type] = valid_objs;
-        gc_ed_exts_by_type[ext->type] = 1;
-      }
-      if (reclaimed_space_by_ext_types.find(ext->type) !=
-          reclaimed_space_by_ext_types.end()) {
-        reclaimed_space_by_ext_types[ext->type] += ext->obsolete_space;
-      } else {
-        reclaimed_space_by_ext_types[ext->type] = ext->obsolete_space;
-      }
-      ret.valid_obj_transfers += valid_objs;
-      valid_objs_per_locality[ext->locality] += valid_objs;
-      striping_process_coordinator->gc_extent(ext, objs);
-      exts_per_locality[ext->locality] += 1;
-      obs_data_per_locality[ext->locality] += ext->obsolete_space;
-      if (local_parities.find(ext->locality) == local_parities.end()) {
-        local_parities.insert(ext->locality);
-      }
-      ret.num_exts_replaced += 1;
-      stripe->del_extent(ext);
+    apply_plan(plan, ret);
+    // Every extent is replaced, so every locality with an extent needs its
+    // local parity recomputed
+    int local_parities = 0;
+    for (int n : stripe->localities)
+      local_parities += n > 0;
+    for (size_t i = 0; i < plan.slots.size(); i++) {
+      int slot = plan.slots[i];
+      ext_ptr ext = stripe->slots[slot];
+      striping_process_coordinator->gc_objects(plan.survivors[i], objs);
+      stripe->del_extent(slot);
       extent_manager->delete_extent(ext);
     }
-    add_num_exts_gced(ret.num_exts_replaced);
-    add_localities_in_gc(local_parities.size());
+    add_localities_in_gc(local_parities);
     if (ret.temp_space <= 0) {
       return ret;
     }
@@ -161,8 +390,8 @@ public:
     str_costs generate_res =
         striping_process_coordinator->generate_gc_stripes();
     int num_stripes = generate_res.stripes;
-    int reads = generate_res.reads;
-    int writes = generate_res.writes;
+    capacity_t reads = generate_res.reads;
+    capacity_t writes = generate_res.writes;
     if (num_stripes < 1) {
       str_costs stripe_res = striping_process_coordinator->get_stripe();
       num_stripes = stripe_res.stripes;
@@ -173,57 +402,17 @@ public:
       ret.user_writes = writes;
     }
 
-    double parity_writes = ret.user_writes - ret.user_reads;
+    capacity_t parity_writes = ret.user_writes - ret.user_reads;
     ret.global_parity_writes = parity_writes / 2;
-    ret.local_parity_writes = parity_writes / 2;
+    ret.local_parity_writes = parity_writes - ret.global_parity_writes;
     ret.user_writes = ret.user_reads;
-    ret.reclaimed_space_by_ext_types = reclaimed_space_by_ext_types;
+    ret.writes_placed = true;
     return ret;
   }
 
   gc_handler_ret gc_handler(set<stripe_ptr> &stripe_set) override {
     struct gc_handler_ret ret;
-    set<stripe_ptr> deleted;
-    vector<stripe_ptr> stripe_lst = sorted_stripe_set(stripe_set);
-    for (auto stripe : stripe_lst) {
-      // what should obsolete's type be? pr what type should get
-      // percentage return?
-      double obsolete = stripe->get_obsolete_percentage();
-      if (obsolete >= primary_threshold && stripe != nullptr) {
-        // fprintf(stderr, "%f %d", configtime, stripe->id);
-        stripe_gc_ret stripe_gc_res = stripe_gc(stripe);
-        for (auto &kv : stripe_gc_res.reclaimed_space_by_ext_types) {
-          string key = kv.first;
-          if (ret.total_reclaimed_space_by_ext_type.find(key) !=
-              ret.total_reclaimed_space_by_ext_type.end()) {
-            ret.total_reclaimed_space_by_ext_type[key] +=
-                stripe_gc_res.reclaimed_space_by_ext_types[key];
-          } else {
-            ret.total_reclaimed_space_by_ext_type[key] =
-                stripe_gc_res.reclaimed_space_by_ext_types[key];
-          }
-        }
-        if (stripe_gc_res.temp_space > 0) {
-          deleted.insert(stripe);
-        }
-        ret.reclaimed_space += stripe_gc_res.temp_space;
-        ret.total_user_reads += stripe_gc_res.user_reads;
-        ret.total_user_writes += stripe_gc_res.user_writes;
-        ret.total_valid_obj_transfers += stripe_gc_res.valid_obj_transfers;
-        ret.total_storage_node_to_parity_calculator +=
-            stripe_gc_res.storage_node_to_parity_calculator;
-        ret.total_global_parity_reads += stripe_gc_res.global_parity_reads;
-        ret.total_global_parity_writes += stripe_gc_res.global_parity_writes;
-        ret.total_local_parity_reads += stripe_gc_res.local_parity_reads;
-        ret.total_local_parity_writes += stripe_gc_res.local_parity_writes;
-        ret.total_obsolete_data_reads += stripe_gc_res.obsolete_data_reads;
-        ret.total_absent_data_reads += stripe_gc_res.absent_data_reads;
-        ret.total_num_exts_replaced += stripe_gc_res.num_exts_replaced;
-      }
-    }
-    for (auto d : deleted) {
-      stripe_set.erase(d);
-    }
+    collect_stripes(stripe_set, ret);
     return ret;
   }
 };
@@ -236,10 +425,30 @@ public:
     return ext->get_obsolete_percentage() >= secondary_threshold;
   }
 
+  bool replaces_extent(const ext_ptr &ext) override { return filter_ext(ext); }
+
+  repl_data replacement_data(const stripe_ptr &stripe) override {
+    repl_data data;
+    for (int locality = 0; locality < stripe->num_localities; locality++) {
+      int exts_replaced = 0;
+      int end = (locality + 1) * stripe->num_data_blocks;
+      for (int slot = locality * stripe->num_data_blocks; slot < end; slot++) {
+        const ext_ptr &ext = stripe->slots[slot];
+        if (ext == nullptr || !filter_ext(ext))
+          continue;
+        exts_replaced += 1;
+        data.obsolete += ext->obsolete_space;
+        data.valid += ext->ext_size - ext->obsolete_space;
+      }
+      data.add_locality(exts_replaced, stripe->num_data_blocks);
+    }
+    return data;
+  }
+
   struct gc_ext_res {
-    float user_reads;
-    float user_writes;
-    gc_ext_res(float r, float w) : user_reads(r), user_writes(w) {}
+    capacity_t user_reads;
+    capacity_t user_writes;
+    gc_ext_res(capacity_t r, capacity_t w) : user_reads(r), user_writes(w) {}
   };
   gc_ext_res gc_ext(ext_ptr ext, stripe_ptr stripe) {
     float key = extent_manager->get_key(ext);
@@ -251,73 +460,47 @@ public:
     }
 
     stripe->add_extent(temp_ext);
-    float user_writes = ext->ext_size;
-    float user_reads = ext->ext_size;
+    capacity_t user_writes = ext->ext_size;
+    capacity_t user_reads = ext->ext_size;
 
     return gc_ext_res(user_writes, user_reads);
   }
 
   stripe_gc_ret stripe_gc(stripe_ptr stripe) override {
+    stripe_gc_plan plan = plan_stripe_gc(stripe);
+    return collect_stripe(plan);
+  }
+
+  stripe_gc_plan plan_stripe_gc(const stripe_ptr &stripe) override {
+    stripe_gc_plan plan = plan_extents(stripe);
+    if (plan.replaced.obsolete > 0)
+      plan.costs =
+          gc_striper->estimate_replacement_costs(plan.ext_size, plan.replaced);
+    return plan;
+  }
+
+  stripe_gc_ret collect_stripe(stripe_gc_plan &plan) override {
+    PROFILE_PHASE(Phase::StripeGC);
+    const stripe_ptr &stripe = plan.stripe;
     stripe_gc_ret ret;
-    vector<int> exts_per_locality;
-    vector<int> obs_data_per_locality;
-    vector<int> valid_objs_per_locality;
-    for (int i = 0; i < stripe->num_localities; ++i) {
-      exts_per_locality.push_back(0);
-      obs_data_per_locality.push_back(0);
-      valid_objs_per_locality.push_back(0);
-    }
-    add_num_gc_cycles(1);
     set<obj_ptr> objs;
-    set<int> local_parities;
-    list<ext_ptr > extent_list = stripe->extents;
-    int ext_size = 0;
-    space_ext_type_map reclaimed_space_by_ext_types;
-    for (ext_ptr ext : extent_list) {
-      if (filter_ext(ext)) {
-        assert(ext->get_obsolete_percentage() <= 100);
-        ret.temp_space += ext->obsolete_space;
-        ext_size = ext->ext_size;
-        double valid_objs = ext->ext_size - ext->obsolete_space;
-        if (ext_types_to_cost.find(ext->type) != ext_types_to_cost.end()) {
-          ext_types_to_cost[ext->type] += valid_objs * 2;
-          valid_objs_by_ext_type[ext->type] += valid_objs;
-          gc_ed_exts_by_type[ext->type] += 1;
-        } else {
-          ext_types_to_cost[ext->type] = valid_objs * 2;
-          valid_objs_by_ext_type[ext->type] = valid_objs;
-          gc_ed_exts_by_type[ext->type] = 1;
-        }
-        if (reclaimed_space_by_ext_types.find(ext->type) !=
-            reclaimed_space_by_ext_types.end()) {
-          reclaimed_space_by_ext_types[ext->type] += ext->obsolete_space;
-        } else {
-          reclaimed_space_by_ext_types[ext->type] = ext->obsolete_space;
-        }
-        ret.valid_obj_transfers += valid_objs;
-        valid_objs_per_locality[ext->locality] += valid_objs;
-        striping_process_coordinator->gc_extent(ext, objs);
-        exts_per_locality[ext->locality] += 1;
-        obs_data_per_locality[ext->locality] += ext->obsolete_space;
-        if (local_parities.find(ext->locality) == local_parities.end()) {
-          local_parities.insert(ext->locality);
-        }
-        ret.num_exts_replaced += 1;
-        stripe->del_extent(ext);
-        extent_manager->delete_extent(ext);
-        gc_ext_res gc_ext_data = gc_ext(ext, stripe);
-        ret.user_writes += gc_ext_data.user_writes;
-        ret.user_reads += gc_ext_data.user_reads;
-      }
+    apply_plan(plan, ret);
+    for (size_t i = 0; i < plan.slots.size(); i++) {
+      int slot = plan.slots[i];
+      ext_ptr ext = stripe->slots[slot];
+      striping_process_coordinator->gc_objects(plan.survivors[i], objs);
+      // The replacement extent from gc_ext takes over the freed slot
+      stripe->del_extent(slot);
+      extent_manager->delete_extent(ext);
+      gc_ext_res gc_ext_data = gc_ext(ext, stripe);
+      ret.user_writes += gc_ext_data.user_writes;
+      ret.user_reads += gc_ext_data.user_reads;
     }
-    add_num_exts_gced(ret.num_exts_replaced);
-    add_localities_in_gc(local_parities.size());
-    ret.reclaimed_space_by_ext_types = reclaimed_space_by_ext_types;
+    add_localities_in_gc(plan.replaced.localities_replaced());
 
     if (ret.temp_space > 0) {
-      repl_costs costs = gc_striper->cost_to_replace_extents(
-          ext_size, exts_per_locality, obs_data_per_locality,
-          valid_objs_per_locality);
+      const repl_costs &costs = plan.costs;
+      gc_striper->count_replacement(plan.ext_size, plan.replaced);
       ret.global_parity_reads = costs.global_parity_reads;
       ret.global_parity_writes = costs.global_parity_writes;
       ret.local_parity_reads = costs.local_parity_reads;
@@ -331,48 +514,9 @@ public:
 
   gc_handler_ret gc_handler(set<stripe_ptr> &stripe_set) override {
     struct gc_handler_ret ret;
-    set<stripe_ptr> deleted;
-    vector<stripe_ptr> stripe_lst = sorted_stripe_set(stripe_set);
-    for (auto stripe : stripe_lst) {
-      // what should obsolete's type be? pr what type should get
-      // percentage return?
-      double obsolete = stripe->get_obsolete_percentage();
-      if (obsolete >= primary_threshold && stripe != nullptr) {
-        // fprintf(stderr,"%f %d", configtime, stripe->id);
-        stripe_gc_ret stripe_gc_res = stripe_gc(stripe);
-        for (auto &kv : stripe_gc_res.reclaimed_space_by_ext_types) {
-          string key = kv.first;
-          if (ret.total_reclaimed_space_by_ext_type.find(key) !=
-              ret.total_reclaimed_space_by_ext_type.end()) {
-            ret.total_reclaimed_space_by_ext_type[key] +=
-                stripe_gc_res.reclaimed_space_by_ext_types[key];
-          } else {
-            ret.total_reclaimed_space_by_ext_type[key] =
-                stripe_gc_res.reclaimed_space_by_ext_types[key];
-          }
-        }
-        if (stripe_gc_res.temp_space > 0) {
-          deleted.insert(stripe);
-        }
-        ret.reclaimed_space += stripe_gc_res.temp_space;
-        ret.total_user_reads += stripe_gc_res.user_reads;
-        ret.total_user_writes += stripe_gc_res.user_writes;
-        ret.total_valid_obj_transfers += stripe_gc_res.valid_obj_transfers;
-        ret.total_storage_node_to_parity_calculator +=
-            stripe_gc_res.storage_node_to_parity_calculator;
-        ret.total_global_parity_reads += stripe_gc_res.global_parity_reads;
-        ret.total_global_parity_writes += stripe_gc_res.global_parity_writes;
-        ret.total_local_parity_reads += stripe_gc_res.local_parity_reads;
-        ret.total_local_parity_writes += stripe_gc_res.local_parity_writes;
-        ret.total_obsolete_data_reads += stripe_gc_res.obsolete_data_reads;
-        ret.total_absent_data_reads += stripe_gc_res.absent_data_reads;
-        ret.total_num_exts_replaced += stripe_gc_res.num_exts_replaced;
-      }
-    }
-    for (stripe_ptr d : deleted)
-      stripe_set.erase(d);
+    collect_stripes(stripe_set, ret);
     return ret;
-  };
+  }
 
  
 };
@@ -391,54 +535,31 @@ public:
           stripe_manager(s_m) {}
 
     stripe_gc_ret stripe_gc(stripe_ptr stripe) override {
+      stripe_gc_plan plan = plan_stripe_gc(stripe);
+      return collect_stripe(plan);
+    }
+
+    stripe_gc_plan plan_stripe_gc(const stripe_ptr &stripe) override {
+      return plan_extents(stripe);
+    }
+
+    stripe_gc_ret collect_stripe(stripe_gc_plan &plan) override {
+      PROFILE_PHASE(Phase::StripeGC);
+      const stripe_ptr &stripe = plan.stripe;
       stripe_gc_ret ret;
-      vector<int> exts_per_locality;
-      vector<int> obs_data_per_locality;
-      vector<int> valid_objs_per_locality;
-      for (int i = 0; i < stripe->num_localities; ++i) {
-        exts_per_locality.push_back(0);
-        obs_data_per_locality.push_back(0);
-        valid_objs_per_locality.push_back(0);
-      }
-      add_num_gc_cycles(1);
       set<obj_ptr> objs;
-      list<ext_ptr > extent_list = stripe->extents;
-      space_ext_type_map reclaimed_space_by_ext_types;
-      set<int> local_parities;
-      for (ext_ptr ext : extent_list) {
-        assert(ext->get_obsolete_percentage() <= 100);
-        ret.temp_space += ext->obsolete_space;
-        double valid_objs = ext->ext_size - ext->obsolete_space;
-        if (ext_types_to_cost.find(ext->type) != ext_types_to_cost.end()) {
-          ext_types_to_cost[ext->type] += valid_objs * 2;
-          valid_objs_by_ext_type[ext->type] += valid_objs;
-          gc_ed_exts_by_type[ext->type] += 1;
-        } else {
-          ext_types_to_cost[ext->type] = valid_objs * 2;
-          valid_objs_by_ext_type[ext->type] = valid_objs;
-          gc_ed_exts_by_type[ext->type] = 1;
-        }
-        if (reclaimed_space_by_ext_types.find(ext->type) !=
-            reclaimed_space_by_ext_types.end()) {
-          reclaimed_space_by_ext_types[ext->type] += ext->obsolete_space;
-        } else {
-          reclaimed_space_by_ext_types[ext->type] = ext->obsolete_space;
-        }
-        ret.valid_obj_transfers += valid_objs;
-        valid_objs_per_locality[ext->locality] += valid_objs;
-        striping_process_coordinator->gc_extent(ext, objs);
-        exts_per_locality[ext->locality] += 1;
-        obs_data_per_locality[ext->locality] += ext->obsolete_space;
-        if (local_parities.find(ext->locality) == local_parities.end()) {
-          local_parities.insert(ext->locality);
-        }
-        ret.num_exts_replaced += 1;
-        stripe->del_extent(ext);
+      apply_plan(plan, ret);
+      int local_parities = 0;
+      for (int n : stripe->localities)
+        local_parities += n > 0;
+      for (size_t i = 0; i < plan.slots.size(); i++) {
+        int slot = plan.slots[i];
+        ext_ptr ext = stripe->slots[slot];
+        striping_process_coordinator->gc_objects(plan.survivors[i], objs);
+        stripe->del_extent(slot);
         extent_manager->delete_extent(ext);
       }
-      add_num_exts_gced(ret.num_exts_replaced);
-      add_localities_in_gc(local_parities.size());
-      ret.reclaimed_space_by_ext_types = reclaimed_space_by_ext_types;
+      add_localities_in_gc(local_parities);
       if (ret.temp_space > 0) {
         stripe_manager->delete_stripe(stripe);
       }
@@ -447,60 +568,209 @@ public:
 
     gc_handler_ret gc_handler(set<stripe_ptr> &stripe_set) override {
       struct gc_handler_ret ret;
-      set<stripe_ptr> deleted;
-      vector<stripe_ptr> stripe_lst = sorted_stripe_set(stripe_set);
-      for (auto stripe : stripe_lst) {
-        double obsolete = stripe->get_obsolete_percentage();
-        if (obsolete >= primary_threshold && stripe != nullptr) {
-          // fprintf(stderr,"%f %d", configtime, stripe->id);
-          stripe_gc_ret stripe_gc_res = stripe_gc(stripe);
-          for (auto &kv : stripe_gc_res.reclaimed_space_by_ext_types) {
-            string key = kv.first;
-            if (ret.total_reclaimed_space_by_ext_type.find(key) !=
-                ret.total_reclaimed_space_by_ext_type.end()) {
-              ret.total_reclaimed_space_by_ext_type[key] +=
-                  stripe_gc_res.reclaimed_space_by_ext_types[key];
-            } else {
-              ret.total_reclaimed_space_by_ext_type[key] =
-                  stripe_gc_res.reclaimed_space_by_ext_types[key];
-            }
-          }
-          if (stripe_gc_res.temp_space > 0) {
-            deleted.insert(stripe);
-          }
-          ret.reclaimed_space += stripe_gc_res.temp_space;
-          ret.total_user_reads += stripe_gc_res.user_reads;
-          ret.total_user_writes += stripe_gc_res.user_writes;
-          ret.total_valid_obj_transfers += stripe_gc_res.valid_obj_transfers;
-          ret.total_storage_node_to_parity_calculator +=
-              stripe_gc_res.storage_node_to_parity_calculator;
-          ret.total_global_parity_reads += stripe_gc_res.global_parity_reads;
-          ret.total_global_parity_writes += stripe_gc_res.global_parity_writes;
-          ret.total_local_parity_reads += stripe_gc_res.local_parity_reads;
-          ret.total_local_parity_writes += stripe_gc_res.local_parity_writes;
-          ret.total_obsolete_data_reads += stripe_gc_res.obsolete_data_reads;
-          ret.total_absent_data_reads += stripe_gc_res.absent_data_reads;
-          ret.total_num_exts_replaced += stripe_gc_res.num_exts_replaced;
-        }
-      }
-      for (auto d : deleted)
-        stripe_set.erase(d);
+      collect_stripes(stripe_set, ret);
+      finish_gc_cycle(ret);
+      return ret;
+    }
+
+    // Regenerates extents every cycle, even without deletions
+    bool has_pending_work() override { return true; }
+
+    /*
+     * Replaces the collected stripes by packing their valid objects, along
+     * with new ones for the reclaimed space, into new stripes.
+     */
+    void finish_gc_cycle(gc_handler_ret &ret) override {
       striping_process_coordinator->generate_exts();
       striping_process_coordinator->generate_objs(ret.reclaimed_space);
       striping_process_coordinator->pack_exts(ret.total_num_exts_replaced);
       for (int i = 0; i < ret.total_num_exts_replaced; ++i) {
         str_costs stripe_res = striping_process_coordinator->get_stripe();
         int num_stripes = stripe_res.stripes;
-        int user_reads = stripe_res.reads;
-        int user_writes = stripe_res.writes;
-        int parity_writes = user_writes - user_reads;
-        ret.total_global_parity_writes += parity_writes / 2.0;
-        ret.total_local_parity_writes += parity_writes / 2.0;
+        capacity_t user_reads = stripe_res.reads;
+        capacity_t user_writes = stripe_res.writes;
+        capacity_t parity_writes = user_writes - user_reads;
+        ret.total_global_parity_writes += parity_writes / 2;
+        ret.total_local_parity_writes += parity_writes - parity_writes / 2;
         user_writes = user_reads;
         ret.total_user_writes += user_writes;
         ret.total_user_reads += user_reads;
       }
-      return ret;
     }
   };
+
+/*
+ * Collects stripes under a fixed GC bandwidth budget per cycle, on top of
+ * any of the strategies above. Rather than collecting every eligible stripe,
+ * it ranks them by reclaimable space per byte of estimated GC traffic and
+ * collects them greedily until the budget is spent. Eligible stripes that
+ * do not fit stay in a backlog and compete again in the next cycles.
+ */
+template <typename Strategy>
+class BandwidthBudgetGCStrategy : public Strategy {
+  long double budget_per_cycle;
+  set<stripe_ptr> backlog;
+
+  struct candidate {
+    double score;
+    capacity_t traffic;
+    stripe_ptr stripe;
+  };
+
+public:
+  template <typename... Args>
+  BandwidthBudgetGCStrategy(long double budget_per_cycle, Args &&...args)
+      : Strategy(std::forward<Args>(args)...),
+        budget_per_cycle(budget_per_cycle) {}
+
+  size_t backlog_size() { return backlog.size(); }
+
+  bool has_pending_work() override {
+    return !backlog.empty() || Strategy::has_pending_work();
+  }
+
+  // The budget of a cycle counts even when there is nothing to collect
+  gc_handler_ret idle_result() override {
+    gc_handler_ret ret = Strategy::idle_result();
+    ret.gc_budget = budget_per_cycle;
+    return ret;
+  }
+
+  gc_handler_ret gc_handler(set<stripe_ptr> &stripe_set) override {
+    gc_handler_ret ret;
+    ret.gc_budget = budget_per_cycle;
+    backlog.insert(stripe_set.begin(), stripe_set.end());
+    vector<candidate> candidates;
+    candidates.reserve(backlog.size());
+    for (auto it = backlog.begin(); it != backlog.end();) {
+      const stripe_ptr &stripe = *it;
+      // A stripe that is not eligible anymore leaves the backlog, the next
+      // deletion in it brings it back
+      if (stripe->get_obsolete_percentage() < this->primary_threshold) {
+        it = backlog.erase(it);
+        continue;
+      }
+      repl_data data = this->replacement_data(stripe);
+      capacity_t traffic = this->estimate_gc_traffic(stripe, data);
+      double score =
+          traffic > 0 ? (double)data.obsolete / traffic : data.obsolete;
+      candidates.push_back({score, traffic, stripe});
+      ++it;
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const candidate &a, const candidate &b) {
+                if (a.score != b.score)
+                  return a.score > b.score;
+                return a.stripe->id < b.stripe->id;
+              });
+
+    capacity_t spent = 0;
+    for (auto &c : candidates) {
+      if (spent >= budget_per_cycle)
+        break;
+      // The best stripe is always collected, so that a stripe costing more
+      // than the whole budget cannot stay in the backlog forever
+      if (spent > 0 && spent + c.traffic > budget_per_cycle)
+        continue;
+      stripe_gc_ret stripe_gc_res = this->stripe_gc(c.stripe);
+      this->add_stripe_gc_result(ret, stripe_gc_res, c.stripe);
+      spent += stripe_gc_res.bandwidth();
+      backlog.erase(c.stripe);
+      if (stripe_gc_res.temp_space > 0)
+        stripe_set.erase(c.stripe);
+    }
+    for (auto &stripe : backlog)
+      ret.backlog_space += stripe->obsolete;
+    ret.backlog_stripes = backlog.size();
+    this->finish_gc_cycle(ret);
+    return ret;
+  }
+};
+/*
+ * LFS style cost-benefit selection on top of any of the strategies above.
+ * Every eligible stripe is scored by
+ *
+ *   reclaimable space * age / estimated GC traffic
+ *
+ * and at most stripes_per_cycle of the best ones are collected each cycle,
+ * so that the others can keep accumulating obsolete data.
+ *
+ * A stripe's reclaimable space per byte of GC traffic only changes with its
+ * deletions, so it is worked out for the stripes with deletions in the
+ * cycle and kept for the others. Ages keep growing at different rates of
+ * score, so stored scores cannot be compared across cycles; every cycle
+ * scores all candidates from their stored rates at the current time, which
+ * takes a multiplication per stripe rather than walking its extents.
+ */
+template <typename Strategy>
+class CostBenefitGCStrategy : public Strategy {
+  struct candidate {
+    double score;
+    stripe_ptr stripe;
+
+    bool operator<(const candidate &other) const {
+      if (score != other.score)
+        return score > other.score;
+      return stripe->id < other.stripe->id;
+    }
+  };
+
+  int stripes_per_cycle;
+  // Reclaimable space per byte of estimated GC traffic of every eligible
+  // stripe
+  unordered_map<stripe_ptr, double> rates;
+
+  double rate(const stripe_ptr &stripe) {
+    repl_data data = this->replacement_data(stripe);
+    capacity_t traffic = this->estimate_gc_traffic(stripe, data);
+    return traffic > 0 ? (double)data.obsolete / traffic : data.obsolete;
+  }
+
+  double score(const stripe_ptr &stripe, double rate) {
+    return rate * std::max(0.0, (double)configtime - stripe->timestamp);
+  }
+
+public:
+  template <typename... Args>
+  CostBenefitGCStrategy(int stripes_per_cycle, Args &&...args)
+      : Strategy(std::forward<Args>(args)...),
+        stripes_per_cycle(stripes_per_cycle) {}
+
+  size_t num_candidates() { return rates.size(); }
+
+  bool has_pending_work() override {
+    return !rates.empty() || Strategy::has_pending_work();
+  }
+
+  gc_handler_ret gc_handler(set<stripe_ptr> &stripe_set) override {
+    gc_handler_ret ret;
+    for (auto &stripe : this->sorted_stripe_set(stripe_set)) {
+      if (stripe->get_obsolete_percentage() < this->primary_threshold)
+        rates.erase(stripe);
+      else
+        rates[stripe] = rate(stripe);
+    }
+
+    vector<candidate> candidates;
+    candidates.reserve(rates.size());
+    for (auto &it : rates)
+      candidates.push_back({score(it.first, it.second), it.first});
+    size_t num_best =
+        std::min(candidates.size(), (size_t)std::max(stripes_per_cycle, 0));
+    std::partial_sort(candidates.begin(), candidates.begin() + num_best,
+                      candidates.end());
+
+    for (size_t i = 0; i < num_best; i++) {
+      const stripe_ptr &stripe = candidates[i].stripe;
+      rates.erase(stripe);
+      stripe_gc_ret stripe_gc_res = this->stripe_gc(stripe);
+      this->add_stripe_gc_result(ret, stripe_gc_res, stripe);
+      if (stripe_gc_res.temp_space > 0)
+        stripe_set.erase(stripe);
+    }
+    ret.backlog_stripes = rates.size();
+    this->finish_gc_cycle(ret);
+    return ret;
+  }
+};
 #endif // __GC_STRATEGIES_H_
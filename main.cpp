@@ -5,17 +5,13 @@
 #include "data_center.h"
 #include "object_packer.h"
 #include "samplers.h"
+#include "sharded_data_center.h"
 #include "stripers.h"
+#include "what_if.h"
 #include <fstream>
 #include <string>
 using ext_lst = std::vector<int>;
 
-/*
- * Since we can't just evaluate function name like Python, a long switch
- * statement to parse the input string is necessary.
- */
-
-
 void print_to_file(const string confname, const string filename, int ext_size,
                    const short primary_threshold, const short secondary_threshold, sim_metric res){
       std::ofstream myFile(filename);
@@ -47,6 +43,30 @@ void print_to_file(const string confname, const string filename, int ext_size,
                                 "dc size",
                                 "leftovers",
                                 "ave exts gced",
+                                "steady state day",
+                                "steady obsolete percentage",
+                                "steady obsolete percentage error",
+                                "steady gc ratio",
+                                "steady gc ratio error",
+                                "sampled lanes",
+                                "error bounds",
+                                "peak node traffic",
+                                "peak node gc traffic",
+                                "node gc imbalance",
+                                "device busy time",
+                                "gc device busy time",
+                                "max device utilization",
+                                "latency p50",
+                                "latency p99",
+                                "latency p99.9",
+                                "slo violation",
+                                "ftl host writes",
+                                "flash writes",
+                                "device waf",
+                                "end-to-end waf",
+                                "flash erases",
+                                "mean block erases",
+                                "max block erases",
     };
     for(auto s : row_header)
     {
@@ -59,6 +79,10 @@ void print_to_file(const string confname, const string filename, int ext_size,
       obs_percentages_str += std::to_string(op) + ",";
     }
     obs_percentages_str += "]";
+    string error_bounds_str = "{";
+    for (auto &it : res.error_bounds)
+      error_bounds_str += it.first + ": " + std::to_string(it.second) + ";";
+    error_bounds_str += "}";
     myFile << ext_size << ","
             << primary_threshold << ","
             << secondary_threshold << ","
@@ -86,64 +110,35 @@ void print_to_file(const string confname, const string filename, int ext_size,
             << res.num_stripes << ","
             << res.dc_size << ","
             << res.total_leftovers << ","
-            << res.ave_exts_gced << "," << endl;
+            << res.ave_exts_gced << ","
+            << res.steady_state.time << ","
+            << res.steady_state.obs_perc.mean << ","
+            << res.steady_state.obs_perc.error << ","
+            << res.steady_state.gc_ratio.mean << ","
+            << res.steady_state.gc_ratio.error << ","
+            << res.sampled_lanes << "/" << res.num_lanes << ","
+            << error_bounds_str << ","
+            << res.peak_node_traffic << ","
+            << res.peak_node_gc_traffic << ","
+            << res.node_gc_imbalance << ","
+            << res.device.busy_time << ","
+            << res.device.gc_busy_time << ","
+            << res.device.max_utilization << ","
+            << res.device.latency_p50 << ","
+            << res.device.latency_p99 << ","
+            << res.device.latency_p999 << ","
+            << res.device.slo_violation << ","
+            << res.ftl.host_writes << ","
+            << res.ftl.flash_writes << ","
+            << res.ftl.device_waf << ","
+            << res.ftl.end_to_end_waf << ","
+            << res.ftl.erases << ","
+            << res.ftl.mean_block_erases << ","
+            << res.ftl.max_block_erases << "," << endl;
 
   myFile.close();
 }
 
-DataCenter (*parse_config(string confname))(const unsigned long, const float,
-                                            const float, const int, const short,
-                                            const short,
-                                            shared_ptr<SimpleSampler>,
-                                            const short, const float,
-                                            const int) {
-  // Baseline
-  if (confname == "stripe_level_with_no_exts_config")
-    return stripe_level_with_no_exts_config;
-  else if (confname == "no_exts_mix_objs_config")
-    return no_exts_mix_objs_config;
-  // Cross-extent erasure coding
-  else if (confname == "stripe_level_with_extents_separate_pools_config")
-    return stripe_level_with_extents_separate_pools_config;
-  else if (confname ==
-           "stripe_level_with_extents_separate_pools_efficient_config")
-    return stripe_level_with_extents_separate_pools_efficient_config;
-  // Placement strategies
-  else if (confname == "age_based_config")
-    return age_based_config;
-  else if (confname == "generational_config")
-    return generational_config;
-  else if (confname == "size_based_stripe_level_no_exts_baseline_config")
-    return size_based_stripe_level_no_exts_baseline_config;
-  else if (confname ==
-           "size_based_stripe_level_no_exts_larger_whole_obj_config")
-    return size_based_stripe_level_no_exts_larger_whole_obj_config;
-  else if (confname == "size_based_stripe_level_no_exts_smaller_obj_config")
-    return size_based_stripe_level_no_exts_smaller_obj_config;
-  else if (confname ==
-           "size_based_stripe_level_no_exts_dynamic_strategy_config")
-    return size_based_stripe_level_no_exts_dynamic_strategy_config;
-  else if (confname == "size_based_whole_obj_config")
-    return size_based_whole_obj_config;
-  else if (confname == "age_based_config_no_exts")
-    return age_based_config_no_exts;
-  else if (confname == "age_based_rand_config_no_exts")
-    return age_based_rand_config_no_exts;
-  else if (confname == "randomized_objs_no_exts_config")
-    return randomized_objs_no_exts_config;
-  else if (confname == "randomized_ext_placement_joined_pools_config")
-    return randomized_ext_placement_joined_pools_config;
-  else if (confname == "randomized_obj_placement_joined_pools_config")
-    return randomized_obj_placement_joined_pools_config;
-  else if (confname == "randomized_objs_no_exts_mix_objs_config")
-    return randomized_objs_no_exts_mix_objs_config;
-  else if (confname == "no_exts_mix_objs_config")
-    return no_exts_mix_objs_config;
-  return nullptr;
-}
-
-
-
 /*
  * TODO: Run the simulator and write out the results to the csv file.
  */
@@ -154,12 +149,48 @@ void run_simulator(const string confname, const int percent_correct, const ext_l
                    const float striping_cycle, const float deletion_cycle,
                    const unsigned long data_center_size, const float simul_time,
                    SimpleSampler &sampler, const int total_objs,
-                   bool save_to_file = true, bool record_ext_types = true) {
+                   bool save_to_file = true, bool record_ext_types = true,
+                   const int time_series_interval = 0,
+                   const int memory_report_interval = 0,
+                   const int gc_threads = 1,
+                   const bool sample_pipeline = false,
+                   const int num_shards = 1,
+                   const float what_if_warmup = 0,
+                   const vector<std::pair<short, short>> what_if_thresholds = {},
+                   const double steady_state_tolerance = 0,
+                   const float steady_state_window = 7,
+                   const int approx_lanes = 0,
+                   const int approx_sampled_lanes = 2,
+                   const int num_storage_nodes = 0,
+                   const string placement = "random",
+                   const bool model_devices = false,
+                   const device_params device = device_params(),
+                   const bool model_ftl = false,
+                   const string ftl_victim = "greedy",
+                   const ftl_params ftl = ftl_params()) {
   string file_basename = confname;
   int num_objs_per_cycle = total_objs / simul_time * striping_cycle;
   auto config = parse_config(confname);
   shared_ptr<SimpleSampler> samplerptr = make_shared<SimpleSampler>(sampler);
 
+  placement_policy policy = placement_policy::random;
+  if (num_storage_nodes > 0 && !parse_placement_policy(placement, policy)) {
+    std::cerr << "Error: invalid placement policy (" << placement
+        << ") detected! Exiting..." << std::endl;
+    exit(1);
+  }
+
+  ftl_params node_ftl = ftl;
+  if (num_storage_nodes > 0 && model_ftl) {
+    if (!parse_ftl_victim_policy(ftl_victim, node_ftl.victim)) {
+      std::cerr << "Error: invalid FTL victim policy (" << ftl_victim
+          << ") detected! Exiting..." << std::endl;
+      exit(1);
+    }
+    if (node_ftl.node_capacity <= 0)
+      node_ftl.node_capacity = (double)data_center_size / num_storage_nodes;
+  }
+
   if (!config && (confname != "mortal_immortal_no_exts_config")) {
     std::cerr << "Error: invalid config (" << confname
         << ") detected! Exiting..." << std::endl;
@@ -168,25 +199,79 @@ void run_simulator(const string confname, const int percent_correct, const ext_l
 
   for (auto ext_size : ext_sizes) {
     std::cout << "Extent " << ext_size << std::endl;
-    DataCenter dc = confname == "mortal_immortal_no_exts_config" ? 
-      mortal_immortal_no_exts_config(data_center_size, striping_cycle, simul_time, ext_size,
-                     primary_threshold, secondary_threshold, samplerptr,
-                     num_stripes_per_cycle, deletion_cycle, num_objs_per_cycle, percent_correct):
-      config(data_center_size, striping_cycle, simul_time, ext_size,
-                     primary_threshold, secondary_threshold, samplerptr,
-                     num_stripes_per_cycle, deletion_cycle, num_objs_per_cycle);
-    auto res = dc.run_simulation();
-    if(save_to_file)
-    {
-      string filename;
+    auto make_dc = [&](unsigned long dc_size, int objs_per_cycle) {
+      return confname == "mortal_immortal_no_exts_config" ?
+        mortal_immortal_no_exts_config(dc_size, striping_cycle, simul_time, ext_size,
+                       primary_threshold, secondary_threshold, samplerptr,
+                       num_stripes_per_cycle, deletion_cycle, objs_per_cycle, percent_correct):
+        config(dc_size, striping_cycle, simul_time, ext_size,
+                       primary_threshold, secondary_threshold, samplerptr,
+                       num_stripes_per_cycle, deletion_cycle, objs_per_cycle);
+    };
+    auto make_filename = [&](short p_threshold, short s_threshold) {
       if(confname == "mortal_immortal_no_exts_config")
       {
-        filename = string(confname) + "_" + std::to_string(percent_correct) + "_" + std::to_string(ext_size) + "-" + std::to_string(total_objs) + "_objs-"
-        +std::to_string(primary_threshold)+"-"+std::to_string(secondary_threshold)+ "_" + std::string(sampler) + ".csv";
-      }else{
-        filename = string(confname) + "_" + std::to_string(ext_size) + "-" + std::to_string(total_objs) + "_objs-"
-        +std::to_string(primary_threshold)+"-"+std::to_string(secondary_threshold)+ "_" + std::string(sampler) + ".csv";
+        return string(confname) + "_" + std::to_string(percent_correct) + "_" + std::to_string(ext_size) + "-" + std::to_string(total_objs) + "_objs-"
+        +std::to_string(p_threshold)+"-"+std::to_string(s_threshold)+ "_" + std::string(sampler) + ".csv";
+      }
+      return string(confname) + "_" + std::to_string(ext_size) + "-" + std::to_string(total_objs) + "_objs-"
+      +std::to_string(p_threshold)+"-"+std::to_string(s_threshold)+ "_" + std::string(sampler) + ".csv";
+    };
+    string filename = make_filename(primary_threshold, secondary_threshold);
+    if (num_shards > 1 || approx_lanes > 0) {
+      ShardedDataCenter sharded_dc(
+          approx_lanes > 0 ? approx_sampled_lanes : num_shards,
+          data_center_size, num_objs_per_cycle, make_dc, sampler.get_seed(),
+          approx_lanes);
+      auto res = sharded_dc.run_simulation();
+      if (save_to_file)
+        print_to_file(confname, filename, ext_size, primary_threshold,
+                      secondary_threshold, res);
+      continue;
+    }
+    DataCenter dc = make_dc(data_center_size, num_objs_per_cycle);
+    shared_ptr<TimeSeriesWriter> time_series = nullptr;
+    if (time_series_interval > 0) {
+      string ts_filename = filename.substr(0, filename.size() - 4) + "_timeseries.csv";
+      time_series = make_shared<TimeSeriesWriter>(ts_filename);
+      dc.set_time_series(time_series, time_series_interval);
+    }
+    dc.set_memory_report(memory_report_interval);
+    dc.set_gc_threads(gc_threads);
+    if (num_storage_nodes > 0) {
+      auto nodes = make_shared<StorageNodes>(num_storage_nodes, policy,
+                                             sampler.get_seed());
+      if (model_ftl)
+        nodes->set_ftl(node_ftl);
+      dc.set_storage_nodes(nodes);
+    }
+    if (num_storage_nodes > 0 && model_devices)
+      dc.set_device_model(make_shared<DeviceModel>(device));
+    if (steady_state_tolerance > 0)
+      dc.set_steady_state(make_shared<SteadyStateMonitor>(
+          std::max(1, (int)std::round(steady_state_window / striping_cycle)),
+          8, steady_state_tolerance));
+    dc.set_sample_pipeline(sample_pipeline);
+    if (what_if_warmup > 0) {
+      vector<what_if_branch> branches;
+      for (auto &t : what_if_thresholds)
+        branches.push_back(threshold_branch(t.first, t.second));
+      auto results = run_what_if(dc, what_if_warmup, branches);
+      for (size_t i = 0; i < results.size(); i++) {
+        auto &t = what_if_thresholds[i];
+        if (results[i].ok && save_to_file)
+          print_to_file(confname, make_filename(t.first, t.second), ext_size,
+                        t.first, t.second, results[i].metric);
       }
+      if (time_series)
+        time_series->close();
+      continue;
+    }
+    auto res = dc.run_simulation();
+    if (time_series)
+      time_series->close();
+    if(save_to_file)
+    {
       print_to_file(confname, filename, ext_size, primary_threshold, secondary_threshold, res);
     }
 
@@ -224,6 +309,62 @@ int main(int argc, char *argv[]) {
   // Flag to record information about ext size distributions - small object
   // extents, large obj exts, etc
   const bool record_ext_types = false;
+  // Write per-cycle metrics to a *_timeseries.csv file every N cycles,
+  // 0 disables the time series
+  const int time_series_interval = 0;
+  // Sample the memory used by the simulator's data structures every N
+  // cycles and print it at the end of the run, 0 disables the report
+  const int memory_report_interval = 0;
+  // Threads planning the stripe GCs of a cycle, 1 keeps the GC on the
+  // simulation thread
+  const int gc_threads = 1;
+  // Sample new objects ahead of the simulation on a producer thread. The
+  // objects come from the same stream with or without the pipeline
+  const bool sample_pipeline = false;
+  // Split the data center into this many independent shards simulated in
+  // parallel, each with an even share of the capacity and of the objects.
+  // The shards have no time series, memory report or GC threads
+  const int num_shards = 1;
+  // Run to day what_if_warmup once, then fork a process per pair of
+  // (primary, secondary) GC thresholds that continues from there with them.
+  // Each pair gets its own result file, 0 disables the what-if branches
+  const float what_if_warmup = 0;
+  const vector<std::pair<short, short>> what_if_thresholds = {
+      {10, 10}, {20, 20}, {30, 30}};
+  // Stop a run once the obsolete percentage and the GC ratio are steady to
+  // within this fraction of their means over 8 windows of
+  // steady_state_window days, 0 always runs to simul_time. Not used by
+  // sharded runs
+  const double steady_state_tolerance = 0;
+  const float steady_state_window = 7;
+  // Approximate the data center by simulating approx_sampled_lanes random
+  // lanes out of approx_lanes, each lane getting 1/approx_lanes of the
+  // capacity and of the objects. Metrics are scaled up to the whole data
+  // center with 95% error bounds, see README.md for the accuracy. 0
+  // simulates every object
+  const int approx_lanes = 0;
+  const int approx_sampled_lanes = 2;
+  // Place the extents of every stripe on this many storage nodes and report
+  // the peak traffic of a node, 0 does not model the nodes. The placement
+  // is one of random, round_robin or load_aware. Not used by sharded runs
+  const int num_storage_nodes = 0;
+  const string placement = "random";
+  // Turn the traffic of the storage nodes into device busy time and
+  // foreground latency percentiles, needs num_storage_nodes. The device
+  // has {read and write throughput in size units per second, queue depth,
+  // idle latency and latency SLO in ms}
+  const bool model_devices = false;
+  const device_params device = {2e6, 1e6, 32, 0.1, 1.0};
+  // Write the extents of every storage node through a page-mapped FTL and
+  // report the device write amplification and flash erases, needs
+  // num_storage_nodes. The FTL has {page size in size units, pages per
+  // erase block, over-provisioning, logical capacity of a node in size
+  // units, 0 for an even share of data_center_size}, and collects the
+  // greedy or cost_benefit victim. Memory grows with the pages written, so
+  // pick the page size accordingly
+  const bool model_ftl = false;
+  const string ftl_victim = "greedy";
+  const ftl_params ftl = {16, 256, 0.07, 0};
 
   const int total_objs = num_objs / (365 / simul_time);
 
@@ -237,7 +378,13 @@ int main(int argc, char *argv[]) {
   std::cout << threshold << ", " << secondary_threshold << std::endl;
   run_simulator(config, percent_correct, ext_sizes, threshold, secondary_threshold,
                 num_stripes_per_cycle, striping_cycle, deletion_cycle,
-                data_center_size, simul_time, sampler, total_objs);
+                data_center_size, simul_time, sampler, total_objs, true,
+                record_ext_types, time_series_interval,
+                memory_report_interval, gc_threads, sample_pipeline,
+                num_shards, what_if_warmup, what_if_thresholds,
+                steady_state_tolerance, steady_state_window, approx_lanes,
+                approx_sampled_lanes, num_storage_nodes, placement,
+                model_devices, device, model_ftl, ftl_victim, ftl);
   
   return 0;
 }
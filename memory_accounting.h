@@ -0,0 +1,110 @@
+#ifndef __MEMORY_ACCOUNTING_H_
+#define __MEMORY_ACCOUNTING_H_
+
+#include <cstddef>
+#include <cstdio>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+ * Live entity count and approximate heap footprint of one structure of the
+ * simulator. The byte counts are estimates based on libstdc++ node layouts
+ * rather than exact allocator numbers, but they are cheap enough to sample
+ * while the simulation runs and accurate enough to tell which structure is
+ * growing.
+ */
+struct mem_usage {
+  size_t count = 0;
+  size_t bytes = 0;
+
+  mem_usage &operator+=(const mem_usage &other) {
+    count += other.count;
+    bytes += other.bytes;
+    return *this;
+  }
+};
+
+namespace mem_size {
+
+// Reference counts and vtable of a make_shared control block
+constexpr size_t shared_block = 16;
+// Color, parent, left and right pointers of a red-black tree node
+constexpr size_t tree_node = 32;
+// Previous and next pointers of a list node
+constexpr size_t list_node = 16;
+// Next pointer (and cached hash) of a hash table node
+constexpr size_t hash_node = 16;
+
+template <typename T> size_t of(const std::vector<T> &v) {
+  return v.capacity() * sizeof(T);
+}
+
+template <typename T> size_t of(const std::list<T> &l) {
+  return l.size() * (list_node + sizeof(T));
+}
+
+template <typename T, typename C> size_t of(const std::set<T, C> &s) {
+  return s.size() * (tree_node + sizeof(T));
+}
+
+template <typename K, typename V, typename C>
+size_t of(const std::map<K, V, C> &m) {
+  return m.size() * (tree_node + sizeof(std::pair<const K, V>));
+}
+
+template <typename K, typename V, typename H>
+size_t of(const std::unordered_map<K, V, H> &m) {
+  return m.bucket_count() * sizeof(void *) +
+         m.size() * (hash_node + sizeof(std::pair<const K, V>));
+}
+
+} // namespace mem_size
+
+using mem_report = std::vector<std::pair<std::string, mem_usage>>;
+
+/*
+ * Keeps the periodic memory samples taken during a simulation and prints
+ * them as a table with one row per sample and one column per structure.
+ */
+class MemoryTracker {
+  std::vector<double> times;
+  std::vector<mem_report> samples;
+
+public:
+  void add_sample(double time, const mem_report &report) {
+    times.push_back(time);
+    samples.push_back(report);
+  }
+
+  bool empty() { return samples.empty(); }
+
+  void print(FILE *out = stdout) {
+    if (samples.empty())
+      return;
+    const mem_report &last = samples.back();
+    fprintf(out, "Memory usage (MiB):\n%10s", "time");
+    for (auto &entry : last)
+      fprintf(out, " %16s", entry.first.c_str());
+    fprintf(out, " %16s\n", "total");
+    for (size_t i = 0; i < samples.size(); i++) {
+      size_t total = 0;
+      fprintf(out, "%10.2f", times[i]);
+      for (auto &entry : samples[i]) {
+        fprintf(out, " %16.2f", entry.second.bytes / 1048576.0);
+        total += entry.second.bytes;
+      }
+      fprintf(out, " %16.2f\n", total / 1048576.0);
+    }
+    fprintf(out, "Live entities at %.2f:\n", times.back());
+    for (auto &entry : last)
+      fprintf(out, "%-18s %12zu %14zu bytes\n", entry.first.c_str(),
+              entry.second.count, entry.second.bytes);
+  }
+};
+
+#endif // __MEMORY_ACCOUNTING_H_
@@ -2,13 +2,17 @@
 #include "config.h"
 #include "event_manager.h"
 #include "extent_object_stripe.h"
+#include "memory_accounting.h"
+#include "profiler.h"
+#include "sample_pipeline.h"
 #include "samplers.h"
+#include <cmath>
 #include <memory>
 #include <unordered_map>
 
 using std::shared_ptr;
 using std::unordered_map;
-using obj_record = std::pair<obj_ptr, float>;
+using obj_record = std::pair<obj_ptr, capacity_t>;
 using object_lst = std::vector<obj_record>;
 
 class ObjectManager {
@@ -18,6 +22,13 @@ public:
   shared_ptr<Sampler> sampler;
   unordered_map<int, obj_ptr> objects;
   bool add_noise;
+  // Running total of sampled object sizes, used to estimate how many
+  // objects are needed to write a given amount of data
+  capacity_t total_sampled_size = 0;
+  long num_sampled = 0;
+  static constexpr long min_samples_for_mean = 100;
+  // Samples of new objects come from here instead of the sampler when set
+  shared_ptr<SampleSource> sample_source;
 
   ObjectManager() {}
   ObjectManager(shared_ptr<EventManager> e_m, shared_ptr<Sampler> s,
@@ -29,28 +40,54 @@ public:
     srand(0);
   }
 
+  /*
+   * Takes the samples of new objects one at a time from the given source,
+   * such as a PipelinedSampleSource sampling ahead on another thread.
+   * Passing a nullptr goes back to asking the sampler for each batch.
+   */
+  void set_sample_source(shared_ptr<SampleSource> source) {
+    sample_source = source;
+  }
+
   // docstring and code doesnt match managers.py
+  // Creates an object from its sampled size, life and life noise
+  void add_new_object(object_lst &new_objs, float sampled_size, float life,
+                      int noise) {
+    // Samplers may return fractional sizes, capacity is kept in whole units
+    capacity_t size = std::llround(sampled_size);
+    total_sampled_size += size;
+    num_sampled++;
+    if (add_noise) {
+      noise -= 12;
+      life += noise / 24.0;
+    }
+    life += configtime;
+    obj_ptr obj = make_shared<ExtentObject>(max_id, size, life);
+    this->objects[max_id] = obj;
+    max_id++;
+    event_manager->put_event(life, obj);
+    new_objs.emplace_back(std::move(obj), size);
+  }
+
   object_lst create_new_object(int num_samples = 1) {
+    PROFILE_PHASE(Phase::ObjectSampling);
     // std::cout << "create_new_object" << num_samples << std::endl;
     object_lst new_objs = object_lst();
-    auto size_age_samples = sampler->get_size_age_sample(num_samples);
-    sizes size_samples = size_age_samples.first;
-    lives life_samples = size_age_samples.second;
-    for (int i = 0; i < size_samples.size(); i++) {
-      float size = size_samples[i];
-      float life = life_samples[i];
-      int noise = randint(0, 24);
-      if (add_noise) {
-        noise -= 12;
-        life += noise / 24.0;
+    if (sample_source) {
+      new_objs.reserve(num_samples);
+      for (int i = 0; i < num_samples; i++) {
+        obj_sample s = sample_source->next();
+        add_new_object(new_objs, s.size, s.life, s.noise);
       }
-      life += configtime;
-      obj_ptr obj = make_shared<ExtentObject>(max_id, size, life);
-      new_objs.emplace_back(std::make_pair(obj, size));
-      this->objects[max_id] = obj;
-      max_id++;
-      event_manager->put_event(life, obj);
+      return new_objs;
     }
+    auto size_age_samples = sampler->get_size_age_sample(num_samples);
+    const sizes &size_samples = size_age_samples.first;
+    const lives &life_samples = size_age_samples.second;
+    new_objs.reserve(size_samples.size());
+    for (int i = 0; i < size_samples.size(); i++)
+      add_new_object(new_objs, size_samples[i], life_samples[i],
+                     randint(0, 24));
     return new_objs;
   }
 
@@ -62,6 +99,27 @@ public:
 
   int get_num_objs() { return objects.size(); }
 
+  // Mean size of the objects sampled so far, 0 until enough objects have
+  // been sampled for the mean to be meaningful
+  double mean_obj_size() {
+    return num_sampled >= min_samples_for_mean
+               ? (double)total_sampled_size / num_sampled
+               : 0;
+  }
+
+  /*
+   * Live objects, including the list of extents each object keeps.
+   */
+  mem_usage memory_usage() {
+    mem_usage ret;
+    ret.count = objects.size();
+    ret.bytes = mem_size::of(objects);
+    for (auto &kv : objects)
+      ret.bytes += mem_size::shared_block + sizeof(ExtentObject) +
+                   mem_size::of(kv.second->extents);
+    return ret;
+  }
+
   void remove_object(obj_ptr obj) {
     objects.erase(obj->id);
   }
@@ -10,6 +10,7 @@
 #include "extent_object_stripe.h"
 #include "extent_stack.h"
 #include "object_manager.h"
+#include "profiler.h"
 #include "stripers.h"
 #include <algorithm>
 #include <cmath>
@@ -21,8 +22,8 @@
 #include <variant>
 #include <vector>
 
-typedef std::tuple<float, obj_ptr, float> obj_pq_record;
-using obj_pq = std::priority_queue<std::variant<obj_record, obj_pq_record>>;
+typedef std::tuple<float, obj_ptr, capacity_t> obj_pq_record;
+using obj_pq_entry = std::variant<obj_record, obj_pq_record>;
 using current_extents = std::unordered_map<int, ext_ptr >;
 using ext_types_mgr = std::unordered_map<string, int>;
 
@@ -47,13 +48,36 @@ inline bool lower_bound_cmpr(const float v, const obj_record &record) {
 inline bool upper_bound_cmpr(const float v, const obj_record &record) {
   return v > record.second;
 }
+/*
+ * Orders the object queues by key, breaking ties by object id rather than
+ * by where the objects were allocated, so that runs are reproducible.
+ * Plain records are ordered by size only.
+ */
+struct obj_pq_order {
+  bool operator()(const obj_pq_entry &a, const obj_pq_entry &b) const {
+    if (a.index() != b.index())
+      return a.index() < b.index();
+    if (auto *r1 = std::get_if<obj_pq_record>(&a)) {
+      const obj_pq_record &r2 = std::get<obj_pq_record>(b);
+      if (std::get<0>(*r1) != std::get<0>(r2))
+        return std::get<0>(*r1) < std::get<0>(r2);
+      if (std::get<1>(*r1)->id != std::get<1>(r2)->id)
+        return std::get<1>(*r1)->id < std::get<1>(r2)->id;
+      return std::get<2>(*r1) < std::get<2>(r2);
+    }
+    return std::get<obj_record>(a) < std::get<obj_record>(b);
+  }
+};
+using obj_pq =
+    std::priority_queue<obj_pq_entry, std::vector<obj_pq_entry>, obj_pq_order>;
+
 inline bool obj_record_asc_rem_size(const obj_record &p1, const obj_record p2) {
   return p1.second > p2.second;
 };
 inline bool obj_record_asc_rem_size_extent(const obj_record &p1, const obj_record p2) {
   if(p1.second == p2.second)
   {
-    return p1.first > p2.first;
+    return p1.first->id > p2.first->id;
   }
   return p1.second > p2.second;
 };
@@ -64,7 +88,7 @@ inline bool obj_record_desc_rem_size(const obj_record &p1, const obj_record p2)
 inline bool obj_record_desc_rem_size_extent(const obj_record &p1, const obj_record p2) {
   if(p1.second == p2.second)
   {
-    return p1.first < p2.first;
+    return p1.first->id < p2.first->id;
   }
   return p1.second < p2.second;
 };
@@ -99,6 +123,9 @@ protected:
   ext_types_mgr ext_types;
   short threshold, num_objs_in_pool;
   bool record_ext_types;
+  static constexpr double batch_fill_fraction = 0.75;
+  // Reused by return_current_ext_objs to avoid a new list per call
+  object_lst scratch_objs;
 
 public:
   GenericObjectPacker(
@@ -115,6 +142,25 @@ public:
     srand(0);
   }
   shared_ptr<current_extents> get_current_exts() { return current_exts; }
+  shared_ptr<object_lst> get_obj_pool() { return obj_pool; }
+
+  /*
+   * Object pool and current extents of this packer. The objects and
+   * extents themselves are accounted for by their managers.
+   */
+  mem_usage pool_memory_usage() {
+    mem_usage ret;
+    ret.count = obj_pool->size();
+    ret.bytes = mem_size::of(*obj_pool);
+    return ret;
+  }
+
+  mem_usage current_exts_memory_usage() {
+    mem_usage ret;
+    ret.count = current_exts->size();
+    ret.bytes = mem_size::of(*current_exts);
+    return ret;
+  }
 
   virtual void generate_exts() {std::cerr<<"should never be called GenericObjectPacker generatae_exts()"<<std::endl;}
 
@@ -128,14 +174,36 @@ public:
     obj_pool->emplace_back(r); 
   }
 
+  /*
+   * Removes the first n records of the object pool with a single erase.
+   * Packers that consume the pool from the front walk it with an index
+   * and drop the consumed prefix at the end, which keeps draining a pool
+   * linear in its size.
+   */
+  void pop_front_objs(size_t n) {
+    obj_pool->erase(obj_pool->begin(),
+                    obj_pool->begin() + std::min(n, obj_pool->size()));
+  }
+
   /*
    * Add the objects in obj_lst to the object pool.
    */
-  virtual void add_objs(object_lst obj_lst) {
-    obj_pool->reserve( obj_pool->size() + obj_lst.size() ); 
+  virtual void add_objs(const object_lst &obj_lst) {
     obj_pool->insert(obj_pool->end(), obj_lst.begin(), obj_lst.end());
   }
 
+  /*
+   * Puts the objects of the current extent at key back in the pool.
+   */
+  void return_current_ext_objs(float key) {
+    auto it = this->current_exts->find(key);
+    if (it == this->current_exts->end())
+      return;
+    scratch_objs.clear();
+    it->second->delete_ext(scratch_objs);
+    this->add_objs(scratch_objs);
+  }
+
   /*
    * Returns true if extent is in current extents dict and false otherwise
    */
@@ -162,19 +230,11 @@ public:
    * smaller than the gc_threshold. The rest are defined by the percentage
    * occupancy of the extent by the largest object.
    */
-  string get_extent_type(ext_ptr extent) {
-    // Find the largest object stored in the extent
-    float largest_obj = -1, local_max = 0;
-    for (auto &tuple : extent->objects) {
-      std::vector<float> sizes = tuple.second;
-      local_max = std::accumulate(sizes.begin(), sizes.end(), 0);
-      if (largest_obj < local_max) {
-        largest_obj = local_max;
-      }
-    }
+  string get_extent_type(const ext_ptr &extent) {
+    capacity_t largest_obj = extent->largest_obj;
     if (largest_obj >= this->threshold / 100.0 * extent->ext_size &&
         largest_obj < extent->ext_size) {
-      double frac = largest_obj / extent->ext_size * 10;
+      double frac = (double)largest_obj / extent->ext_size * 10;
       return std::to_string(int(floor(frac) * 10)) + "-" +
              std::to_string(int(ceil(frac) * 10));
     } else if (largest_obj < this->threshold / 100.0 * extent->ext_size) {
@@ -184,15 +244,97 @@ public:
     }
   }
 
-  void update_extent_type(ext_ptr extent) {
-    if (this->record_ext_types) {
-      string ext_type = this->get_extent_type(extent);
+  /*
+   * Sets the type of a sealed extent and records it if needed.
+   */
+  void update_extent_type(const ext_ptr &extent) {
+    extent->type = this->get_extent_type(extent);
+    if (this->record_ext_types)
+      this->ext_types[extent->type] += 1;
+  }
 
-      if (this->ext_types.find(ext_type) != this->ext_types.end())
-        this->ext_types[ext_type] += 1;
-      else
-        this->ext_types[ext_type] = 1;
+  /*
+   * Returns the current extent slot for key, creating a new extent if
+   * there is none yet.
+   */
+  ext_ptr &current_ext_at_key(int key) {
+    auto it = this->current_exts->find(key);
+    if (it == this->current_exts->end())
+      it = this->current_exts->emplace(key, this->ext_manager->create_extent())
+               .first;
+    return it->second;
+  }
+
+  /*
+   * Returns how many new objects to sample in one batch to write about
+   * `space` more data, based on the mean object size seen so far. The
+   * batch aims at batch_fill_fraction of the space so that it rarely
+   * overshoots; callers keep sampling (smaller) batches until the target
+   * is met.
+   */
+  int num_objs_for_space(double space) {
+    double mean = this->obj_manager->mean_obj_size();
+    if (mean <= 0)
+      return 1;
+    return std::max(1, int(space * batch_fill_fraction / mean));
+  }
+
+  /*
+   * Space that still has to be written to have num_exts extents at
+   * whichever key, less the data already waiting in the current extents.
+   * Packers only seal full extents, so packing less than this much new
+   * data cannot seal the last missing extent.
+   */
+  double space_for_exts(int num_exts, int num_exts_at_key) {
+    double space =
+        (num_exts - num_exts_at_key) * (double)this->ext_manager->ext_size;
+    for (auto &it : *this->current_exts)
+      space -= it.second->ext_size - it.second->free_space;
+    return space;
+  }
+
+  /*
+   * Samples new objects in batches and packs them until there are num_exts
+   * extents at key. Each pack_objects call gets the longest run of the
+   * batch that is smaller than space_for_exts, so it cannot overshoot;
+   * when not even the next object fits under it, that object is packed on
+   * its own, which seals no more extents than packing one object at a time
+   * did. Objects of the last batch that were not needed stay in the pool
+   * for the next pack_objects call.
+   */
+  void fill_exts_at_key(shared_ptr<AbstractExtentStack> extent_stack,
+                        int num_exts, float key, float pack_key) {
+    int num_exts_at_key = extent_stack->get_length_at_key(key);
+    if (num_exts_at_key >= num_exts)
+      return;
+    auto temp = std::set<obj_ptr>();
+    // Pack what is left in the pool first so that the pool is empty and
+    // space_for_exts covers all the data waiting to be sealed
+    this->pack_objects(extent_stack, temp, pack_key);
+    num_exts_at_key = extent_stack->get_length_at_key(key);
+    object_lst batch;
+    size_t next = 0;
+    while (num_exts_at_key < num_exts) {
+      double space = space_for_exts(num_exts, num_exts_at_key);
+      if (next == batch.size()) {
+        batch = this->obj_manager->create_new_object(
+            num_objs_for_space(std::max(space, 0.0)));
+        next = 0;
+        if (batch.empty())
+          return;
+      }
+      size_t end = next;
+      capacity_t run = 0;
+      while (end < batch.size() && run + batch[end].second < space)
+        run += batch[end++].second;
+      if (end == next)
+        end++;
+      this->add_objs(object_lst(batch.begin() + next, batch.begin() + end));
+      next = end;
+      this->pack_objects(extent_stack, temp, pack_key);
+      num_exts_at_key = extent_stack->get_length_at_key(key);
     }
+    this->add_objs(object_lst(batch.begin() + next, batch.end()));
   }
 
   /*
@@ -201,14 +343,7 @@ public:
   virtual void
   generate_exts_at_key(shared_ptr<AbstractExtentStack> extent_stack,
                        int num_exts, float key) {
-    int num_exts_at_key = extent_stack->get_length_at_key(key);
-    while (num_exts_at_key < num_exts) {
-      object_lst objs = this->obj_manager->create_new_object();
-      this->add_objs(objs);
-      auto temp = std::set<obj_ptr>();
-      this->pack_objects(extent_stack, temp);
-      num_exts_at_key = extent_stack->get_length_at_key(key);
-    }
+    fill_exts_at_key(extent_stack, num_exts, key, 0);
   }
 
   /*
@@ -228,24 +363,34 @@ public:
     this->pack_objects(extent_stack, temp);
   }
 
+  /*
+   * Whether generate_stripes would not add anything to the extent stack.
+   * Has to be overridden along with generate_stripes.
+   */
+  virtual bool idle() {
+    return obj_pool->empty() && this->num_objs_in_pool <= 0;
+  }
+
   /*
    * Creates objects to fill the provided amount of space.
    */
   virtual void generate_objs(double space) {
     while (space > 0) {
-      object_lst objs = this->obj_manager->create_new_object(1);
-      space -= objs[0].second;
+      object_lst objs =
+          this->obj_manager->create_new_object(num_objs_for_space(space));
+      for (auto &r : objs)
+        space -= r.second;
       this->add_objs(objs);
     }
   }
 
   virtual void
   add_obj_to_current_ext_at_key(shared_ptr<AbstractExtentStack> extent_stack,
-                                obj_ptr obj, float obj_rem_size, float key) {
-    float temp = 0;
-    if (this->current_exts->find(key) == this->current_exts->end())
-      this->current_exts->emplace(key, this->ext_manager->create_extent());
-    ext_ptr current_ext = (*this->current_exts)[key];
+                                obj_ptr obj, capacity_t obj_rem_size, float key) {
+    capacity_t temp = 0;
+    // References into an unordered_map stay valid, so keep the slot of the
+    // current extent rather than looking the key up for every shard
+    ext_ptr &current_ext = this->current_ext_at_key(key);
 
     while (obj_rem_size > 0) {
       temp = current_ext->add_object(obj, obj_rem_size);
@@ -255,10 +400,8 @@ public:
       if (obj_rem_size > 0 ||
           (obj_rem_size == 0 && current_ext->free_space <= 0)) {
         this->update_extent_type(current_ext);
-        current_ext->type = this->get_extent_type(current_ext);
-        extent_stack->add_extent(key, (*this->current_exts)[key]);
+        extent_stack->add_extent(key, current_ext);
         current_ext = this->ext_manager->create_extent();
-        (*this->current_exts)[key] = current_ext;
       }
     }
   }
@@ -279,6 +422,7 @@ public:
 
   void pack_objects(shared_ptr<AbstractExtentStack> extent_stack, std::set<obj_ptr>& objs,
                     float key = 0) override {
+    PROFILE_PHASE(Phase::PackObjects);
     while (obj_pool->size() > 0) {
       obj_record obj = obj_pool->back();
       obj_pool->pop_back();
@@ -286,12 +430,22 @@ public:
                                           obj.second, key);
     }
   };
-  virtual void
-  gc_extent(ext_ptr ext, shared_ptr<AbstractExtentStack> extent_stack,
-            std::set<obj_ptr>& objs) {
+  /*
+   * Repacks the valid objects of a collected extent, given as records of
+   * the object and its size in the extent.
+   */
+  virtual void gc_objects(const object_lst &records,
+                          shared_ptr<AbstractExtentStack> extent_stack,
+                          std::set<obj_ptr> &objs) {
     std::cerr << "simple object packer virutla gc for easy calling. "
               << "shouldnt be triggered!";
   }
+
+  void gc_extent(const ext_ptr &ext,
+                 shared_ptr<AbstractExtentStack> extent_stack,
+                 std::set<obj_ptr> &objs) {
+    gc_objects(ext->get_obj_records(), extent_stack, objs);
+  }
 };
 
 class SimpleGCObjectPacker : public SimpleObjectPacker {
@@ -311,19 +465,17 @@ public:
    * Repacks objects from given extent
    */
   virtual void
-  gc_extent(ext_ptr ext, shared_ptr<AbstractExtentStack> extent_stack,
-            std::set<obj_ptr>& objs) override {
-    // std::cout << "gc_extent simple GC" << std::endl;
-    for (auto obj_kv : ext->objects) {
-      auto obj = obj_kv.first;
-      float size = ext->get_obj_size(obj);
-      this->add_obj(obj_record(obj, size));
-    }
+  gc_objects(const object_lst &records,
+             shared_ptr<AbstractExtentStack> extent_stack,
+             std::set<obj_ptr> &objs) override {
+    for (auto &record : records)
+      this->add_obj(record);
     this->pack_objects(extent_stack, objs);
   }
 
   void pack_objects(shared_ptr<AbstractExtentStack> extent_stack,
                     std::set<obj_ptr>& objs, float key = 0) override {
+    PROFILE_PHASE(Phase::PackObjects);
     while (obj_pool->size() > 0) {
       obj_record obj = obj_pool->back();
       obj_pool->pop_back();
@@ -345,10 +497,11 @@ public:
 
    void pack_objects(shared_ptr<AbstractExtentStack> extent_stack,
                     std::set<obj_ptr>& objs, float key = 0) override {
+    PROFILE_PHASE(Phase::PackObjects);
     vector<obj_ptr> objs_lst = {};
     for (auto &record : *obj_pool) {
-      float rem_size = record.second;
-      for (int i = 0; i < rem_size / 4; i++)
+      capacity_t rem_size = record.second;
+      for (int i = 0; i < (rem_size + 3) / 4; i++)
         objs_lst.emplace_back(record.first);
     }
     object_lst empty_lst;
@@ -372,10 +525,11 @@ public:
 
   void pack_objects(shared_ptr<AbstractExtentStack> extent_stack,
                     std::set<obj_ptr>& objs, float key = 0) override {
+    PROFILE_PHASE(Phase::PackObjects);
     std::vector<obj_ptr> objs_lst = {};
     for (auto &it : *obj_pool) {
-      float rem_size = it.second;
-      for (int i = 0; i < rem_size / 4; i++)
+      capacity_t rem_size = it.second;
+      for (int i = 0; i < (rem_size + 3) / 4; i++)
         objs_lst.emplace_back(it.first);
     }
     object_lst empty_lst;
@@ -411,7 +565,8 @@ public:
       curr_pool_size += record.second;
 
     while (curr_pool_size < ave_pool_size) {
-      object_lst objs = this->obj_manager->create_new_object();
+      object_lst objs = this->obj_manager->create_new_object(
+          num_objs_for_space(ave_pool_size - curr_pool_size));
       this->add_objs(objs);
       for (auto &record : objs)
         curr_pool_size += record.second;
@@ -421,8 +576,8 @@ public:
     if (new_objs_added) {
       object_lst* obj_lst =new object_lst();
       for (auto &record : *obj_pool) {
-        float rem_size = record.second;
-        for (int i = 0; i < rem_size / 4 + round((fmod(rem_size, 4)) / 4.0); i++)
+        capacity_t rem_size = record.second;
+        for (int i = 0; i < rem_size / 4.0 + round((fmod(rem_size, 4)) / 4.0); i++)
           obj_lst->emplace_back(std::make_pair(record.first, 4));
         obj_pool->clear(); // TODO: Might not be necessary?
         this->obj_pool.reset(obj_lst);
@@ -434,9 +589,13 @@ public:
     this->pack_objects(extent_stack, temp);
   }
 
+  // Always tops the pool up to its average size
+  bool idle() override { return false; }
+
   void pack_objects(shared_ptr<AbstractExtentStack> extent_stack, std::set<obj_ptr>& objs,
                     float key = 0) override {
-    for (auto record : *obj_pool)
+    PROFILE_PHASE(Phase::PackObjects);
+    for (auto &record : *obj_pool)
       this->add_obj_to_current_ext_at_key(extent_stack, record.first,
                                           record.second, key);
     obj_pool->clear();
@@ -456,7 +615,8 @@ public:
       pool_size += record.second;
 
     while (pool_size < ave_pool_size) {
-      object_lst objs = this->obj_manager->create_new_object();
+      object_lst objs = this->obj_manager->create_new_object(
+          num_objs_for_space(ave_pool_size - pool_size));
       this->add_objs(objs);
       for (auto &record : objs)
         pool_size += record.second;
@@ -465,7 +625,7 @@ public:
     // Mix valid and fresh objects
 object_lst * obj_lst = new object_lst();
     for (auto &record : *obj_pool) {
-      float rem_size = record.second;
+      capacity_t rem_size = record.second;
       for (int i = 0; i < rem_size / 4.0 + round(fmod(rem_size, 4) / 4.0); i++)
         obj_lst->emplace_back(std::make_pair(record.first, 4));
     }
@@ -505,12 +665,13 @@ public:
   /*
    * Repacks objects from given extent
    */
-  void gc_extent(ext_ptr ext, shared_ptr<AbstractExtentStack> extent_stack,
-                 std::set<obj_ptr>& objs) override {
+  void gc_objects(const object_lst &records,
+                  shared_ptr<AbstractExtentStack> extent_stack,
+                  std::set<obj_ptr> &objs) override {
     // TODO: We are adding this object without the notion of the extent
     // 		 shard. Would this cause any problems?
-    for (auto obj : ext->objects)
-      this->add_obj(obj_record(obj.first, ext->get_obj_size(obj.first)));
+    for (auto &record : records)
+      this->add_obj(record);
   }
 };
 
@@ -539,13 +700,12 @@ public:
 
   void pack_objects(shared_ptr<AbstractExtentStack> extent_stack, std::set<obj_ptr>& objs,
                     float key = 0) override {
+    PROFILE_PHASE(Phase::PackObjects);
     shuffle(obj_pool->begin(), obj_pool->end(), generator);
-    while(!obj_pool->empty()){
-      auto obj = obj_pool->front();
+    for (auto &obj : *obj_pool)
       this->add_obj_to_current_ext_at_key(extent_stack, obj.first, obj.second,
                                           key);
-      obj_pool->erase(obj_pool->begin());
-    }
+    obj_pool->clear();
   }
  
   void generate_exts_at_key(shared_ptr<AbstractExtentStack> extent_stack,
@@ -556,13 +716,14 @@ public:
     // std::cout << "obj_pool_size before generate_exts_at_key" << obj_pool->size() << std::endl;
     // std::cout << "num_exts_at_key" << num_exts_at_key << " " << key << std::endl;
     // std::cout << "num_exts" << num_exts << std::endl;
-    while (num_exts_at_key < num_exts) {
-      auto obj = obj_pool->front();
+    size_t next = 0;
+    while (num_exts_at_key < num_exts && next < obj_pool->size()) {
+      auto &obj = (*obj_pool)[next++];
       this->add_obj_to_current_ext_at_key(extent_stack, obj.first, obj.second,
                                           key);
-      obj_pool->erase(obj_pool->begin());
       num_exts_at_key = extent_stack->get_length_at_key(key);
     }
+    this->pop_front_objs(next);
   }
 };
 
@@ -579,21 +740,14 @@ public:
     }
   }
 
-  void generate_objs(double space) override {
-    while (space > 0) {
-      auto objs = this->obj_manager->create_new_object(1);
-      space -= objs[0].second;
-      this->add_objs(objs);
-    }
-  }
-
   /*
    * Repacks objects from given extent.
    */
-    void gc_extent(ext_ptr ext, shared_ptr<AbstractExtentStack> extent_stack,
-            std::set<obj_ptr>& objs) override {
-    for (auto obj : ext->objects)
-      this->add_obj(obj_record(obj.first, ext->get_obj_size(obj.first)));
+  void gc_objects(const object_lst &records,
+                  shared_ptr<AbstractExtentStack> extent_stack,
+                  std::set<obj_ptr> &objs) override {
+    for (auto &record : records)
+      this->add_obj(record);
   }
 };
 
@@ -618,13 +772,12 @@ public:
 
   void pack_objects(shared_ptr<AbstractExtentStack> extent_stack, std::set<obj_ptr>& objs,
                     float key = 0) override {
+    PROFILE_PHASE(Phase::PackObjects);
     std::uniform_real_distribution<float> unif(0, 1);
     float p;
 
-    while (obj_pool->size() > 0) {
+    for (auto &obj : *obj_pool) {
       float key = immortal_key;
-      auto obj = obj_pool->front();
-      obj_pool->erase(obj_pool->begin());
       p = unif(generator);
 
       if ((obj.first->life <= 365 && p <= this->percent_correct) ||
@@ -634,6 +787,7 @@ public:
       this->add_obj_to_current_ext_at_key(extent_stack, obj.first, obj.second,
                                           key);
     }
+    obj_pool->clear();
   }
 };
 
@@ -657,14 +811,13 @@ public:
 
   void pack_objects(shared_ptr<AbstractExtentStack> extent_stack, std::set<obj_ptr>& objs,
                     float key = 0) override {
+    PROFILE_PHASE(Phase::PackObjects);
    
     std::uniform_real_distribution<float> unif(0, 1);
     float p;
 
-    while (obj_pool->size() > 0) {
+    for (auto &obj : *obj_pool) {
       float key = immortal_key;
-      auto obj = obj_pool->front();
-      obj_pool->erase(obj_pool->begin());
       p = unif(generator);
 
       if ((obj.first->life <= 365 && p <= this->percent_correct) ||
@@ -674,6 +827,7 @@ public:
       this->add_obj_to_current_ext_at_key(extent_stack, obj.first, obj.second,
                                           key);
     }
+    obj_pool->clear();
   }
 };
 
@@ -687,7 +841,7 @@ public:
     ind = ind >= 0 ? ind: 0;
   }
 
-  int get_smaller_obj_index(int ext_size, float free_space) {
+  int get_smaller_obj_index(capacity_t ext_size, capacity_t free_space) {
     int ind;
     if (ext_size == free_space) {
       ind = -1;
@@ -698,7 +852,8 @@ public:
       //		 bisect_right function call
       auto obj_it =
           std::upper_bound(obj_pool->begin(), obj_pool->end(), free_space);
-      while(obj_it != obj_pool->begin() && obj_it->second > free_space)
+      while(obj_it != obj_pool->begin() &&
+            (obj_it == obj_pool->end() || obj_it->second > free_space))
       {
         obj_it--;
       }
@@ -709,7 +864,7 @@ public:
     return ind;
   }
 
-  int get_larger_obj_index(int ext_size, float free_space) {
+  int get_larger_obj_index(capacity_t ext_size, capacity_t free_space) {
     int ind;
     if (ext_size == free_space) {
       ind = -1;
@@ -722,7 +877,7 @@ public:
     return ind;
   }
 
-  void insert_obj_back_into_pool(obj_ptr obj, float obj_size) {
+  void insert_obj_back_into_pool(obj_ptr obj, capacity_t obj_size) {
     if (obj_pool->size() == 0) {
       obj_pool->emplace_back(std::make_pair(obj, obj_size));
       return;
@@ -748,9 +903,9 @@ class SizeBasedObjectPackerSmallerWholeObj : public SizeBasedObjectPacker {
 public:
   using SizeBasedObjectPacker::SizeBasedObjectPacker;
 
-  std::pair<float, ext_ptr >
+  std::pair<capacity_t, ext_ptr >
   add_obj_to_current_ext(shared_ptr<AbstractExtentStack> extent_stack,
-                         obj_ptr obj, float obj_rem_size, float key) {
+                         obj_ptr obj, capacity_t obj_rem_size, float key) {
     auto current_ext = (*this->current_exts)[key];
     auto tmp = current_ext->add_object(obj, obj_rem_size);
 
@@ -759,8 +914,6 @@ public:
     if (obj_rem_size > 0 || (obj_rem_size == 0 && current_ext->free_space == 0)) {
       (*this->current_exts)[key] = this->ext_manager->create_extent();
       this->update_extent_type(current_ext);
-
-      current_ext->type = this->get_extent_type(current_ext);
       return std::make_pair(obj_rem_size, current_ext);
     }
     return std::make_pair(obj_rem_size, nullptr);
@@ -768,13 +921,13 @@ public:
 
   stack_val
   add_obj_to_current_ext_at_key(shared_ptr<AbstractExtentStack> extent_stack,
-                                obj_ptr obj, float rem_size, float key,
+                                obj_ptr obj, capacity_t rem_size, float key,
                                 ext_stack& obj_ids_to_exts) {
     stack_val exts = stack_val();
     if (this->current_exts->find(key) == this->current_exts->end())
       (*this->current_exts)[key] = this->ext_manager->create_extent();
     auto current_ext = (*this->current_exts)[key];
-    float obj_rem_size = rem_size;
+    capacity_t obj_rem_size = rem_size;
     while (obj_rem_size >= current_ext->ext_size) {
       auto rem_size_and_ext =
           this->add_obj_to_current_ext(extent_stack, obj, obj_rem_size, key);
@@ -802,7 +955,7 @@ public:
     obj_rem_size = rem_size_and_ext.first;
     if (current_ext != nullptr) {
       exts.emplace_back(current_ext);
-      int obj_id = current_ext->objects.begin()->first->id;
+      int obj_id = current_ext->min_obj_id();
       if (obj_ids_to_exts.find(obj_id) != obj_ids_to_exts.end())
         obj_ids_to_exts[obj_id].insert(obj_ids_to_exts[obj_id].end(),
                                        exts.begin(), exts.end());
@@ -817,16 +970,14 @@ public:
 
   void pack_objects(shared_ptr<AbstractExtentStack> extent_stack, std::set<obj_ptr>& objs,
                     float key = 0) override {
+    PROFILE_PHASE(Phase::PackObjects);
     
     stack_val exts = stack_val();
     ext_stack obj_ids_to_exts = ext_stack();
 
     // If there are any object in the current extent, place them
     // back in the pool.
-    if (this->current_exts->find(key) != this->current_exts->end()) {
-      auto objs = (*this->current_exts)[key]->delete_ext();
-      this->add_objs(objs);
-    }
+    this->return_current_ext_objs(key);
     std::sort(obj_pool->begin(), obj_pool->end(), obj_record_desc_rem_size_extent);
 
     while (obj_pool->size() > 0) {
@@ -834,7 +985,7 @@ public:
         (*this->current_exts)[key] = this->ext_manager->create_extent();
 
       auto current_ext = (*this->current_exts)[key];
-      float free_space = current_ext->free_space;
+      capacity_t free_space = current_ext->free_space;
       int ind = this->get_smaller_obj_index(current_ext->ext_size, free_space);
       if(ind == -1)
       {
@@ -847,7 +998,7 @@ public:
           extent_stack, obj.first, obj.second, key, obj_ids_to_exts);
     }
 
-    for (auto mapping : obj_ids_to_exts)
+    for (auto &mapping : obj_ids_to_exts)
       extent_stack->add_extent(mapping.second);
   }
 };
@@ -861,16 +1012,14 @@ public:
 
   void pack_objects(shared_ptr<AbstractExtentStack> extent_stack, std::set<obj_ptr>& objs,
                     float key = 0) override {
+    PROFILE_PHASE(Phase::PackObjects);
     auto abs_ext_stack = extent_stack;
     stack_val exts = stack_val();
     ext_stack obj_ids_to_exts = ext_stack();
 
     // If there are any object in the current extent, place them
     // back in the pool.
-    if (current_exts->find(key) != current_exts->end()) {
-      auto objs = (*current_exts)[key]->delete_ext();
-      add_objs(objs);
-    }
+    this->return_current_ext_objs(key);
 
     // Lambda function used to sort the objects in the obj_pool->
     // It will try to sort by the  their size. If they are equivalent,
@@ -885,7 +1034,7 @@ public:
         (*current_exts)[key] = ext_manager->create_extent();
 
       auto current_ext = (*current_exts)[key];
-      float free_space = current_ext->free_space;
+      capacity_t free_space = current_ext->free_space;
       int ind = this->get_smaller_obj_index(current_ext->ext_size, free_space);
       if(ind == -1)
       {
@@ -898,7 +1047,7 @@ public:
                                     obj_ids_to_exts);
     }
 
-    for (auto mapping : obj_ids_to_exts)
+    for (auto &mapping : obj_ids_to_exts)
       abs_ext_stack->add_extent(mapping.second);
   }
   void generate_stripes(shared_ptr<AbstractExtentStack> extent_stack,
@@ -906,13 +1055,11 @@ public:
     return;
   }
   void
-  gc_extent(ext_ptr ext, shared_ptr<AbstractExtentStack> extent_stack,
-            std::set<obj_ptr>& objs) override {
-    for (auto obj_kv : ext->objects) {
-      auto obj = obj_kv.first;
-      float size = ext->get_obj_size(obj);
-      this->add_obj(obj_record(obj, size));
-    }
+  gc_objects(const object_lst &records,
+             shared_ptr<AbstractExtentStack> extent_stack,
+             std::set<obj_ptr> &objs) override {
+    for (auto &record : records)
+      this->add_obj(record);
     this->pack_objects(extent_stack, objs);
   }
 };
@@ -923,6 +1070,7 @@ public:
   using SimpleObjectPacker::SimpleObjectPacker;
   void pack_objects(shared_ptr<AbstractExtentStack> extent_stack, std::set<obj_ptr>& objs,
                     float key = 0) override {
+    PROFILE_PHASE(Phase::PackObjects);
     std::sort(obj_pool->begin(), obj_pool->end(), obj_record_asc_rem_size);
     while (!obj_pool->empty()) {
       obj_record record = obj_pool->back();
@@ -937,6 +1085,7 @@ public:
   using SimpleGCObjectPacker::SimpleGCObjectPacker;
   void pack_objects(shared_ptr<AbstractExtentStack> extent_stack, std::set<obj_ptr>& objs,
                     float key = 0) override {
+    PROFILE_PHASE(Phase::PackObjects);
     std::sort(obj_pool->begin(), obj_pool->end(), obj_record_asc_rem_size);
     while (!obj_pool->empty()) {
       obj_record record = obj_pool->back();
@@ -955,10 +1104,8 @@ public:
 
   void pack_objects(shared_ptr<AbstractExtentStack> extent_stack, std::set<obj_ptr>& objs,
                     float key = 0) override {
-    if (current_exts->find(key) != current_exts->end()) {
-      object_lst objs = (*current_exts)[key]->delete_ext();
-      add_objs(objs);
-    }
+    PROFILE_PHASE(Phase::PackObjects);
+    this->return_current_ext_objs(key);
     std::sort(obj_pool->begin(), obj_pool->end(), obj_record_desc_rem_size_extent);
     ext_stack * obj_ids_to_exts = new ext_stack();
     while (!obj_pool->empty()) {
@@ -966,7 +1113,7 @@ public:
       { (*current_exts)[key] = ext_manager->create_extent(); }
 
       ext_ptr current_ext = (*current_exts)[key];
-      double free_space = current_ext->free_space;
+      capacity_t free_space = current_ext->free_space;
       int ind = get_smaller_obj_index(current_ext->ext_size, free_space);
       if(ind == -1)
       {
@@ -976,11 +1123,11 @@ public:
       // std::cout << "ind SizeBasedObjectPackerSmallerWholeObj " << ind << std::endl;
       auto r = (*obj_pool)[ind];
       obj_pool->erase(obj_pool->begin() + ind);
-      float obj_rem_size = r.second;
+      capacity_t obj_rem_size = r.second;
       // std::cout <<"smaller ind" << ind << "rem_size" << obj_rem_size <<std::endl;
       if (obj_rem_size < current_ext->ext_size &&
           obj_rem_size > (1 - threshold / 100.0) * current_ext->ext_size) {
-        float obj_original_size = obj_rem_size;
+        capacity_t obj_original_size = obj_rem_size;
         obj_rem_size = (1 - threshold / 100.0) * current_ext->ext_size;
         // std::cout <<"inserting back" << r.first->id << "rem_size" << obj_original_size - obj_rem_size <<std::endl;
         insert_obj_back_into_pool(r.first, obj_original_size - obj_rem_size);
@@ -989,7 +1136,7 @@ public:
             extent_stack, r.first, obj_rem_size, key, *obj_ids_to_exts);
     }
     for (auto &kv : *obj_ids_to_exts) {
-      for (ext_ptr ext : kv.second) {
+      for (auto &ext : kv.second) {
         extent_stack->add_extent(key, ext);
       }
     }
@@ -1003,10 +1150,8 @@ public:
       SizeBasedGCObjectPackerSmallerWholeObj;
   void pack_objects(shared_ptr<AbstractExtentStack> extent_stack, std::set<obj_ptr>& objs,
                     float key = 0) override {
-    if (current_exts->find(key) != current_exts->end()) {
-      object_lst objs = (*current_exts)[key]->delete_ext();
-      add_objs(objs);
-    }
+    PROFILE_PHASE(Phase::PackObjects);
+    this->return_current_ext_objs(key);
     std::sort(obj_pool->begin(), obj_pool->end(), obj_record_desc_rem_size_extent);
     ext_stack * obj_ids_to_exts = new ext_stack();
     while (!obj_pool->empty()) {
@@ -1014,7 +1159,7 @@ public:
       { (*current_exts)[key] = ext_manager->create_extent(); }
 
       ext_ptr current_ext = (*current_exts)[key];
-      double free_space = current_ext->free_space;
+      capacity_t free_space = current_ext->free_space;
       int ind = get_smaller_obj_index(current_ext->ext_size, free_space);
       if(ind == -1)
       {
@@ -1024,11 +1169,11 @@ public:
       // std::cout << "ind SizeBasedObjectPackerSmallerWholeObj " << ind << std::endl;
       auto r = (*obj_pool)[ind];
       obj_pool->erase(obj_pool->begin() + ind);
-      float obj_rem_size = r.second;
+      capacity_t obj_rem_size = r.second;
       // std::cout <<"smaller ind" << ind << "rem_size" << obj_rem_size <<std::endl;
       if (obj_rem_size < current_ext->ext_size &&
           obj_rem_size > (1 - threshold / 100.0) * current_ext->ext_size) {
-        float obj_original_size = obj_rem_size;
+        capacity_t obj_original_size = obj_rem_size;
         obj_rem_size = (1 - threshold / 100.0) * current_ext->ext_size;
         // std::cout <<"inserting back" << r.first->id << "rem_size" << obj_original_size - obj_rem_size <<std::endl;
         insert_obj_back_into_pool(r.first, obj_original_size - obj_rem_size);
@@ -1037,7 +1182,7 @@ public:
             extent_stack, r.first, obj_rem_size, key, *obj_ids_to_exts);
     }
     for (auto &kv : *obj_ids_to_exts) {
-      for (ext_ptr ext : kv.second) {
+      for (auto &ext : kv.second) {
         extent_stack->add_extent(0, ext);
       }
     }
@@ -1052,10 +1197,8 @@ public:
 
   void pack_objects(shared_ptr<AbstractExtentStack> extent_stack, std::set<obj_ptr>& objs,
                     float key = 0) override {
-    if (current_exts->find(key) != current_exts->end()) {
-      object_lst objs = (*current_exts)[key]->delete_ext();
-      add_objs(objs);
-    }
+    PROFILE_PHASE(Phase::PackObjects);
+    this->return_current_ext_objs(key);
     std::sort(obj_pool->begin(), obj_pool->end(), obj_record_desc_rem_size_extent);
     ext_stack obj_ids_to_exts = ext_stack();
     while (obj_pool->size() > 0) {
@@ -1063,7 +1206,7 @@ public:
           (*current_exts)[key] = ext_manager ->create_extent();
 
         ext_ptr current_ext = (*current_exts)[key];
-        float free_space = current_ext->free_space;
+        capacity_t free_space = current_ext->free_space;
         int ind = get_smaller_obj_index(current_ext->ext_size, free_space);
         if(ind == -1)
         {
@@ -1075,7 +1218,7 @@ public:
         }
         auto r = (*obj_pool)[ind];
         obj_pool->erase(obj_pool->begin() + ind);
-        float obj_rem_size = r.second;
+        capacity_t obj_rem_size = r.second;
         stack_val exts = add_obj_to_current_ext_at_key(extent_stack, r.first, obj_rem_size, key, obj_ids_to_exts);
     }
     while (obj_pool->size() > 0) {
@@ -1100,14 +1243,11 @@ public:
   }
 
   void
-  gc_extent(ext_ptr ext, shared_ptr<AbstractExtentStack> extent_stack,
-            std::set<obj_ptr>& objs) override {
-    // std::cout << "gc_extent simple GC" << std::endl;
-    for (auto obj_kv : ext->objects) {
-      auto obj = obj_kv.first;
-      float size = ext->get_obj_size(obj);
-      this->add_obj(obj_record(obj, size));
-    }
+  gc_objects(const object_lst &records,
+             shared_ptr<AbstractExtentStack> extent_stack,
+             std::set<obj_ptr> &objs) override {
+    for (auto &record : records)
+      this->add_obj(record);
     this->pack_objects(extent_stack, objs);
   }
 
@@ -1120,10 +1260,8 @@ public:
       SizeBasedObjectPackerSmallerWholeObj;
   void pack_objects(shared_ptr<AbstractExtentStack> extent_stack, std::set<obj_ptr>& objs,
                     float key = 0) override {
-    if (current_exts->find(key) != current_exts->end()) {
-      object_lst objs = (*current_exts)[key]->delete_ext();
-      add_objs(objs);
-    }
+    PROFILE_PHASE(Phase::PackObjects);
+    this->return_current_ext_objs(key);
     std::sort(obj_pool->begin(), obj_pool->end(), obj_record_desc_rem_size_extent);
     ext_stack obj_ids_to_exts;
     while (obj_pool->size() > 0) {
@@ -1131,7 +1269,7 @@ public:
           (*current_exts)[key] = ext_manager->create_extent(); 
 
         ext_ptr current_ext = (*current_exts)[key];
-        float free_space = current_ext->free_space;
+        capacity_t free_space = current_ext->free_space;
         int ind = get_smaller_obj_index(current_ext->ext_size, free_space);
         if(ind == -1)
         {
@@ -1139,16 +1277,16 @@ public:
         }
         auto r = (*obj_pool)[ind];
         obj_pool->erase(obj_pool->begin() + ind);
-        float obj_rem_size = r.second;
+        capacity_t obj_rem_size = r.second;
         if (obj_rem_size < current_ext->ext_size &&
             obj_rem_size > (1 - threshold / 100.0) * current_ext->ext_size) {
-          float obj_original_size = r.second;
+          capacity_t obj_original_size = r.second;
           obj_rem_size = (0.99 - threshold / 100.0) * current_ext->ext_size;
           insert_obj_back_into_pool(r.first, obj_original_size - obj_rem_size);
           add_obj_to_current_ext_at_key(extent_stack, r.first, obj_rem_size,
                                         key, obj_ids_to_exts);
           if (obj_pool->size() > 0) {
-            float free_space = current_ext->free_space;
+            capacity_t free_space = current_ext->free_space;
 
             int ind = get_larger_obj_index(current_ext->ext_size, free_space);
             if(ind == -1)
@@ -1179,22 +1317,17 @@ public:
   }
 
   void
-  gc_extent(ext_ptr ext, shared_ptr<AbstractExtentStack> extent_stack,
-            std::set<obj_ptr>& objs) override {
-    // std::cout << "gc_extent simple GC" << std::endl;
-    for (auto obj_kv : ext->objects) {
-      auto obj = obj_kv.first;
-      float size = ext->get_obj_size(obj);
-      this->add_obj(obj_record(obj, size));
-    }
+  gc_objects(const object_lst &records,
+             shared_ptr<AbstractExtentStack> extent_stack,
+             std::set<obj_ptr> &objs) override {
+    for (auto &record : records)
+      this->add_obj(record);
     this->pack_objects(extent_stack, objs);
   }
   void pack_objects(shared_ptr<AbstractExtentStack> extent_stack, std::set<obj_ptr>& objs,
                     float key = 0) override {
-    if (current_exts->find(key) != current_exts->end()) {
-      object_lst objs = (*current_exts)[key]->delete_ext();
-      add_objs(objs);
-    }
+    PROFILE_PHASE(Phase::PackObjects);
+    this->return_current_ext_objs(key);
     std::sort(obj_pool->begin(), obj_pool->end(), obj_record_desc_rem_size_extent);
     ext_stack obj_ids_to_exts;
     while (obj_pool->size() > 0) {
@@ -1202,7 +1335,7 @@ public:
           (*current_exts)[key] = ext_manager->create_extent();
 
         ext_ptr current_ext = (*current_exts)[key];
-        float free_space = current_ext->free_space;
+        capacity_t free_space = current_ext->free_space;
         int ind = get_smaller_obj_index(current_ext->ext_size, free_space);
         if(ind == -1)
         {
@@ -1210,16 +1343,16 @@ public:
         }
         auto r = (*obj_pool)[ind];
         obj_pool->erase(obj_pool->begin() + ind);
-        float obj_rem_size = r.second;
+        capacity_t obj_rem_size = r.second;
         if (obj_rem_size < current_ext->ext_size &&
             obj_rem_size > (1 - threshold / 100.0) * current_ext->ext_size) {
-          float obj_original_size = r.second;
+          capacity_t obj_original_size = r.second;
           obj_rem_size = (0.99 - threshold / 100.0) * current_ext->ext_size;
           insert_obj_back_into_pool(r.first, obj_original_size - obj_rem_size);
           add_obj_to_current_ext_at_key(extent_stack, r.first, obj_rem_size,
                                         key, obj_ids_to_exts);
           if (obj_pool->size() > 0) {
-            float free_space = current_ext->free_space;
+            capacity_t free_space = current_ext->free_space;
 
             int ind = get_larger_obj_index(current_ext->ext_size, free_space);
             if(ind == -1)
@@ -1245,9 +1378,9 @@ public:
 class SizeBasedObjectPackerLargerWholeObj : public SizeBasedObjectPacker {
 public:
   using SizeBasedObjectPacker::SizeBasedObjectPacker;
-  std::pair<float, ext_ptr >
+  std::pair<capacity_t, ext_ptr >
   add_obj_to_current_ext(shared_ptr<AbstractExtentStack> extent_stack,
-                         obj_ptr obj, float obj_rem_size, float key) {
+                         obj_ptr obj, capacity_t obj_rem_size, float key) {
     auto current_ext = (*this->current_exts)[key];
     auto tmp = current_ext->add_object(obj, obj_rem_size);
 
@@ -1256,8 +1389,6 @@ public:
     if (obj_rem_size > 0 || (obj_rem_size == 0 && current_ext->free_space == 0)) {
       (*this->current_exts)[key] = this->ext_manager->create_extent();
       this->update_extent_type(current_ext);
-
-      current_ext->type = this->get_extent_type(current_ext);
       return std::make_pair(obj_rem_size, current_ext);
     }
     return std::make_pair(obj_rem_size, nullptr);
@@ -1265,13 +1396,13 @@ public:
 
   stack_val
   add_obj_to_current_ext_at_key(shared_ptr<AbstractExtentStack> extent_stack,
-                                obj_ptr obj, float rem_size, float key,
+                                obj_ptr obj, capacity_t rem_size, float key,
                                 ext_stack& obj_ids_to_exts) {
     stack_val exts = stack_val();
     if (this->current_exts->find(key) == this->current_exts->end())
       (*this->current_exts)[key] = this->ext_manager->create_extent();
     auto current_ext = (*this->current_exts)[key];
-    float obj_rem_size = rem_size;
+    capacity_t obj_rem_size = rem_size;
     while (obj_rem_size >= current_ext->ext_size) {
       auto rem_size_and_ext =
           this->add_obj_to_current_ext(extent_stack, obj, obj_rem_size, key);
@@ -1299,7 +1430,7 @@ public:
     obj_rem_size = rem_size_and_ext.first;
     if (current_ext != nullptr) {
       exts.emplace_back(current_ext);
-      int obj_id = current_ext->objects.begin()->first->id;
+      int obj_id = current_ext->min_obj_id();
       if (obj_ids_to_exts.find(obj_id) != obj_ids_to_exts.end())
         obj_ids_to_exts[obj_id].insert(obj_ids_to_exts[obj_id].end(),
                                        exts.begin(), exts.end());
@@ -1314,16 +1445,14 @@ public:
 
   void pack_objects(shared_ptr<AbstractExtentStack> extent_stack, std::set<obj_ptr>& objs,
                     float key = 0) override {
+    PROFILE_PHASE(Phase::PackObjects);
     
     stack_val exts = stack_val();
     ext_stack obj_ids_to_exts = ext_stack();
 
     // If there are any object in the current extent, place them
     // back in the pool.
-    if (this->current_exts->find(key) != this->current_exts->end()) {
-      auto objs = (*this->current_exts)[key]->delete_ext();
-      this->add_objs(objs);
-    }
+    this->return_current_ext_objs(key);
     std::sort(obj_pool->begin(), obj_pool->end(), obj_record_desc_rem_size_extent);
 
     while (obj_pool->size() > 0) {
@@ -1331,7 +1460,7 @@ public:
         (*this->current_exts)[key] = this->ext_manager->create_extent();
 
       auto current_ext = (*this->current_exts)[key];
-      float free_space = current_ext->free_space;
+      capacity_t free_space = current_ext->free_space;
       int ind = this->get_larger_obj_index(current_ext->ext_size, free_space);
       if(ind == -1)
       {
@@ -1339,10 +1468,10 @@ public:
       }
       auto r = (*obj_pool)[ind];
       obj_pool->erase(obj_pool->begin() + ind);
-      float obj_rem_size = r.second;
+      capacity_t obj_rem_size = r.second;
       if (obj_rem_size < current_ext->ext_size &&
             obj_rem_size > (1 - threshold / 100.0) * current_ext->ext_size) {
-        float obj_original_size = r.second;
+        capacity_t obj_original_size = r.second;
         obj_rem_size = (1 - threshold / 100.0) * current_ext->ext_size;
         insert_obj_back_into_pool(r.first, obj_original_size - obj_rem_size);
       }
@@ -1350,7 +1479,7 @@ public:
           extent_stack, r.first, obj_rem_size, key, obj_ids_to_exts);
     }
 
-    for (auto mapping : obj_ids_to_exts)
+    for (auto &mapping : obj_ids_to_exts)
       extent_stack->add_extent(mapping.second);
   }
 };
@@ -1363,16 +1492,14 @@ public:
       SizeBasedObjectPackerLargerWholeObj;
   void pack_objects(shared_ptr<AbstractExtentStack> extent_stack, std::set<obj_ptr>& objs,
                     float key = 0) override {
+    PROFILE_PHASE(Phase::PackObjects);
     
     stack_val exts = stack_val();
     ext_stack obj_ids_to_exts = ext_stack();
 
     // If there are any object in the current extent, place them
     // back in the pool.
-    if (this->current_exts->find(key) != this->current_exts->end()) {
-      auto objs = (*this->current_exts)[key]->delete_ext();
-      this->add_objs(objs);
-    }
+    this->return_current_ext_objs(key);
     std::sort(obj_pool->begin(), obj_pool->end(), obj_record_desc_rem_size_extent);
 
     while (obj_pool->size() > 0) {
@@ -1380,7 +1507,7 @@ public:
         (*this->current_exts)[key] = this->ext_manager->create_extent();
 
       auto current_ext = (*this->current_exts)[key];
-      float free_space = current_ext->free_space;
+      capacity_t free_space = current_ext->free_space;
       int ind = this->get_larger_obj_index(current_ext->ext_size, free_space);
       if(ind == -1)
       {
@@ -1388,10 +1515,10 @@ public:
       }
       auto r = (*obj_pool)[ind];
       obj_pool->erase(obj_pool->begin() + ind);
-      float obj_rem_size = r.second;
+      capacity_t obj_rem_size = r.second;
       if (obj_rem_size < current_ext->ext_size &&
             obj_rem_size > (1 - threshold / 100.0) * current_ext->ext_size) {
-        float obj_original_size = r.second;
+        capacity_t obj_original_size = r.second;
         obj_rem_size = (1 - threshold / 100.0) * current_ext->ext_size;
         insert_obj_back_into_pool(r.first, obj_original_size - obj_rem_size);
       }
@@ -1399,18 +1526,16 @@ public:
           extent_stack, r.first, obj_rem_size, key, obj_ids_to_exts);
     }
 
-    for (auto mapping : obj_ids_to_exts)
+    for (auto &mapping : obj_ids_to_exts)
       extent_stack->add_extent(mapping.second);
   }
 
   void
-  gc_extent(ext_ptr ext, shared_ptr<AbstractExtentStack> extent_stack,
-            std::set<obj_ptr>& objs) override {
-    for (auto obj_kv : ext->objects) {
-      auto obj = obj_kv.first;
-      float size = ext->get_obj_size(obj);
-      this->add_obj(obj_record(obj, size));
-    }
+  gc_objects(const object_lst &records,
+             shared_ptr<AbstractExtentStack> extent_stack,
+             std::set<obj_ptr> &objs) override {
+    for (auto &record : records)
+      this->add_obj(record);
     this->pack_objects(extent_stack, objs);
   }
   void generate_stripes(shared_ptr<AbstractExtentStack> extent_stack,
@@ -1439,27 +1564,15 @@ public:
                            num_objs_in_pool, threshold, record_ext_types),
         obj_key_fnc(o_k_f), ext_key_fnc(e_k_f), obj_queue(obj_q){};
   
-  void add_objs(object_lst obj_lst) override {
-    for(auto o : obj_lst)
+  void add_objs(const object_lst &obj_lst) override {
+    for (auto &o : obj_lst)
     {
       add_obj(o);
     }
   }
   void generate_exts_at_key(shared_ptr<AbstractExtentStack> extent_stack,
                             int num_exts, float key) override {
-    int num_exts_at_key = extent_stack->get_length_at_key(key);
-    // std::cout << extent_stack->get_length_of_extent_stack() << std::endl;
-    while (num_exts_at_key < num_exts) {
-      object_lst objs = this->obj_manager->create_new_object();
-      for (auto r : objs) {
-        obj_queue->push(obj_pq_record(std::invoke(obj_key_fnc, r.first), r.first,
-                                     r.first->size));        
-      }
-      auto temp = std::set<obj_ptr>();
-      pack_objects(extent_stack, temp, key);
-      num_exts_at_key = extent_stack->get_length_at_key(key);
-      // std::cout << "num_exts_at_key in looop" << num_exts_at_key << "key" << key <<std::endl;
-    }
+    fill_exts_at_key(extent_stack, num_exts, key, key);
   }
 
   void add_obj(obj_record r) override {
@@ -1472,7 +1585,7 @@ public:
     if (obj_queue->size() < num_objs_in_pool) {
       object_lst objs =
           obj_manager->create_new_object(num_objs_in_pool - obj_queue->size());
-      for (obj_record r : objs) {
+      for (auto &r : objs) {
         add_obj(r);
       }
       auto temp = std::set<obj_ptr>();
@@ -1480,16 +1593,15 @@ public:
     }
   }
 
+  bool idle() override { return obj_queue->size() >= num_objs_in_pool; }
+
   void
   add_obj_to_current_ext_at_key(shared_ptr<AbstractExtentStack> extent_stack,
-                                obj_ptr obj, float obj_rem_size,
+                                obj_ptr obj, capacity_t obj_rem_size,
                                 float key) override {
-    float temp = 0;
-    if (current_exts->find(key) == current_exts->end()) {
-      (*current_exts)[key] = ext_manager->create_extent();
-    }
-    ext_ptr current_extent = (*current_exts)[key];
-    float rem_size = obj_rem_size;
+    capacity_t temp = 0;
+    ext_ptr &current_extent = current_ext_at_key(key);
+    capacity_t rem_size = obj_rem_size;
     while (rem_size > 0) {
       temp = current_extent->add_object(obj, obj_rem_size);
       rem_size = rem_size - temp;
@@ -1497,14 +1609,13 @@ public:
         extent_stack->add_extent(std::invoke(ext_key_fnc, current_extent),
                                  current_extent);
         update_extent_type(current_extent);
-        current_extent->type = get_extent_type(current_extent);
         current_extent = ext_manager->create_extent();
-        (*current_exts)[key] = current_extent;
       }
     }
   }
   void pack_objects(shared_ptr<AbstractExtentStack> extent_stack, std::set<obj_ptr>& objs,
                     float key = 0) override {
+    PROFILE_PHASE(Phase::PackObjects);
     while (!obj_queue->empty()) {
       obj_pq_record r = std::get<obj_pq_record>(obj_queue->top());
       obj_queue->pop();
@@ -1532,8 +1643,8 @@ public:
       : SimpleGCObjectPacker(obj_manager, ext_manager, nullptr, current_exts,
                              num_objs_in_pool, threshold, record_ext_types),
         obj_key_fnc(o_k_f), ext_key_fnc(e_k_f), obj_queue(obj_q){};
-  void add_objs(object_lst obj_lst) override {
-    for(auto o : obj_lst)
+  void add_objs(const object_lst &obj_lst) override {
+    for (auto &o : obj_lst)
     {
       add_obj(o);
     }
@@ -1545,20 +1656,11 @@ public:
 
   void generate_exts_at_key(shared_ptr<AbstractExtentStack> extent_stack,
                             int num_exts, float key) override {
-    int num_exts_at_key = extent_stack->get_length_at_key(key);
-    while (num_exts_at_key < num_exts) {
-      object_lst objs = this->obj_manager->create_new_object();
-      for (auto r : objs) {
-        obj_queue->push(obj_pq_record(std::invoke(obj_key_fnc, r.first), r.first,
-                                     r.first->size));
-      }
-      auto temp = std::set<obj_ptr>();
-      pack_objects(extent_stack, temp, key);
-      num_exts_at_key = extent_stack->get_length_at_key(key);
-    }
+    fill_exts_at_key(extent_stack, num_exts, key, key);
   }
   void pack_objects(shared_ptr<AbstractExtentStack> extent_stack,
                     std::set<obj_ptr>& objs, float key = 0) override {
+    PROFILE_PHASE(Phase::PackObjects);
     while (!obj_queue->empty()) {
       obj_pq_record r = std::get<obj_pq_record>(obj_queue->top());
       float key = 0;
@@ -1567,16 +1669,11 @@ public:
                                     std::get<2>(r), key);
     }
   };
-  void gc_extent(
-      ext_ptr ext, shared_ptr<AbstractExtentStack> extent_stack,
-      std::set<obj_ptr>& objs) override {
-    for (auto &obj_kv : ext->objects)
-    {
-      auto obj = obj_kv.first;
-      auto size = ext->get_obj_size(obj);
-      // fprintf(stderr, "%d %d",  obj->id, size);
-      this->add_obj(obj_record(obj, ext->get_obj_size(obj)));
-    }
+  void gc_objects(const object_lst &records,
+                  shared_ptr<AbstractExtentStack> extent_stack,
+                  std::set<obj_ptr> &objs) override {
+    for (auto &record : records)
+      this->add_obj(record);
     this->pack_objects(extent_stack, objs);
   }
 
@@ -1587,14 +1684,11 @@ public:
 
   void
   add_obj_to_current_ext_at_key(shared_ptr<AbstractExtentStack> extent_stack,
-                                obj_ptr obj, float obj_rem_size,
+                                obj_ptr obj, capacity_t obj_rem_size,
                                 float key) override {
-    float temp = 0;
-    if (current_exts->find(key) == current_exts->end()) {
-      (*current_exts)[key] = ext_manager->create_extent();
-    }
-    ext_ptr current_extent = (*current_exts)[key];
-    float rem_size = obj_rem_size;
+    capacity_t temp = 0;
+    ext_ptr &current_extent = current_ext_at_key(key);
+    capacity_t rem_size = obj_rem_size;
     while (rem_size > 0) {
       temp = current_extent->add_object(obj, obj_rem_size);
       rem_size = rem_size - temp;
@@ -1602,9 +1696,7 @@ public:
         extent_stack->add_extent(std::invoke(ext_key_fnc, current_extent),
                                  current_extent);
         update_extent_type(current_extent);
-        current_extent->type = get_extent_type(current_extent);
         current_extent = ext_manager->create_extent();
-        (*current_exts)[key] = current_extent;
       }
     }
   }
@@ -1625,6 +1717,7 @@ public:
                              &Extent::get_timestamp) {}
   void pack_objects(shared_ptr<AbstractExtentStack> extent_stack,
                     std::set<obj_ptr>& objs, float key = 0) override {
+    PROFILE_PHASE(Phase::PackObjects);
     while (!obj_queue->empty()) {
       obj_pq_record r = std::get<obj_pq_record>(obj_queue->top());
       obj_queue->pop();
@@ -1649,6 +1742,7 @@ public:
                                &Extent::get_timestamp) {}
   void pack_objects(shared_ptr<AbstractExtentStack> extent_stack, std::set<obj_ptr>& objs,
                     float key = 0) override {
+    PROFILE_PHASE(Phase::PackObjects);
     while (!obj_queue->empty()) {
       obj_pq_record r = std::get<obj_pq_record>(obj_queue->top());
       obj_queue->pop();
@@ -1663,6 +1757,7 @@ public:
   using AgeBasedObjectPacker::AgeBasedObjectPacker;
   void pack_objects(shared_ptr<AbstractExtentStack> extent_stack, std::set<obj_ptr>& objs,
                     float key = 0) override {
+    PROFILE_PHASE(Phase::PackObjects);
     float prev_key = 0;
     while (obj_queue->size() > 0) {
       prev_key = std::get<0>(std::get<obj_pq_record>(obj_queue->top()));
@@ -1682,7 +1777,7 @@ public:
       }
 
       shuffle(chunks.begin(), chunks.end(), generator);
-      for (auto obj : chunks) {
+      for (auto &obj : chunks) {
         add_obj_to_current_ext_at_key(extent_stack, obj, 4, key);
       }
     }
@@ -1694,6 +1789,7 @@ public:
   using AgeBasedGCObjectPacker::AgeBasedGCObjectPacker;
   void pack_objects(shared_ptr<AbstractExtentStack> extent_stack, std::set<obj_ptr>& objs,
                     float key = 0) override {
+    PROFILE_PHASE(Phase::PackObjects);
     float prev_key = 0;
     while (obj_queue->size() > 0) {
       prev_key = std::get<0>(std::get<obj_pq_record>(obj_queue->top()));
@@ -1713,7 +1809,7 @@ public:
       }
 
       shuffle(chunks.begin(), chunks.end(), generator);
-      for (auto obj : chunks) {
+      for (auto &obj : chunks) {
         add_obj_to_current_ext_at_key(extent_stack, obj, 4, 0);
       }
     }
@@ -1735,32 +1831,25 @@ public:
 
   void generate_exts_at_key(shared_ptr<AbstractExtentStack> extent_stack,
                             int num_exts, float key) override {
-    int num_exts_at_key = extent_stack->get_length_at_key(key);
-    // std::cout << extent_stack->get_length_of_extent_stack() << std::endl;
-    while (num_exts_at_key < num_exts) {
-      object_lst objs = this->obj_manager->create_new_object();
-      for (auto r : objs) {
-        obj_ptr obj = r.first;
-        obj_queue->push(obj_record(obj, obj->size));
-      }
-      auto temp = std::set<obj_ptr>();
-      pack_objects(extent_stack, temp);
-      num_exts_at_key = extent_stack->get_length_at_key(key);
-    }
+    fill_exts_at_key(extent_stack, num_exts, key, 0);
   }
   void generate_stripes(shared_ptr<AbstractExtentStack> extent_stack,
                         float simulation_time) override {
     if (obj_queue->size() < num_objs_in_pool) {
       auto objs =
           obj_manager->create_new_object(num_objs_in_pool - obj_queue->size());
-      for (auto p : objs) {
+      for (auto &p : objs) {
         add_obj(obj_record(p.first, p.second));
       }
       auto temp = std::set<obj_ptr>();
       pack_objects(extent_stack, temp);
     }
   }
+
+  bool idle() override { return obj_queue->size() >= num_objs_in_pool; }
+
   void pack_objects(shared_ptr<AbstractExtentStack> extent_stack, std::set<obj_ptr>& objs, float k = 0) override {
+    PROFILE_PHASE(Phase::PackObjects);
     // std::cout << "pack_objects before" << obj_queue->size() << std::endl;
     while (obj_queue->size() > 0) {
       obj_record r = std::get<obj_record>(obj_queue->top());
@@ -1790,20 +1879,11 @@ public:
 
   void generate_exts_at_key(shared_ptr<AbstractExtentStack> extent_stack,
                             int num_exts, float key) override {
-    int num_exts_at_key = extent_stack->get_length_at_key(key);
-    while (num_exts_at_key < num_exts) {
-      object_lst objs = this->obj_manager->create_new_object();
-      for (auto r : objs) {
-        obj_ptr obj = r.first;
-        obj_queue->push(obj_record(obj, obj->size));
-      }
-      std::set<obj_ptr> aaa;
-      pack_objects(extent_stack, aaa);
-      num_exts_at_key = extent_stack->get_length_at_key(key);
-    }
+    fill_exts_at_key(extent_stack, num_exts, key, 0);
   }
   void pack_objects(shared_ptr<AbstractExtentStack> extent_stack,
                     std::set<obj_ptr> &objs, float k = 0) override {
+    PROFILE_PHASE(Phase::PackObjects);
     while (obj_queue->size() > 0) {
       obj_record r = std::get<obj_record>(obj_queue->top());
       obj_queue->pop();
@@ -0,0 +1,285 @@
+#ifndef __PLACEMENT_H_
+#define __PLACEMENT_H_
+
+#include "extent_object_stripe.h"
+#include "ftl.h"
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// How the extents of a new stripe are spread over the storage nodes
+enum class placement_policy {
+  // Distinct nodes picked uniformly at random
+  random,
+  // Consecutive nodes, carrying on from where the last stripe ended
+  round_robin,
+  // The nodes storing the least data
+  load_aware,
+};
+
+inline bool parse_placement_policy(const string &name,
+                                   placement_policy &policy) {
+  if (name == "random")
+    policy = placement_policy::random;
+  else if (name == "round_robin")
+    policy = placement_policy::round_robin;
+  else if (name == "load_aware")
+    policy = placement_policy::load_aware;
+  else
+    return false;
+  return true;
+}
+
+// Traffic of a node in the current cycle
+struct node_cycle_traffic {
+  double gc_reads = 0;
+  double gc_writes = 0;
+  double striping_writes = 0;
+
+  double gc() const { return gc_reads + gc_writes; }
+  double total() const { return gc() + striping_writes; }
+};
+
+struct node_stats {
+  capacity_t stored = 0;
+  long double gc_traffic = 0;
+  long double striping_traffic = 0;
+  // Largest GC plus striping traffic of the node in a single cycle
+  double peak_cycle_traffic = 0;
+};
+
+/*
+ * Places the extents of every stripe on one of num_nodes storage nodes and
+ * tallies the traffic each node sees in every cycle. The first slots of a
+ * stripe's nodes hold its data extents, the rest its parities. A stripe
+ * uses distinct nodes as long as there are enough of them.
+ *
+ * Writing a new stripe charges every node of the stripe with an extent of
+ * striping traffic, or of GC traffic when the stripe is written by the GC.
+ * The GC traffic of collecting a stripe is charged to the nodes of the
+ * collected stripe: data reads and transfers evenly to its data nodes and
+ * parity updates evenly to its parity nodes. When the GC writes the valid
+ * data to new stripes instead, only the reads are charged there, as placing
+ * the new stripes already charged the writes.
+ *
+ * With an FTL set, every node also writes the extents placed on it to its
+ * own FlashTranslationLayer and trims them when their stripe is deleted. The
+ * GC writes to a collected stripe overwrite pages of its extents on the
+ * nodes they are charged to.
+ */
+class StorageNodes {
+  placement_policy policy;
+  std::mt19937 rng;
+  int next_node = 0;
+  vector<node_stats> nodes;
+  vector<node_cycle_traffic> cycle;
+  vector<FlashTranslationLayer> ftls;
+  bool in_gc = false;
+  // Largest traffic of a single node in a cycle, overall and of the GC
+  double peak_node_traffic = 0, peak_node_gc_traffic = 0;
+
+  // Spreads amount evenly over the nodes of slots [begin, end) of a stripe
+  void charge(double node_cycle_traffic::*field, const vector<int> &on,
+              size_t begin, size_t end, long double amount) {
+    if (begin >= end)
+      return;
+    double share = amount / (end - begin);
+    for (size_t i = begin; i < end; i++)
+      cycle[on[i]].*field += share;
+  }
+
+  // Overwrites amount spread evenly over the extents of slots [begin, end)
+  void rewrite(const Stripe &stripe, size_t begin, size_t end,
+               long double amount) {
+    if (ftls.empty() || stripe.ftl_extents.empty() || begin >= end)
+      return;
+    int pages = ftls[0].pages_of(stripe.ext_size);
+    long long n = std::llround(amount / (end - begin) / ftls[0].page_size());
+    for (size_t i = begin; i < end; i++)
+      ftls[stripe.nodes[i]].rewrite_extent(stripe.ftl_extents[i], pages, n);
+  }
+
+public:
+  StorageNodes(int num_nodes, placement_policy policy, unsigned seed = 0)
+      : policy(policy), rng(seed), nodes(std::max(num_nodes, 1)),
+        cycle(nodes.size()) {}
+
+  int num_nodes() { return nodes.size(); }
+
+  // Gives every node an FTL with the given parameters
+  void set_ftl(ftl_params params) {
+    ftls.assign(nodes.size(), FlashTranslationLayer(params));
+  }
+
+  bool has_ftl() { return !ftls.empty(); }
+
+  const vector<node_stats> &get_nodes() { return nodes; }
+
+  // Traffic of every node in the cycle so far
+  const vector<node_cycle_traffic> &get_cycle_traffic() { return cycle; }
+
+  // Nodes for the num_slots extents of a new stripe
+  vector<int> choose_nodes(int num_slots) {
+    int n = nodes.size();
+    vector<int> ret;
+    ret.reserve(num_slots);
+    switch (policy) {
+    case placement_policy::round_robin:
+      for (int i = 0; i < num_slots; i++) {
+        ret.push_back(next_node);
+        next_node = (next_node + 1) % n;
+      }
+      break;
+    case placement_policy::random: {
+      vector<int> order(n);
+      std::iota(order.begin(), order.end(), 0);
+      for (int i = 0; i < num_slots; i++) {
+        // Partial Fisher-Yates, starting over once every node is used
+        int k = i % n;
+        std::uniform_int_distribution<int> pick(k, n - 1);
+        std::swap(order[k], order[pick(rng)]);
+        ret.push_back(order[k]);
+      }
+      break;
+    }
+    case placement_policy::load_aware: {
+      vector<int> order(n);
+      std::iota(order.begin(), order.end(), 0);
+      int k = std::min(num_slots, n);
+      std::partial_sort(order.begin(), order.begin() + k, order.end(),
+                        [this](int a, int b) {
+                          if (nodes[a].stored != nodes[b].stored)
+                            return nodes[a].stored < nodes[b].stored;
+                          return a < b;
+                        });
+      for (int i = 0; i < num_slots; i++)
+        ret.push_back(order[i % k]);
+      break;
+    }
+    }
+    return ret;
+  }
+
+  void place_stripe(Stripe &stripe, int num_slots) {
+    stripe.nodes = choose_nodes(num_slots);
+    for (int node : stripe.nodes)
+      nodes[node].stored += stripe.ext_size;
+    charge(in_gc ? &node_cycle_traffic::gc_writes
+                 : &node_cycle_traffic::striping_writes,
+           stripe.nodes, 0, stripe.nodes.size(),
+           (long double)stripe.ext_size * num_slots);
+    if (ftls.empty())
+      return;
+    int pages = ftls[0].pages_of(stripe.ext_size);
+    stripe.ftl_extents.clear();
+    for (int node : stripe.nodes)
+      stripe.ftl_extents.push_back(ftls[node].write_extent(pages));
+  }
+
+  void release_stripe(Stripe &stripe) {
+    for (int node : stripe.nodes)
+      nodes[node].stored -= stripe.ext_size;
+    if (stripe.ftl_extents.empty())
+      return;
+    int pages = ftls[0].pages_of(stripe.ext_size);
+    for (size_t i = 0; i < stripe.nodes.size(); i++)
+      ftls[stripe.nodes[i]].trim_extent(stripe.ftl_extents[i], pages);
+    stripe.ftl_extents.clear();
+  }
+
+  // Whether the stripes written from now on are written by the GC
+  void set_gc_phase(bool gc) { in_gc = gc; }
+
+  void add_gc_traffic(const Stripe &stripe, long double data_reads,
+                      long double data_writes, long double parity_reads,
+                      long double parity_writes) {
+    size_t num_data = std::min(stripe.slots.size(), stripe.nodes.size());
+    // Without parity nodes the data nodes keep the parities
+    size_t parity_begin = num_data < stripe.nodes.size() ? num_data : 0;
+    charge(&node_cycle_traffic::gc_reads, stripe.nodes, 0, num_data,
+           data_reads);
+    charge(&node_cycle_traffic::gc_writes, stripe.nodes, 0, num_data,
+           data_writes);
+    charge(&node_cycle_traffic::gc_reads, stripe.nodes, parity_begin,
+           stripe.nodes.size(), parity_reads);
+    charge(&node_cycle_traffic::gc_writes, stripe.nodes, parity_begin,
+           stripe.nodes.size(), parity_writes);
+    rewrite(stripe, 0, num_data, data_writes);
+    rewrite(stripe, parity_begin, stripe.nodes.size(), parity_writes);
+  }
+
+  /*
+   * Adds the traffic of the cycle to the totals of the nodes and returns
+   * the largest GC traffic of a node in the cycle.
+   */
+  double end_cycle() {
+    double max_gc = 0;
+    for (size_t i = 0; i < nodes.size(); i++) {
+      double traffic = cycle[i].total();
+      nodes[i].gc_traffic += cycle[i].gc();
+      nodes[i].striping_traffic += cycle[i].striping_writes;
+      nodes[i].peak_cycle_traffic =
+          std::max(nodes[i].peak_cycle_traffic, traffic);
+      peak_node_traffic = std::max(peak_node_traffic, traffic);
+      max_gc = std::max(max_gc, cycle[i].gc());
+    }
+    peak_node_gc_traffic = std::max(peak_node_gc_traffic, max_gc);
+    std::fill(cycle.begin(), cycle.end(), node_cycle_traffic());
+    return max_gc;
+  }
+
+  double get_peak_node_traffic() { return peak_node_traffic; }
+  double get_peak_node_gc_traffic() { return peak_node_gc_traffic; }
+
+  // GC traffic of the busiest node over that of the average node
+  double gc_imbalance() {
+    long double total = 0, max = 0;
+    for (auto &n : nodes) {
+      total += n.gc_traffic;
+      max = std::max(max, n.gc_traffic);
+    }
+    return total > 0 ? max / (total / nodes.size()) : 0;
+  }
+
+  // FTL totals over the nodes, without end_to_end_waf
+  ftl_result get_ftl_result() {
+    ftl_result ret;
+    size_t total_blocks = 0;
+    for (auto &ftl : ftls) {
+      ftl_result r = ftl.result();
+      ret.host_writes += r.host_writes;
+      ret.flash_writes += r.flash_writes;
+      ret.erases += r.erases;
+      ret.max_block_erases = std::max(ret.max_block_erases, r.max_block_erases);
+      total_blocks += ftl.flash_blocks();
+      ret.extra_blocks += r.extra_blocks;
+    }
+    if (ret.host_writes > 0)
+      ret.device_waf = ret.flash_writes / ret.host_writes;
+    if (total_blocks > 0)
+      ret.mean_block_erases = (double)ret.erases / total_blocks;
+    return ret;
+  }
+
+  void print() {
+    long double gc = 0, striping = 0;
+    for (auto &n : nodes) {
+      gc += n.gc_traffic;
+      striping += n.striping_traffic;
+    }
+    printf("Storage nodes: %zu, GC traffic per node %.4Le, striping traffic "
+           "per node %.4Le\n",
+           nodes.size(), gc / nodes.size(), striping / nodes.size());
+    printf("Peak node traffic per cycle %.4e, peak node GC traffic per "
+           "cycle %.4e, GC imbalance (max/mean) %.4f\n",
+           peak_node_traffic, peak_node_gc_traffic, gc_imbalance());
+  }
+};
+
+#endif // __PLACEMENT_H_
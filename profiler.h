@@ -0,0 +1,119 @@
+#ifndef __PROFILER_H_
+#define __PROFILER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+/*
+ * Phases of the simulation loop that can be timed. Times are inclusive, so
+ * a phase that runs inside another one (e.g., pack_objects inside
+ * stripe_gc) is also counted in the enclosing phase.
+ */
+enum class Phase {
+  Deletion,
+  GCHandler,
+  StripeGC,
+  GenerateStripes,
+  CreateStripes,
+  PackObjects,
+  ObjectSampling,
+  NumPhases
+};
+
+struct phase_counter {
+  std::atomic<unsigned long long> ns{0};
+  std::atomic<unsigned long long> calls{0};
+};
+
+class Profiler {
+  static constexpr int num_phases = static_cast<int>(Phase::NumPhases);
+  static inline phase_counter counters[num_phases];
+
+public:
+  static const char *name(Phase phase) {
+    switch (phase) {
+    case Phase::Deletion:
+      return "deletion";
+    case Phase::GCHandler:
+      return "gc_handler";
+    case Phase::StripeGC:
+      return "stripe_gc";
+    case Phase::GenerateStripes:
+      return "generate_stripes";
+    case Phase::CreateStripes:
+      return "create_stripes";
+    case Phase::PackObjects:
+      return "pack_objects";
+    case Phase::ObjectSampling:
+      return "object_sampling";
+    default:
+      return "unknown";
+    }
+  }
+
+  static void add(Phase phase, unsigned long long ns) {
+    auto &c = counters[static_cast<int>(phase)];
+    c.ns.fetch_add(ns, std::memory_order_relaxed);
+    c.calls.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  static void reset() {
+    for (auto &c : counters) {
+      c.ns.store(0, std::memory_order_relaxed);
+      c.calls.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  /*
+   * Prints total time, number of calls and ns/call for every phase that
+   * was entered at least once.
+   */
+  static void report(FILE *out = stdout) {
+    fprintf(out, "%-18s %14s %12s %14s\n", "phase", "total (ms)", "calls",
+            "ns/call");
+    for (int i = 0; i < num_phases; i++) {
+      unsigned long long ns = counters[i].ns.load(std::memory_order_relaxed);
+      unsigned long long calls =
+          counters[i].calls.load(std::memory_order_relaxed);
+      if (calls == 0)
+        continue;
+      fprintf(out, "%-18s %14.3f %12llu %14.1f\n",
+              name(static_cast<Phase>(i)), ns / 1e6, calls,
+              (double)ns / calls);
+    }
+  }
+};
+
+class ScopedPhaseTimer {
+  Phase phase;
+  std::chrono::steady_clock::time_point start;
+
+public:
+  ScopedPhaseTimer(Phase p)
+      : phase(p), start(std::chrono::steady_clock::now()) {}
+  ~ScopedPhaseTimer() {
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    Profiler::add(
+        phase,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+  }
+};
+
+// The timers are only compiled in when building with -DSSDSIM_PROFILE=ON
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#ifdef SSDSIM_PROFILE
+#define PROFILE_PHASE(phase)                                                   \
+  ScopedPhaseTimer PROFILE_CONCAT(phase_timer_, __LINE__)(phase)
+#define PROFILE_REPORT()                                                       \
+  do {                                                                         \
+    Profiler::report();                                                        \
+    Profiler::reset();                                                         \
+  } while (0)
+#else
+#define PROFILE_PHASE(phase)
+#define PROFILE_REPORT()
+#endif
+
+#endif // __PROFILER_H_
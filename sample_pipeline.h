@@ -0,0 +1,190 @@
+#ifndef __SAMPLE_PIPELINE_H_
+#define __SAMPLE_PIPELINE_H_
+
+#include "samplers.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+using std::shared_ptr;
+
+// Size, life and life noise of one sampled object
+struct obj_sample {
+  float size = 0;
+  float life = 0;
+  int noise = 0;
+};
+
+/*
+ * Lock-free ring buffer between a single producer and a single consumer
+ * thread. Each side owns one of the indices and keeps a cached copy of the
+ * other one, so the shared atomics are only read when the cached copy says
+ * the ring is full (or empty).
+ */
+template <typename T> class SPSCRing {
+  std::vector<T> slots;
+  size_t mask;
+  alignas(64) std::atomic<size_t> head{0};
+  alignas(64) size_t cached_tail = 0;
+  alignas(64) std::atomic<size_t> tail{0};
+  alignas(64) size_t cached_head = 0;
+
+public:
+  // The capacity is rounded up to a power of two
+  SPSCRing(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity)
+      size <<= 1;
+    slots.resize(size);
+    mask = size - 1;
+  }
+
+  size_t capacity() { return slots.size(); }
+
+  // Producer side, returns false if the ring is full
+  bool push(const T &value) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t - cached_head == slots.size()) {
+      cached_head = head.load(std::memory_order_acquire);
+      if (t - cached_head == slots.size())
+        return false;
+    }
+    slots[t & mask] = value;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side, returns false if the ring is empty
+  bool pop(T &value) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h == cached_tail) {
+      cached_tail = tail.load(std::memory_order_acquire);
+      if (h == cached_tail)
+        return false;
+    }
+    value = slots[h & mask];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+};
+
+/*
+ * Where the object manager takes the samples of new objects from when the
+ * sampler can sample one object at a time.
+ */
+class SampleSource {
+public:
+  virtual ~SampleSource() {}
+  virtual obj_sample next() = 0;
+
+  // Stops and restarts the threads of the source, e.g. around a fork()
+  virtual void pause() {}
+  virtual void resume() {}
+};
+
+/*
+ * Sequence of object samples of a streamable sampler. It draws from an
+ * engine of its own rather than the global generator, so the sequence only
+ * depends on the seed and not on what else the simulation draws.
+ */
+class SampleStream : public SampleSource {
+  shared_ptr<Sampler> sampler;
+  std::mt19937 rng;
+
+public:
+  SampleStream(shared_ptr<Sampler> sampler, unsigned seed)
+      : sampler(sampler), rng(seed) {}
+
+  obj_sample next() override {
+    obj_sample s;
+    sampler->sample_one(rng, s.size, s.life);
+    s.noise = randint(rng, 0, 24);
+    return s;
+  }
+};
+
+/*
+ * Samples a SampleStream ahead of the simulation on a producer thread. The
+ * samples are handed over through an SPSCRing in the order the stream
+ * produces them, so the simulation sees the same sequence as if it sampled
+ * the stream itself.
+ */
+class PipelinedSampleSource : public SampleSource {
+  SampleStream stream;
+  SPSCRing<obj_sample> ring;
+  std::atomic<bool> stopping{false};
+  std::thread producer;
+  // Sample the producer drew but could not push before it was stopped
+  obj_sample pending;
+  bool has_pending = false;
+
+  void producer_loop() {
+    obj_sample s = has_pending ? pending : stream.next();
+    has_pending = false;
+    while (!stopping.load(std::memory_order_relaxed)) {
+      if (ring.push(s)) {
+        s = stream.next();
+        continue;
+      }
+      // The simulation is behind, a full ring is plenty of work for it
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    pending = s;
+    has_pending = true;
+  }
+
+  void start() {
+    if (producer.joinable())
+      return;
+    stopping = false;
+    producer = std::thread(&PipelinedSampleSource::producer_loop, this);
+  }
+
+public:
+  PipelinedSampleSource(shared_ptr<Sampler> sampler, unsigned seed,
+                        size_t ring_size = 1 << 16)
+      : stream(sampler, seed), ring(ring_size) {
+    start();
+  }
+
+  PipelinedSampleSource(const PipelinedSampleSource &) = delete;
+  PipelinedSampleSource &operator=(const PipelinedSampleSource &) = delete;
+
+  ~PipelinedSampleSource() { stop(); }
+
+  /*
+   * While the producer is stopped, the samples left in the ring are handed
+   * out first and the stream is then sampled on the calling thread, so the
+   * sequence carries on where the producer left it.
+   */
+  obj_sample next() override {
+    obj_sample s;
+    while (!ring.pop(s)) {
+      if (!producer.joinable()) {
+        if (!has_pending)
+          return stream.next();
+        has_pending = false;
+        return pending;
+      }
+      std::this_thread::yield();
+    }
+    return s;
+  }
+
+  // Joins the producer thread
+  void stop() {
+    if (!producer.joinable())
+      return;
+    stopping = true;
+    producer.join();
+  }
+
+  void pause() override { stop(); }
+  void resume() override { start(); }
+};
+
+#endif // __SAMPLE_PIPELINE_H_
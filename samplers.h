@@ -21,6 +21,11 @@ static inline int randint(int min, int max) {
   return (rand() % ((max + 1) - min)) + min;
 }
 
+// randint drawing from the given engine instead of rand()
+static inline int randint(std::mt19937 &rng, int min, int max) {
+  return (rng() % ((max + 1) - min)) + min;
+}
+
 /*
  * Blueprint for implementing samplers for object size and life
  */
@@ -44,6 +49,27 @@ public:
    * @param: sim_time float
    */
   virtual sample_pair get_size_age_sample(const int num_samples = 1) = 0;
+
+  /*
+   * Whether the sampler can draw objects one at a time from an engine of
+   * the caller with sample_one. Samplers whose samples depend on how many
+   * objects are asked for at once cannot.
+   */
+  virtual bool streamable() { return false; }
+
+  /*
+   * Draws the size and life of a single object from the given engine. It
+   * only reads the sampler, so it can run on another thread than the
+   * simulation.
+   */
+  virtual void sample_one(std::mt19937 &rng, float &size, float &life) {
+    std::cerr << "Sampler " << name << " cannot sample one object at a time"
+              << std::endl;
+    exit(1);
+  }
+
+  unsigned get_seed() { return seed; }
+
   operator std::string() const{return name;};
 };
 
@@ -57,7 +83,71 @@ public:
                        this->sample_life(num_samples));
   }
 
+  bool streamable() override { return true; }
+
+  void sample_one(std::mt19937 &rng, float &size, float &life) override {
+    std::uniform_real_distribution<double> real_dist(0.0, 100.0);
+    auto rand_range = [&rng](int min, int max) { return randint(rng, min, max); };
+    size = size_for(real_dist(rng), rand_range);
+    life = life_for(real_dist(rng), rand_range);
+  }
+
 private:
+  /*
+   * Size for a draw of temp in [0, 100) from the size distribution, with
+   * rand_range(min, max) picking the size within the drawn bucket
+   */
+  template <typename RandRange>
+  static float size_for(double temp, RandRange &&rand_range) {
+    if (temp < 50)
+      return rand_range(4, 10);
+    else if (temp < 65)
+      return rand_range(11, 50);
+    else if (temp < 75.1)
+      return rand_range(51, 100);
+    else if (temp < 81.3)
+      return rand_range(101, 200);
+    else if (temp < 85.5)
+      return rand_range(201, 300);
+    else if (temp < 88)
+      return rand_range(301, 400);
+    else if (temp < 89.5)
+      return rand_range(401, 500);
+    else if (temp < 90.7)
+      return rand_range(501, 600);
+    else if (temp < 91.8)
+      return rand_range(601, 700);
+    else if (temp < 92.7)
+      return rand_range(701, 800);
+    else if (temp < 93.6)
+      return rand_range(801, 900);
+    else if (temp < 94)
+      return rand_range(901, 1000);
+    else if (temp < 95.2)
+      return rand_range(1001, 1500);
+    else if (temp < 96.2)
+      return rand_range(1501, 2000);
+    else
+      return rand_range(2001, 3000);
+  }
+
+  // Life for a draw of temp in [0, 100) from the life distribution
+  template <typename RandRange>
+  float life_for(double temp, RandRange &&rand_range) {
+    if (temp < 5)
+      return 1;
+    else if (temp < 9)
+      return rand_range(2, 7);
+    else if (temp < 12)
+      return rand_range(8, 30);
+    else if (temp < 16)
+      return rand_range(31, 90);
+    else if (temp < 26)
+      return rand_range(91, 365);
+    else
+      return std::ceil(this->sim_time + 1);
+  }
+
   /*
    * Returns a list of integer as the size of an object, sampled from the
    * distribution, the result is rounded to integer
@@ -66,40 +156,10 @@ private:
     sizes sizes_lst = sizes();
     // static std::mt19937 generator(this->seed);
     std::uniform_real_distribution<double> real_dist(0.0, 100.0);
-    
-    for (int i = 0; i < num_samples; i++) {
-      double temp = real_dist(generator);
-      if (temp < 50)
-        sizes_lst.emplace_back(randint(4, 10));
-      else if (temp < 65)
-        sizes_lst.emplace_back(randint(11, 50));
-      else if (temp < 75.1)
-        sizes_lst.emplace_back(randint(51, 100));
-      else if (temp < 81.3)
-        sizes_lst.emplace_back(randint(101, 200));
-      else if (temp < 85.5)
-        sizes_lst.emplace_back(randint(201, 300));
-      else if (temp < 88)
-        sizes_lst.emplace_back(randint(301, 400));
-      else if (temp < 89.5)
-        sizes_lst.emplace_back(randint(401, 500));
-      else if (temp < 90.7)
-        sizes_lst.emplace_back(randint(501, 600));
-      else if (temp < 91.8)
-        sizes_lst.emplace_back(randint(601, 700));
-      else if (temp < 92.7)
-        sizes_lst.emplace_back(randint(701, 800));
-      else if (temp < 93.6)
-        sizes_lst.emplace_back(randint(801, 900));
-      else if (temp < 94)
-        sizes_lst.emplace_back(randint(901, 1000));
-      else if (temp < 95.2)
-        sizes_lst.emplace_back(randint(1001, 1500));
-      else if (temp < 96.2)
-        sizes_lst.emplace_back(randint(1501, 2000));
-      else
-        sizes_lst.emplace_back(randint(2001, 3000));
-    }
+    int (*rand_range)(int, int) = randint;
+
+    for (int i = 0; i < num_samples; i++)
+      sizes_lst.emplace_back(size_for(real_dist(generator), rand_range));
 
     return sizes_lst;
   }
@@ -111,22 +171,10 @@ private:
   lives sample_life(const int num_samples) {
     lives lives_lst = lives();
     std::uniform_real_distribution<double> real_dist(0.0, 100.0);
+    int (*rand_range)(int, int) = randint;
 
-    for (int i = 0; i < num_samples; i++) {
-      double temp = real_dist(generator);
-      if (temp < 5)
-        lives_lst.emplace_back(1);
-      else if (temp < 9)
-        lives_lst.emplace_back(randint(2, 7));
-      else if (temp < 12)
-        lives_lst.emplace_back(randint(8, 30));
-      else if (temp < 16)
-        lives_lst.emplace_back(randint(31, 90));
-      else if (temp < 26)
-        lives_lst.emplace_back(randint(91, 365));
-      else
-        lives_lst.emplace_back(std::ceil(this->sim_time + 1));
-    }
+    for (int i = 0; i < num_samples; i++)
+      lives_lst.emplace_back(life_for(real_dist(generator), rand_range));
 
     return lives_lst;
   }
@@ -0,0 +1,170 @@
+#include "configs.h"
+#include "samplers.h"
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ * End-to-end scaling benchmark. Runs every registered configuration with
+ * an increasing number of objects and reports simulated days per wall-clock
+ * second and peak RSS, along with the bytes per live object, extent and
+ * stripe at the end of the run as estimated by DataCenter::memory_usage.
+ *
+ * Every run happens in its own child process, so the peak RSS reported by
+ * wait4 belongs to that run alone.
+ *
+ * Usage: scale_bench [output file] [simulation days]
+ *                    [comma separated object counts] [config ...]
+ */
+
+// Same workload as main.cpp, which simulates 1M objects in a data center of
+// 3.5M average sized objects over a year
+static const unsigned short ave_obj_size = 35000;
+static const double dc_objs_per_obj = 3.5;
+static const float striping_cycle = 1.0 / 12.0;
+static const int ext_size = 3 * 1024;
+static const short threshold = 10;
+static const short num_stripes_per_cycle = 100;
+
+struct scale_result {
+  double sim_days = 0;
+  double wall_secs = 0;
+  long num_objs = 0;
+  long num_exts = 0;
+  long num_stripes = 0;
+  // Estimated heap bytes of the live objects, extents and stripes
+  long obj_bytes = 0;
+  long ext_bytes = 0;
+  long stripe_bytes = 0;
+};
+
+/*
+ * Runs config with total_objs objects per simulated year for simul_time
+ * days. Returns false if the child did not finish.
+ */
+static bool run_config(config_fnc config, long total_objs, float simul_time,
+                       scale_result &res, long &max_rss_bytes) {
+  int fds[2];
+  if (pipe(fds) != 0)
+    return false;
+  pid_t pid = fork();
+  if (pid < 0)
+    return false;
+  if (pid == 0) {
+    close(fds[0]);
+    // The simulation prints its own summary, keep the benchmark output clean
+    int devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, STDOUT_FILENO);
+
+    unsigned long data_center_size =
+        dc_objs_per_obj * total_objs * (unsigned long)ave_obj_size;
+    int num_objs_per_cycle = total_objs / 365.0 * striping_cycle;
+    auto sampler = make_shared<SimpleSampler>(
+        DeterministicDistributionSampler(simul_time));
+    DataCenter dc = config(data_center_size, striping_cycle, simul_time,
+                           ext_size, threshold, threshold, sampler,
+                           num_stripes_per_cycle, striping_cycle,
+                           num_objs_per_cycle);
+
+    auto start = std::chrono::steady_clock::now();
+    sim_metric metric = dc.run_simulation();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    scale_result r;
+    r.sim_days = std::min((double)configtime, (double)simul_time);
+    r.wall_secs = elapsed.count();
+    r.num_objs = metric.num_objs;
+    r.num_exts = metric.num_exts;
+    r.num_stripes = metric.num_stripes;
+    for (auto &entry : dc.memory_usage()) {
+      if (entry.first == "objects")
+        r.obj_bytes = entry.second.bytes;
+      else if (entry.first == "extents")
+        r.ext_bytes = entry.second.bytes;
+      else if (entry.first == "stripes")
+        r.stripe_bytes = entry.second.bytes;
+    }
+    bool ok = write(fds[1], &r, sizeof(r)) == sizeof(r);
+    _exit(ok ? 0 : 1);
+  }
+
+  close(fds[1]);
+  bool ok = read(fds[0], &res, sizeof(res)) == sizeof(res);
+  close(fds[0]);
+  int status;
+  struct rusage usage;
+  wait4(pid, &status, 0, &usage);
+  // ru_maxrss is in kilobytes on Linux
+  max_rss_bytes = usage.ru_maxrss * 1024L;
+  return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static double per_entity(long bytes, long count) {
+  return count > 0 ? (double)bytes / count : 0;
+}
+
+int main(int argc, char *argv[]) {
+  string filename = argc > 1 ? argv[1] : "scaling_results.csv";
+  float simul_time = argc > 2 ? atof(argv[2]) : 365;
+  vector<long> obj_counts = {1000000, 10000000, 100000000};
+  if (argc > 3) {
+    obj_counts.clear();
+    std::stringstream ss(argv[3]);
+    string count;
+    while (std::getline(ss, count, ','))
+      obj_counts.push_back(atol(count.c_str()));
+  }
+  vector<string> confnames;
+  for (int i = 4; i < argc; i++)
+    confnames.push_back(argv[i]);
+  if (confnames.empty())
+    for (auto &entry : config_registry)
+      confnames.push_back(entry.first);
+
+  std::ofstream out(filename);
+  out << "config,objects,simulated days,wall seconds,simulated days per "
+         "second,peak rss (bytes),live objects,live extents,live stripes,"
+         "bytes per object,bytes per extent,bytes per stripe"
+      << endl;
+  for (auto &confname : confnames) {
+    config_fnc config = parse_config(confname);
+    if (!config) {
+      std::cerr << "Error: invalid config (" << confname
+                << ") detected! Skipping..." << std::endl;
+      continue;
+    }
+    for (long total_objs : obj_counts) {
+      scale_result res;
+      long max_rss = 0;
+      bool ok = run_config(config, total_objs, simul_time, res, max_rss);
+      std::cout << confname << " " << total_objs << " objs: ";
+      if (!ok) {
+        // Most likely killed for running out of memory, record the
+        // failure and move on to the next configuration
+        std::cout << "failed" << std::endl;
+        out << confname << "," << total_objs << ",,,," << max_rss << ",,,,,,"
+            << endl;
+        break;
+      }
+      double days_per_sec = res.wall_secs > 0 ? res.sim_days / res.wall_secs : 0;
+      std::cout << days_per_sec << " sim days/s, " << max_rss / (1 << 20)
+                << " MiB peak RSS" << std::endl;
+      out << confname << "," << total_objs << "," << res.sim_days << ","
+          << res.wall_secs << "," << days_per_sec << "," << max_rss << ","
+          << res.num_objs << "," << res.num_exts << "," << res.num_stripes
+          << "," << per_entity(res.obj_bytes, res.num_objs) << ","
+          << per_entity(res.ext_bytes, res.num_exts) << ","
+          << per_entity(res.stripe_bytes, res.num_stripes) << endl;
+    }
+  }
+  out.close();
+  return 0;
+}
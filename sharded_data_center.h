@@ -0,0 +1,397 @@
+#ifndef __SHARDED_DATA_CENTER_H_
+#define __SHARDED_DATA_CENTER_H_
+
+#include "config.h"
+#include "data_center.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+
+using std::function;
+using std::vector;
+
+// Spread of a per-shard quantity over the shards
+struct shard_imbalance {
+  double mean = 0;
+  double min = 0;
+  double max = 0;
+  // Coefficient of variation, the standard deviation over the mean
+  double cv = 0;
+  // Largest shard over the mean shard, 1 for perfectly balanced shards
+  double max_over_mean = 0;
+};
+
+inline shard_imbalance get_imbalance(const vector<double> &values) {
+  shard_imbalance ret;
+  if (values.empty())
+    return ret;
+  ret.min = *std::min_element(values.begin(), values.end());
+  ret.max = *std::max_element(values.begin(), values.end());
+  for (double v : values)
+    ret.mean += v;
+  ret.mean /= values.size();
+  double var = 0;
+  for (double v : values)
+    var += (v - ret.mean) * (v - ret.mean);
+  var /= values.size();
+  if (ret.mean > 0) {
+    ret.cv = std::sqrt(var) / ret.mean;
+    ret.max_over_mean = ret.max / ret.mean;
+  }
+  return ret;
+}
+
+/*
+ * Simulates a data center as a number of independent shards, each of them a
+ * full DataCenter with its own managers, packers, GC strategy and random
+ * state that holds an equal share of the capacity and of the object arrival
+ * rate. Objects never move between shards, so the shards only have to agree
+ * on the clock: every cycle runs all the shards in parallel on a thread
+ * pool, then moves configtime on for all of them.
+ *
+ * The shards draw their objects from SampleStreams with seeds of their own
+ * and shuffle with an engine of their own, so a shard's run does not depend
+ * on how the shards are spread over the threads. Samplers that can only
+ * sample in batches draw from the global random state instead, which the
+ * threads would share, so they are rejected. The shards may share a
+ * sampler, whose sample_one only reads it, but make_shard must not give
+ * them any other state in common; the configs build every data center from
+ * state of its own. The metrics of the shards are merged into the metrics
+ * of the whole data center.
+ *
+ * For quick approximate runs the shards can also be a random sample of the
+ * lanes of a data center split into num_lanes lanes, each lane receiving
+ * an equal share of the objects. Only the objects of the sampled lanes are
+ * simulated, the sizes and traffic of the sample are scaled up to the
+ * whole data center, and the result carries 95% error bounds of the main
+ * metrics estimated from the spread between the sampled lanes. The bounds
+ * only cover the sampling of the lanes: the lanes are smaller data centers
+ * than the whole, so effects that depend on the number of stripes in the
+ * data center (e.g. how full the GC candidates get) come out of the lanes
+ * rather than out of the data center being approximated.
+ */
+class ShardedDataCenter {
+public:
+  // Creates a shard with the given capacity and objects per striping cycle
+  using shard_factory =
+      function<DataCenter(unsigned long max_size, int num_objs_per_cycle)>;
+
+private:
+  vector<shared_ptr<DataCenter>> shards;
+  // Engine each shard shuffles with, swapped in as the running thread's
+  // generator for the duration of the shard's cycle
+  vector<std::mt19937> shard_generators;
+  vector<eh_result> shard_results;
+  vector<sim_metric> shard_metrics;
+  vector<bool> finished;
+  shared_ptr<ThreadPool> thread_pool;
+  // Lanes the data center is split into and the lane each shard simulates
+  int num_lanes;
+  vector<int> lanes;
+
+  void run_shard_cycle(size_t i) {
+    std::swap(generator, shard_generators[i]);
+    shards[i]->run_cycle();
+    std::swap(generator, shard_generators[i]);
+  }
+
+  void finish_shard(size_t i) {
+    cout << "Shard " << i << endl;
+    std::swap(generator, shard_generators[i]);
+    shard_results[i] = shards[i]->finish_run();
+    shard_metrics[i] = shards[i]->get_sim_metric(shard_results[i]);
+    std::swap(generator, shard_generators[i]);
+    finished[i] = true;
+  }
+
+public:
+  /*
+   * The capacity and the arrival rate are split evenly, with the remainder
+   * of the objects going to the first shards. If num_lanes is larger than
+   * the number of shards, they are split evenly over num_lanes lanes
+   * instead and the shards simulate a random sample of the lanes.
+   * num_threads defaults to one thread per shard, up to the number of
+   * cores.
+   */
+  ShardedDataCenter(int num_shards, unsigned long max_size,
+                    int num_objs_per_cycle, shard_factory make_shard,
+                    unsigned seed, int num_lanes = 0,
+                    unsigned num_threads = 0)
+      : num_lanes(std::max(num_lanes, num_shards)) {
+    if (num_threads == 0)
+      num_threads = std::max(
+          1u, std::min((unsigned)num_shards,
+                       std::thread::hardware_concurrency()));
+    for (int i = 0; i < this->num_lanes; i++)
+      lanes.push_back(i);
+    if (num_shards < this->num_lanes) {
+      std::seed_seq seq{seed};
+      std::mt19937 rng(seq);
+      std::shuffle(lanes.begin(), lanes.end(), rng);
+      lanes.resize(num_shards);
+      std::sort(lanes.begin(), lanes.end());
+    }
+    for (int lane : lanes) {
+      int num_objs = num_objs_per_cycle / this->num_lanes +
+                     (lane < num_objs_per_cycle % this->num_lanes);
+      shards.push_back(make_shared<DataCenter>(
+          make_shard(max_size / this->num_lanes, num_objs)));
+      std::seed_seq seq{seed, (unsigned)lane};
+      shard_generators.emplace_back(seq);
+      if (!shards.back()->set_sample_stream(shard_generators.back()())) {
+        std::cerr << "Error: sharded data centers need a sampler that can "
+                     "sample one object at a time. Exiting..."
+                  << std::endl;
+        exit(1);
+      }
+    }
+    shard_results.resize(num_shards);
+    shard_metrics.resize(num_shards);
+    finished.resize(num_shards, false);
+    thread_pool = make_shared<ThreadPool>(num_threads);
+  }
+
+  bool sampled() { return (int)shards.size() < num_lanes; }
+
+  int num_shards() { return shards.size(); }
+
+  const vector<sim_metric> &get_shard_metrics() { return shard_metrics; }
+
+  /*
+   * Runs the shards in lockstep until every one of them is done. A shard
+   * that fills up finishes while the others keep running.
+   */
+  sim_metric run_simulation() {
+    configtime = 0.0;
+    float gc_cycle = shards.front()->get_gc_cycle();
+    for (auto &shard : shards)
+      shard->start_run();
+    vector<size_t> running;
+    while (true) {
+      running.clear();
+      for (size_t i = 0; i < shards.size(); i++) {
+        if (finished[i])
+          continue;
+        if (shards[i]->running())
+          running.push_back(i);
+        else
+          finish_shard(i);
+      }
+      if (running.empty())
+        break;
+      thread_pool->parallel_for(running.size(), [&](size_t j) {
+        run_shard_cycle(running[j]);
+      });
+      configtime += gc_cycle;
+    }
+    sim_metric ret = merge_metrics();
+    print_imbalance();
+    return ret;
+  }
+
+  /*
+   * Metrics of the whole data center. Sizes and traffic add up over the
+   * shards and the ratios are recomputed from the sums. The obsolete
+   * percentages over time are averaged, the shards having the same size,
+   * and the costs per extent type are weighted by the user traffic of the
+   * shards.
+   */
+  sim_metric merge_metrics() {
+    sim_metric ret;
+    long double total_gc_budget = 0, total_gc_traffic = 0;
+    long double total_user_bandwidth = 0;
+    unordered_map<string, double> weighted_cost;
+    unordered_map<string, long double> weighted_obs;
+    vector<int> num_obs_percentages;
+    for (size_t i = 0; i < shards.size(); i++) {
+      sim_metric &m = shard_metrics[i];
+      ret.total_obsolete += m.total_obsolete;
+      ret.total_used_space += m.total_used_space;
+      ret.total_reclaimed_space += m.total_reclaimed_space;
+      ret.parity_reads += m.parity_reads;
+      ret.parity_writes += m.parity_writes;
+      ret.total_user_data_reads += m.total_user_data_reads;
+      ret.total_user_data_writes += m.total_user_data_writes;
+      ret.total_gc_bandwidth += m.total_gc_bandwidth;
+      ret.total_bandwidth += m.total_bandwidth;
+      ret.total_absent_data_reads += m.total_absent_data_reads;
+      ret.total_obsolete_data_reads += m.total_obsolete_data_reads;
+      ret.total_pool_to_parity_calculator += m.total_pool_to_parity_calculator;
+      ret.total_parity_calculator_to_storage_node +=
+          m.total_parity_calculator_to_storage_node;
+      ret.total_storage_node_to_parity_calculator +=
+          m.total_storage_node_to_parity_calculator;
+      ret.num_objs += m.num_objs;
+      ret.num_exts += m.num_exts;
+      ret.num_stripes += m.num_stripes;
+      ret.dc_size += m.dc_size;
+      ret.total_leftovers += m.total_leftovers;
+      ret.ave_exts_gced += m.ave_exts_gced;
+      ret.max_obs_perc = std::max(ret.max_obs_perc, m.max_obs_perc);
+      // The shards' backlogs need not peak together, so this is an upper
+      // bound of the data center's backlog
+      ret.max_gc_backlog += m.max_gc_backlog;
+      total_gc_budget += shard_results[i].total_gc_budget;
+      total_gc_traffic += shard_results[i].total_gc_traffic;
+
+      for (size_t j = 0; j < m.obs_percentages.size(); j++) {
+        if (j == ret.obs_percentages.size()) {
+          ret.obs_percentages.push_back(0);
+          num_obs_percentages.push_back(0);
+        }
+        ret.obs_percentages[j] += m.obs_percentages[j];
+        num_obs_percentages[j]++;
+      }
+      for (auto &it : m.types)
+        ret.types[it.first] += it.second;
+      for (auto &it : m.gced_by_type)
+        ret.gced_by_type[it.first] += it.second;
+      long double user_bandwidth =
+          m.total_user_data_reads + m.total_user_data_writes;
+      total_user_bandwidth += user_bandwidth;
+      for (auto &it : m.cost_by_ext)
+        weighted_cost[it.first] += it.second * user_bandwidth;
+      for (auto &it : m.obs_by_ext_types)
+        weighted_obs[it.first] += it.second * m.total_used_space;
+    }
+    for (size_t j = 0; j < ret.obs_percentages.size(); j++)
+      ret.obs_percentages[j] /= num_obs_percentages[j];
+    if (total_user_bandwidth > 0)
+      for (auto &it : weighted_cost)
+        ret.cost_by_ext[it.first] = it.second / total_user_bandwidth;
+    if (ret.total_used_space > 0)
+      for (auto &it : weighted_obs)
+        ret.obs_by_ext_types[it.first] = it.second / ret.total_used_space;
+
+    if (ret.total_reclaimed_space > 0)
+      ret.gc_amplification = ret.total_gc_bandwidth / ret.total_reclaimed_space;
+    if (total_user_bandwidth > 0)
+      ret.gc_ratio = ret.total_gc_bandwidth / total_user_bandwidth;
+    if (total_gc_budget > 0)
+      ret.gc_budget_utilization = total_gc_traffic / total_gc_budget;
+    if (sampled())
+      scale_to_lanes(ret);
+    return ret;
+  }
+
+  /*
+   * Scales the sizes and traffic summed over the sampled lanes up to all
+   * the lanes and adds the error bounds of the estimates. Totals use the
+   * variance of the lane totals, ratios that of the ratio estimator, both
+   * with the finite population correction for sampling without
+   * replacement. Bounds need at least two sampled lanes.
+   */
+  void scale_to_lanes(sim_metric &ret) {
+    double m = shards.size();
+    double scale = num_lanes / m;
+    ret.total_obsolete *= scale;
+    ret.total_used_space *= scale;
+    ret.total_reclaimed_space *= scale;
+    ret.parity_reads *= scale;
+    ret.parity_writes *= scale;
+    ret.total_user_data_reads *= scale;
+    ret.total_user_data_writes *= scale;
+    ret.total_gc_bandwidth *= scale;
+    ret.total_bandwidth *= scale;
+    ret.total_absent_data_reads *= scale;
+    ret.total_obsolete_data_reads *= scale;
+    ret.total_pool_to_parity_calculator *= scale;
+    ret.total_parity_calculator_to_storage_node *= scale;
+    ret.total_storage_node_to_parity_calculator *= scale;
+    ret.num_objs *= scale;
+    ret.num_exts *= scale;
+    ret.num_stripes *= scale;
+    ret.dc_size *= scale;
+    ret.total_leftovers *= scale;
+    ret.ave_exts_gced *= scale;
+    ret.max_gc_backlog *= scale;
+    for (auto &it : ret.types)
+      it.second *= scale;
+    for (auto &it : ret.gced_by_type)
+      it.second *= scale;
+    ret.num_lanes = num_lanes;
+    ret.sampled_lanes = shards.size();
+    if (m < 2)
+      return;
+
+    double fpc = 1 - m / num_lanes;
+    auto total_bound = [&](auto field) {
+      vector<double> x;
+      for (auto &s : shard_metrics)
+        x.push_back(s.*field);
+      double mean = 0, var = 0;
+      for (double v : x)
+        mean += v / m;
+      for (double v : x)
+        var += (v - mean) * (v - mean) / (m - 1);
+      return 1.96 * num_lanes * std::sqrt(fpc * var / m);
+    };
+    auto ratio_bound = [&](double ratio, auto num, auto den) {
+      double mean_den = 0, var = 0;
+      for (auto &s : shard_metrics) {
+        mean_den += den(s) / m;
+        var += std::pow(num(s) - ratio * den(s), 2) / (m - 1);
+      }
+      if (mean_den <= 0)
+        return 0.0;
+      return 1.96 * std::sqrt(fpc * var / m) / mean_den;
+    };
+    auto user_bandwidth = [](const sim_metric &s) {
+      return s.total_user_data_reads + s.total_user_data_writes;
+    };
+    ret.error_bounds["gc ratio"] = ratio_bound(
+        ret.gc_ratio,
+        [](const sim_metric &s) { return (double)s.total_gc_bandwidth; },
+        user_bandwidth);
+    ret.error_bounds["gc amplification"] = ratio_bound(
+        ret.total_reclaimed_space > 0
+            ? ret.total_gc_bandwidth / ret.total_reclaimed_space
+            : 0,
+        [](const sim_metric &s) { return (double)s.total_gc_bandwidth; },
+        [](const sim_metric &s) { return s.total_reclaimed_space; });
+    ret.error_bounds["obsolete percentage"] =
+        100 * ratio_bound(
+                  ret.total_used_space > 0
+                      ? (double)ret.total_obsolete / ret.total_used_space
+                      : 0,
+                  [](const sim_metric &s) { return (double)s.total_obsolete; },
+                  [](const sim_metric &s) {
+                    return (double)s.total_used_space;
+                  });
+    ret.error_bounds["gc bandwidth"] =
+        total_bound(&sim_metric::total_gc_bandwidth);
+    ret.error_bounds["reclaimed space"] =
+        total_bound(&sim_metric::total_reclaimed_space);
+    ret.error_bounds["dc size"] = total_bound(&sim_metric::dc_size);
+  }
+
+  /*
+   * Returns how unevenly the shards ended up with the given per-shard
+   * metric, e.g. dc_size or total_gc_bandwidth.
+   */
+  template <typename T> shard_imbalance imbalance(T sim_metric::*field) {
+    vector<double> values;
+    for (auto &m : shard_metrics)
+      values.push_back(m.*field);
+    return get_imbalance(values);
+  }
+
+  void print_imbalance() {
+    auto print = [](const char *name, shard_imbalance s) {
+      printf("Shard %s: mean %.4e, min %.4e, max %.4e, cv %.4f, max/mean "
+             "%.4f\n",
+             name, s.mean, s.min, s.max, s.cv, s.max_over_mean);
+    };
+    print("dc size", imbalance(&sim_metric::dc_size));
+    print("gc bandwidth", imbalance(&sim_metric::total_gc_bandwidth));
+    print("user writes", imbalance(&sim_metric::total_user_data_writes));
+    print("objects", imbalance(&sim_metric::num_objs));
+  }
+};
+
+#endif // __SHARDED_DATA_CENTER_H_
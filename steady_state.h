@@ -0,0 +1,124 @@
+#ifndef __STEADY_STATE_H_
+#define __STEADY_STATE_H_
+
+#include <cmath>
+#include <deque>
+
+// Steady-state value of a metric and the half-width of its 95% confidence
+// interval
+struct steady_state_estimate {
+  double mean = 0;
+  double error = 0;
+};
+
+struct steady_state_result {
+  bool converged = false;
+  // Simulated day the run converged on
+  double time = 0;
+  steady_state_estimate obs_perc;
+  // GC bandwidth per byte of user writes
+  steady_state_estimate gc_ratio;
+};
+
+/*
+ * Watches the per-cycle obsolete percentage and GC bandwidth per user byte
+ * of a run for convergence with the method of batch means. The cycles are
+ * grouped into windows of window_cycles cycles and the last num_windows
+ * window means are kept. The run has converged once, for both metrics, the
+ * 95% confidence interval of the mean of the windows and the difference
+ * between the older and the newer half of the windows are both within
+ * tolerance of the mean.
+ *
+ * Windows should be long enough for their means to be roughly independent,
+ * e.g. a week of cycles.
+ */
+class SteadyStateMonitor {
+  int window_cycles, num_windows;
+  double tolerance;
+  float min_time;
+
+  // Current window
+  int cycles = 0;
+  double obs_sum = 0, gc_sum = 0, user_sum = 0;
+
+  std::deque<double> obs_means, gc_ratios;
+  steady_state_result res;
+
+  static steady_state_estimate estimate(const std::deque<double> &means) {
+    steady_state_estimate est;
+    double n = means.size();
+    for (double m : means)
+      est.mean += m;
+    est.mean /= n;
+    double var = 0;
+    for (double m : means)
+      var += (m - est.mean) * (m - est.mean);
+    var /= n - 1;
+    est.error = 1.96 * std::sqrt(var / n);
+    return est;
+  }
+
+  bool stable(const std::deque<double> &means,
+              const steady_state_estimate &est) {
+    size_t half = means.size() / 2;
+    double older = 0, newer = 0;
+    for (size_t i = 0; i < half; i++) {
+      older += means[i];
+      newer += means[means.size() - 1 - i];
+    }
+    double bound = tolerance * std::abs(est.mean);
+    return est.error <= bound && std::abs(newer - older) / half <= bound;
+  }
+
+public:
+  /*
+   * Cycles before min_time are ignored, as the data center is still
+   * filling up.
+   */
+  SteadyStateMonitor(int window_cycles, int num_windows = 8,
+                     double tolerance = 0.02, float min_time = 30)
+      : window_cycles(window_cycles > 0 ? window_cycles : 1),
+        num_windows(num_windows > 2 ? num_windows : 2), tolerance(tolerance),
+        min_time(min_time) {}
+
+  /*
+   * Adds the metrics of the cycle ending at time and returns whether the
+   * run has converged.
+   */
+  bool add_cycle(double time, double obs_perc, double gc_bandwidth,
+                 double user_bytes) {
+    if (res.converged || time < min_time || obs_perc < 0)
+      return res.converged;
+    obs_sum += obs_perc;
+    gc_sum += gc_bandwidth;
+    user_sum += user_bytes;
+    if (++cycles < window_cycles)
+      return false;
+
+    obs_means.push_back(obs_sum / cycles);
+    gc_ratios.push_back(user_sum > 0 ? gc_sum / user_sum : 0);
+    cycles = 0;
+    obs_sum = gc_sum = user_sum = 0;
+    if ((int)obs_means.size() > num_windows) {
+      obs_means.pop_front();
+      gc_ratios.pop_front();
+    }
+    if ((int)obs_means.size() < num_windows)
+      return false;
+
+    res.obs_perc = estimate(obs_means);
+    res.gc_ratio = estimate(gc_ratios);
+    if (stable(obs_means, res.obs_perc) && stable(gc_ratios, res.gc_ratio)) {
+      res.converged = true;
+      res.time = time;
+    }
+    return res.converged;
+  }
+
+  bool converged() { return res.converged; }
+
+  // Estimates over the last windows, whether the run converged or not
+  steady_state_result result() { return res; }
+};
+
+#endif // __STEADY_STATE_H_
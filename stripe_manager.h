@@ -1,7 +1,10 @@
 #pragma once
 #include "config.h"
 #include "extent_object_stripe.h"
+#include "memory_accounting.h"
+#include "placement.h"
 #include <cstdio>
+#include <memory>
 #include <set>
 // get_extents(stripe id) not used anywhere not implemented
 // member variable ext_size_to_stripes not used anywhere not implemented
@@ -17,6 +20,10 @@ public:
   int num_data_exts_per_stripe;
   float coding_overhead;
   int max_id;
+  // Data capacity of the stripes, kept up to date as stripes come and go
+  capacity_t data_size = 0;
+  // Places the extents of new stripes on storage nodes when set
+  std::shared_ptr<StorageNodes> nodes;
 
   StripeManager(int num_data_extents, float num_local_parities,
                 float num_global_parities, int num_localities_in_stripe,
@@ -41,14 +48,7 @@ public:
     }
   }
 
-  double get_data_dc_size() {
-    long dc_size = 0;
-    for (auto stripe : *stripes) {
-      dc_size += stripe->ext_size * num_data_exts_per_stripe;
-    }
-    // fprintf(stderr, "dc size: %f %d\n", configtime, dc_size);
-    return dc_size;
-  }
+  double get_data_dc_size() { return data_size; }
 
   double get_total_dc_size() {
     // fprintf(stderr, "dc total size: %f %f coding overhead: %f\n", configtime,
@@ -58,7 +58,21 @@ public:
 
   int get_num_stripes() { return stripes->size(); }
 
-  stripe_ptr create_new_stripe(int ext_size) {
+  mem_usage memory_usage() {
+    mem_usage ret;
+    ret.count = stripes->size();
+    ret.bytes = mem_size::of(*stripes);
+    for (auto &s : *stripes)
+      ret.bytes += mem_size::shared_block + sizeof(Stripe) +
+                   mem_size::of(s->localities) + mem_size::of(s->slots) +
+                   mem_size::of(s->free_slots) +
+                   mem_size::of(s->locality_obsolete) +
+                   mem_size::of(s->locality_valid) + mem_size::of(s->nodes) +
+                   mem_size::of(s->ftl_extents);
+    return ret;
+  }
+
+  stripe_ptr create_new_stripe(capacity_t ext_size) {
     // not translated if block since ext_size local variable cant be found
     // or assigned anywhere else in stripe manager object!! if (ext_size is
     // None):
@@ -66,10 +80,18 @@ public:
     stripe_ptr stripe = make_shared<Stripe>(max_id++, num_data_exts_per_locality,
                                 num_localities_in_stripe, ext_size, 15);
     stripes->insert(stripe);
+    data_size += ext_size * num_data_exts_per_stripe;
+    if (nodes)
+      nodes->place_stripe(*stripe, num_exts_per_stripe);
     return stripe;
   }
 
   void delete_stripe(stripe_ptr stripe) {
+    if (!stripes->count(stripe))
+      return;
+    if (nodes)
+      nodes->release_stripe(*stripe);
+    data_size -= stripe->ext_size * num_data_exts_per_stripe;
     stripes->erase(stripe);
   }
 };
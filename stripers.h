@@ -1,15 +1,17 @@
 #pragma once
 #include "extent_manager.h"
 #include "extent_stack.h"
+#include "profiler.h"
 #include "stripe_manager.h"
 #include <array>
+#include <cmath>
 #include <memory>
 
 using std::shared_ptr;
 typedef struct stripe_costs {
   int stripes;
-  int reads;
-  int writes;
+  capacity_t reads;
+  capacity_t writes;
 
   stripe_costs &operator+=(const stripe_costs &rhs) {
     this->stripes += rhs.stripes;
@@ -20,15 +22,85 @@ typedef struct stripe_costs {
 } str_costs;
 
 typedef struct replacement_costs {
-  double global_parity_reads;
-  double global_parity_writes;
-  int local_parity_reads;
-  int local_parity_writes;
-  int obsolete_data_reads;
-  int valid_obj_reads;
-  int absent_data_reads;
+  capacity_t global_parity_reads;
+  capacity_t global_parity_writes;
+  capacity_t local_parity_reads;
+  capacity_t local_parity_writes;
+  capacity_t obsolete_data_reads;
+  capacity_t valid_obj_reads;
+  capacity_t absent_data_reads;
 } repl_costs;
 
+/*
+ * Data dependent part of the cost of replacing some of the extents of a
+ * stripe. The stripe GC fills it in one locality at a time while it walks
+ * the stripe, so it needs no per-locality storage.
+ */
+struct repl_data {
+  int exts_replaced = 0;
+  // Localities with all or only some of their extents replaced
+  int full_localities = 0;
+  int partial_localities = 0;
+  // Obsolete and valid data of the replaced extents
+  capacity_t obsolete = 0;
+  capacity_t valid = 0;
+
+  void add_locality(int num_exts, int num_exts_per_locality) {
+    exts_replaced += num_exts;
+    full_localities += num_exts == num_exts_per_locality;
+    partial_localities += num_exts > 0 && num_exts < num_exts_per_locality;
+  }
+
+  int localities_replaced() const {
+    return full_localities + partial_localities;
+  }
+};
+
+/*
+ * Parity side of the replacement costs for one stripe shape, in extents.
+ * It only depends on how many localities have all or some of their extents
+ * replaced, so it is worked out once per pattern when the striper is
+ * created and looked up for every stripe GC.
+ */
+class ReplCostTable {
+public:
+  struct entry {
+    float global_parity_reads;
+    float global_parity_writes;
+    float local_parity_reads;
+    float local_parity_writes;
+    // 1 if the old data of the replaced extents has to be read, 0 if the
+    // whole stripe is rewritten
+    int data_reads;
+  };
+
+  ReplCostTable(const StripeManager &s_m)
+      : num_localities(s_m.num_localities_in_stripe) {
+    int n = num_localities + 1;
+    entries.resize(n * n);
+    for (int full = 0; full < n; full++) {
+      for (int partial = 0; full + partial < n; partial++) {
+        entry &e = entries[full * n + partial];
+        if (full == num_localities) {
+          e = {0, s_m.num_global_parities, 0, s_m.num_local_parities, 0};
+        } else {
+          e = {s_m.num_global_parities, s_m.num_global_parities,
+               (float)partial, (float)(full + partial), 1};
+        }
+      }
+    }
+  }
+
+  const entry &lookup(const repl_data &data) const {
+    return entries[data.full_localities * (num_localities + 1) +
+                   data.partial_localities];
+  }
+
+private:
+  int num_localities = 0;
+  vector<entry> entries;
+};
+
 class AbstractStriper {
 public:
   shared_ptr<StripeManager> stripe_manager;
@@ -50,20 +122,30 @@ public:
     std::cerr << "virtual create_stripes should never happen";
     return str_costs();
   };
-  virtual repl_costs cost_to_replace_extents(int ext_size,
+  virtual repl_costs cost_to_replace_extents(capacity_t ext_size,
                                              int exts_per_locality,
-                                             double obs_data_per_locality) {
+                                             capacity_t obs_data_per_locality) {
     std::cerr << "virtual cost_to_replace_extents should never happen";
     return repl_costs();
   };
-  virtual repl_costs
-  cost_to_replace_extents(int ext_size, vector<int> exts_per_locality,
-                          vector<int> obs_data_per_locality,
-                          vector<int> valid_objs_per_locality) {
+  virtual repl_costs cost_to_replace_extents(capacity_t ext_size,
+                                             const repl_data &data) {
     std::cerr << "virtual cost_to_replace_extents should never happen";
     return repl_costs();
   };
-  virtual double cost_to_write_data(int data) = 0;
+  // Same as cost_to_replace_extents, for extents that are not replaced yet
+  virtual repl_costs estimate_replacement_costs(capacity_t ext_size,
+                                                const repl_data &data) {
+    std::cerr << "virtual estimate_replacement_costs should never happen";
+    return repl_costs();
+  };
+  /*
+   * Counts a replacement costed with estimate_replacement_costs towards how
+   * often each way of replacing extents was used, as cost_to_replace_extents
+   * does.
+   */
+  virtual void count_replacement(capacity_t ext_size, const repl_data &data) {}
+  virtual capacity_t cost_to_write_data(capacity_t data) = 0;
   virtual int num_stripes_reqd() = 0;
 };
 
@@ -74,11 +156,11 @@ public:
   int num_stripes_reqd() override { return 1; }
   str_costs create_stripes(shared_ptr<AbstractExtentStack> extent_stack,
                            float simulation_time) override {
-    
+    PROFILE_PHASE(Phase::CreateStripes);
     int num_exts = stripe_manager->num_data_exts_per_stripe;
     // std::cout << "num_exts create_stripes simple " << num_exts << std::endl;
-    int writes = 0;
-    int reads = 0;
+    capacity_t writes = 0;
+    capacity_t reads = 0;
     int stripes = 0;
     list<ext_ptr > exts_to_stripe = extent_stack->pop_stripe_num_exts(num_exts);
     stripe_ptr current_stripe =
@@ -95,12 +177,13 @@ public:
     return {stripes, reads, writes};
   }
 
-  repl_costs cost_to_replace_extents(int ext_size, int exts_per_locality,
-                                     double obs_data_per_locality) override {
+  repl_costs
+  cost_to_replace_extents(capacity_t ext_size, int exts_per_locality,
+                          capacity_t obs_data_per_locality) override {
     repl_costs costs = {0, 0, 0, 0, 0, 0, 0};
     return costs;
   }
-  double cost_to_write_data(int data) override { return data; }
+  capacity_t cost_to_write_data(capacity_t data) override { return data; }
 };
 
 class AbstractStriperDecorator : public AbstractStriper {
@@ -114,16 +197,19 @@ public:
   virtual str_costs create_stripe(shared_ptr<AbstractExtentStack> extent_stack,
                                   float simulation_time) = 0;
 
-  virtual repl_costs
-  cost_to_replace_extents(int ext_size, vector<int> exts_per_locality,
-                          vector<int> obs_data_per_locality,
-                          vector<int> valid_objs_per_locality) {
+  virtual repl_costs cost_to_replace_extents(capacity_t ext_size,
+                                             const repl_data &data) {
     return repl_costs();
   }
 
-  virtual repl_costs cost_to_replace_extents(int ext_size,
+  virtual repl_costs estimate_replacement_costs(capacity_t ext_size,
+                                                const repl_data &data) {
+    return repl_costs();
+  }
+
+  virtual repl_costs cost_to_replace_extents(capacity_t ext_size,
                                              int exts_per_locality,
-                                             double obs_data_per_locality) {
+                                             capacity_t obs_data_per_locality) {
     return repl_costs();
   };
 };
@@ -152,12 +238,13 @@ public:
     return total;
   }
 
-  repl_costs cost_to_replace_extents(int ext_size, int exts_per_locality,
-                                     double obs_data_per_locality) override {
+  repl_costs
+  cost_to_replace_extents(capacity_t ext_size, int exts_per_locality,
+                          capacity_t obs_data_per_locality) override {
     return striper->cost_to_replace_extents(ext_size, exts_per_locality,
                                             obs_data_per_locality);
   }
-  double cost_to_write_data(int data) override { return data; }
+  capacity_t cost_to_write_data(capacity_t data) override { return data; }
 };
 
 class NumStripesStriper : public AbstractStriperDecorator {
@@ -181,22 +268,53 @@ public:
     return striper->create_stripes(extent_stack, simulation_time);
   }
 
-  repl_costs cost_to_replace_extents(int ext_size, int exts_per_locality,
-                                     double obs_data_per_locality) override {
+  repl_costs
+  cost_to_replace_extents(capacity_t ext_size, int exts_per_locality,
+                          capacity_t obs_data_per_locality) override {
     return striper->cost_to_replace_extents(ext_size, exts_per_locality,
                                             obs_data_per_locality);
   }
-  double cost_to_write_data(int data) override { return data; }
+  capacity_t cost_to_write_data(capacity_t data) override { return data; }
 };
 
 class StriperWithEC : public AbstractStriperDecorator {
 
 protected:
   shared_ptr<AbstractStriper> striper;
+  ReplCostTable repl_table;
+
+  /*
+   * Costs of the default way of replacing extents, which updates the
+   * parities of the stripe from the old and new data of the replaced
+   * extents.
+   */
+  repl_costs default_repl_costs(capacity_t ext_size, const repl_data &data,
+                                const ReplCostTable::entry &e) {
+    repl_costs costs;
+    // Parity counts may be fractional, so their sizes are rounded
+    costs.global_parity_reads = std::llround(e.global_parity_reads * ext_size);
+    costs.global_parity_writes =
+        std::llround(e.global_parity_writes * ext_size);
+    costs.local_parity_reads = std::llround(e.local_parity_reads * ext_size);
+    costs.local_parity_writes = std::llround(e.local_parity_writes * ext_size);
+    costs.obsolete_data_reads = e.data_reads * data.obsolete;
+    costs.valid_obj_reads = e.data_reads * data.valid;
+    costs.absent_data_reads = 0;
+    return costs;
+  }
+
+  // Replacement costs, and whether they are from the default way
+  virtual repl_costs replacement_costs(capacity_t ext_size,
+                                       const repl_data &data,
+                                       bool &is_default) {
+    is_default = true;
+    return default_repl_costs(ext_size, data, repl_table.lookup(data));
+  }
 
 public:
   StriperWithEC(shared_ptr<AbstractStriper> s)
-      : AbstractStriperDecorator(s), striper(s) {}
+      : AbstractStriperDecorator(s), striper(s),
+        repl_table(*s->stripe_manager) {}
 
   int num_stripes_reqd() override { return striper->num_stripes_reqd(); }
 
@@ -213,119 +331,69 @@ public:
     res.writes *= stripe_manager->coding_overhead;
     return res;
   }
-  repl_costs
-  cost_to_replace_extents(int ext_size, vector<int> exts_per_locality,
-                          vector<int> obs_data_per_locality,
-                          vector<int> valid_objs_per_locality) override {
-    repl_costs costs = {0, 0, 0, 0, 0, 0, 0};
-    int total_exts_replaced = 0;
-    for (int i = 0; i < exts_per_locality.size(); i++) {
-      total_exts_replaced += exts_per_locality[i];
-    }
-    if (total_exts_replaced == stripe_manager->num_data_exts_per_stripe) {
-      costs.global_parity_writes =
-          stripe_manager->num_global_parities * ext_size;
-      costs.local_parity_writes = stripe_manager->num_local_parities * ext_size;
-      return costs;
-    }
-    int num_exts_per_locality = stripe_manager->num_data_exts_per_locality;
-    for (int i = 0; i < obs_data_per_locality.size(); i++) {
-      int num_exts = exts_per_locality[i];
-      if (num_exts == num_exts_per_locality) {
-        costs.valid_obj_reads += valid_objs_per_locality[i];
-
-        // read in obsolete data - needed for updating global parities
-        costs.obsolete_data_reads += obs_data_per_locality[i];
-        // compute new parity block and write it out
-        costs.local_parity_writes += ext_size;
-      } // replacing some extents in locality
-      else if (num_exts != 0) {
-        costs.valid_obj_reads += valid_objs_per_locality[i];
-        costs.obsolete_data_reads += obs_data_per_locality[i];
-        costs.local_parity_reads += ext_size;
-        costs.local_parity_writes += ext_size;
-      }
-    }
-    costs.global_parity_reads +=
-          stripe_manager->num_global_parities * ext_size;
-    costs.global_parity_writes +=
-          stripe_manager->num_global_parities * ext_size;
-    num_times_default += 1;
-    return costs;
+
+  /*
+   * The estimate does not count towards how often each way of replacing
+   * extents was used.
+   */
+  repl_costs estimate_replacement_costs(capacity_t ext_size,
+                                        const repl_data &data) override {
+    bool is_default;
+    return replacement_costs(ext_size, data, is_default);
   }
-  double cost_to_write_data(int data) override { return data; }
+
+  repl_costs cost_to_replace_extents(capacity_t ext_size,
+                                     const repl_data &data) override {
+    count_replacement(ext_size, data);
+    return estimate_replacement_costs(ext_size, data);
+  }
+
+  void count_replacement(capacity_t ext_size, const repl_data &data) override {
+    // Rewriting the whole stripe is not counted either way
+    if (!repl_table.lookup(data).data_reads)
+      return;
+    bool is_default;
+    replacement_costs(ext_size, data, is_default);
+    if (is_default)
+      num_times_default += 1;
+    else
+      num_times_alternatives += 1;
+  }
+  capacity_t cost_to_write_data(capacity_t data) override { return data; }
 };
 
 class EfficientStriperWithEC : public StriperWithEC {
+public:
   using StriperWithEC::StriperWithEC;
 
-  repl_costs
-  cost_to_replace_extents(int ext_size, vector<int> exts_per_locality,
-                          vector<int> obs_data_per_locality,
-                          vector<int> valid_objs_per_locality) override {
-    repl_costs costs = {0, 0, 0, 0, 0, 0, 0};
-    int str1_ec_reads = 0;
-    int total_exts_replaced = 0;
-    for (int i = 0; i < exts_per_locality.size(); i++) {
-      total_exts_replaced += exts_per_locality[i];
-    }
-    if (total_exts_replaced == stripe_manager->num_data_exts_per_stripe) {
-      costs.global_parity_writes =
-          stripe_manager->num_global_parities * ext_size;
-      costs.local_parity_writes = stripe_manager->num_local_parities * ext_size;
-      return costs;
-    }
-    int num_exts_per_locality = stripe_manager->num_data_exts_per_locality;
-    for (int i = 0; i < obs_data_per_locality.size(); i++) {
-      int num_exts = exts_per_locality[i];
-      // whole locality is replaced
-      if (num_exts == num_exts_per_locality) {
-        costs.valid_obj_reads += valid_objs_per_locality[i];
-        // read in obsolete data - needed for updating global parities
-        costs.obsolete_data_reads += obs_data_per_locality[i];
-        // compute new parity block and write it out
-        costs.local_parity_writes += ext_size;
-      }
-      // replacing some extents in locality
-      else if (num_exts != 0) {
-        costs.valid_obj_reads += valid_objs_per_locality[i];
-
-        // read in obsolete data
-        costs.obsolete_data_reads += obs_data_per_locality[i];
-        // read in parity
-        costs.local_parity_reads += ext_size;
-
-        // in this strategy read in the extents not being gc'ed instead
-        // and recompute the parities from scratch
-        costs.absent_data_reads +=
-            (num_exts_per_locality - num_exts) * ext_size;
-
-        // recompute and write out parity
-        costs.local_parity_writes += ext_size;
-      } else if (num_exts == 0) {
-        // need to bring in the extents from any locality not gc'ed to
-        // compute global parities
-        costs.absent_data_reads += (num_exts_per_locality)*ext_size;
-      }
-    }
-
-    costs.global_parity_reads += stripe_manager->num_global_parities * ext_size;
-    costs.global_parity_writes +=
-        stripe_manager->num_global_parities * ext_size;
-    str1_ec_reads = costs.global_parity_reads + costs.obsolete_data_reads +
-                    costs.local_parity_reads;
-
-    if (str1_ec_reads < costs.absent_data_reads) {
-      num_times_default += 1;
-      costs.absent_data_reads = 0;
+protected:
+  /*
+   * Instead of updating the parities, this striper may read in the extents
+   * that are not replaced and recompute the parities from scratch, which
+   * it does whenever that reads less than the default.
+   */
+  repl_costs replacement_costs(capacity_t ext_size, const repl_data &data,
+                               bool &is_default) override {
+    const ReplCostTable::entry &e = repl_table.lookup(data);
+    repl_costs costs = default_repl_costs(ext_size, data, e);
+    is_default = true;
+    if (!e.data_reads)
       return costs;
-    } else {
-      num_times_alternatives += 1;
-      costs.global_parity_reads = 0;
-      costs.local_parity_reads = 0;
-      costs.obsolete_data_reads = 0;
-      costs.valid_obj_reads = 0;
+    capacity_t str1_ec_reads = costs.global_parity_reads +
+                               costs.obsolete_data_reads +
+                               costs.local_parity_reads;
+    capacity_t absent_data_reads =
+        (capacity_t)(stripe_manager->num_data_exts_per_stripe -
+                     data.exts_replaced) *
+        ext_size;
+    if (str1_ec_reads < absent_data_reads)
       return costs;
-    }
+    is_default = false;
+    costs.global_parity_reads = 0;
+    costs.local_parity_reads = 0;
+    costs.obsolete_data_reads = 0;
+    costs.valid_obj_reads = 0;
+    costs.absent_data_reads = absent_data_reads;
+    return costs;
   }
 };
@@ -5,10 +5,69 @@
 #include "object_packer.h"
 #include "stripe_manager.h"
 #include "stripers.h"
+#include <algorithm>
 #include <any>
 #include <memory>
 using std::array;
+
+/*
+ * Objects that survived the deletion of their sealed extent and still have
+ * to be repacked. A surviving object is kept once, with the sizes it had in
+ * all the deleted extents summed up.
+ */
+class PendingRepack {
+  object_lst objs;
+  unordered_map<obj_ptr, size_t> index;
+
+public:
+  void add(const object_lst &lst) {
+    for (auto &record : lst) {
+      auto it = index.find(record.first);
+      if (it != index.end()) {
+        objs[it->second].second += record.second;
+      } else {
+        index.emplace(record.first, objs.size());
+        objs.push_back(record);
+      }
+    }
+  }
+
+  void drop(const obj_ptr &obj) {
+    if (index.empty())
+      return;
+    auto it = index.find(obj);
+    if (it == index.end())
+      return;
+    // Keep the slot so the other indices stay valid, pack skips it
+    objs[it->second].first = nullptr;
+    index.erase(it);
+  }
+
+  bool empty() { return index.empty(); }
+
+  void pack(const shared_ptr<SimpleObjectPacker> &packer,
+            const shared_ptr<AbstractExtentStack> &extent_stack) {
+    if (!index.empty()) {
+      objs.erase(std::remove_if(objs.begin(), objs.end(),
+                                [](const obj_record &record) {
+                                  return record.first == nullptr;
+                                }),
+                 objs.end());
+      packer->add_objs(objs);
+      auto temp = std::set<obj_ptr>();
+      packer->pack_objects(extent_stack, temp);
+    }
+    // Keep the capacity for the next cycle
+    objs.clear();
+    index.clear();
+  }
+};
+
 class StripingProcessCoordinator {
+  PendingRepack pending_repack, pending_gc_repack;
+  // Reused by del_sealed_extent to avoid a new list per deleted extent
+  object_lst sealed_objs;
+
 public:
   shared_ptr<SimpleObjectPacker> object_packer;
   shared_ptr<SimpleObjectPacker> gc_object_packer;
@@ -30,10 +89,14 @@ public:
         gc_striper(gc_s), extent_stack(e_s), gc_extent_stack(gc_e_s),
         stripe_manager(s_m), simulation_time(s_t) {}
 
-  void gc_extent(ext_ptr ext, std::set<obj_ptr> objs) {
+  void gc_extent(const ext_ptr &ext, std::set<obj_ptr> &objs) {
     gc_object_packer->gc_extent(ext, gc_extent_stack, objs);
   }
 
+  void gc_objects(const object_lst &records, std::set<obj_ptr> &objs) {
+    gc_object_packer->gc_objects(records, gc_extent_stack, objs);
+  }
+
   virtual ext_ptr get_gc_extent(float key = 0) {
     if (gc_extent_stack->get_length_at_key(key) > 0) {
       return gc_extent_stack->get_extent_at_key(key);
@@ -65,6 +128,16 @@ public:
     // std::cout << "generating stripes" << std::endl;
     return stripe_generator(striper, object_packer, extent_stack);
   }
+  /*
+   * Whether generate_stripes would leave the data center unchanged, i.e. the
+   * object packer has no objects to add and the extent stack does not have
+   * enough extents for a stripe.
+   */
+  bool striping_idle() {
+    return striper->num_stripes_reqd() == 0 && object_packer->idle() &&
+           !extent_stack->num_stripes(
+               stripe_manager->num_data_exts_per_stripe);
+  }
   str_costs generate_gc_stripes() {
     // std::cout << "generating gc stripes" << std::endl;
     return stripe_generator(gc_striper, gc_object_packer, gc_extent_stack);
@@ -75,21 +148,44 @@ public:
   int get_length_gc_extent_stack() {
     return gc_extent_stack->get_length_of_extent_stack();
   }
-  void del_sealed_extent(ext_ptr extent) {
-    auto objs = extent->delete_ext();
-    auto temp = std::set<obj_ptr>();
+  /*
+   * Tears down a sealed extent that lost one of its objects. The surviving
+   * objects are not repacked right away but kept until
+   * repack_sealed_extents, so that all the extents invalidated during one
+   * deletion phase are repacked together.
+   */
+  void del_sealed_extent(const ext_ptr &extent) {
+    sealed_objs.clear();
+    extent->delete_ext(sealed_objs);
     if (extent_stack->contains_extent(extent)) {
       extent_stack->remove_extent(extent);
-      object_packer->add_objs(objs);
-      object_packer->pack_objects(extent_stack, temp);
+      pending_repack.add(sealed_objs);
     } else if (gc_extent_stack->contains_extent(extent)) {
       gc_extent_stack->remove_extent(extent);
-      gc_object_packer->add_objs(objs);
-      gc_object_packer->pack_objects(gc_extent_stack, temp);
+      pending_gc_repack.add(sealed_objs);
     }
   }
 
-  bool extent_in_extent_stacks(ext_ptr extent) {
+  /*
+   * Has to be called for every deleted object, so that the object is not
+   * repacked if it was waiting for its sealed extent to be repacked.
+   */
+  void object_deleted(const obj_ptr &obj) {
+    pending_repack.drop(obj);
+    pending_gc_repack.drop(obj);
+  }
+
+  /*
+   * Packs the survivors of all the sealed extents deleted since the last
+   * call, once per packer. Survivors coming from several extents are
+   * packed back to back, so that they fill as few new extents as possible.
+   */
+  void repack_sealed_extents() {
+    pending_repack.pack(object_packer, extent_stack);
+    pending_gc_repack.pack(gc_object_packer, gc_extent_stack);
+  }
+
+  bool extent_in_extent_stacks(const ext_ptr &extent) {
     return extent_stack->contains_extent(extent) ||
            gc_extent_stack->contains_extent(extent);
   }
@@ -116,7 +212,7 @@ public:
   }
   void generate_exts() { gc_object_packer->generate_exts(); }
 
-  void generate_objs(int space) { gc_object_packer->generate_objs(space); };
+  void generate_objs(capacity_t space) { gc_object_packer->generate_objs(space); };
 
   void pack_exts(int num_exts, int key = 0) {
     object_packer->generate_exts_at_key(extent_stack, num_exts, key);
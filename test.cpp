@@ -1,4 +1,5 @@
 #include "configs.h"
+#include "device_model.h"
 #include "extent_manager.h"
 #include "extent_object_stripe.h"
 #include "extent_stack.h"
@@ -6,7 +7,11 @@
 #include "stripe_manager.h"
 #include "stripers.h"
 #include "gc_strategies.h"
+#include "sharded_data_center.h"
+#include "what_if.h"
 #include "gtest/gtest.h"
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <memory>
 
@@ -23,6 +28,25 @@ TEST(SamplerTest, SanityCheckSampler1Value) {
   EXPECT_EQ(l.front(), 6.0);
 }
 
+TEST(SamplerTest, PipelinedSamplesMatchStream) {
+  auto sampler = make_shared<SimpleSampler>(365);
+  SampleStream stream(sampler, 42);
+  // A small ring makes the producer wait on the consumer many times
+  PipelinedSampleSource pipeline(sampler, 42, 64);
+  for (int i = 0; i < 100000; i++) {
+    // The sequence carries on while the producer is paused
+    if (i % 20000 == 10000)
+      pipeline.pause();
+    else if (i % 20000 == 15000)
+      pipeline.resume();
+    obj_sample expected = stream.next();
+    obj_sample s = pipeline.next();
+    ASSERT_EQ(s.size, expected.size);
+    ASSERT_EQ(s.life, expected.life);
+    ASSERT_EQ(s.noise, expected.noise);
+  }
+}
+
 /****************************************
  * ObjectManager
  ****************************************/
@@ -73,6 +97,37 @@ TEST(ObjectManagerTest, DeleteObject) {
   EXPECT_EQ(o_m.get_object(0), nullptr);
 };
 
+TEST(ObjectManagerTest, SizesRoundedToWholeUnits) {
+  const int ext_size = 3 * 1024;
+  ObjectManager o_m =
+      ObjectManager(make_shared<EventManager>(),
+                    make_shared<StripeLevelSanityCheckSampler2>(365, ext_size));
+  // The sampler splits an extent into 90% and 10% sized objects
+  object_lst objs = o_m.create_new_object(1);
+  ASSERT_EQ(objs.size(), 28);
+  EXPECT_EQ(objs[0].second, 2765);
+  EXPECT_EQ(objs[1].second, 307);
+  EXPECT_EQ(objs[0].second + objs[1].second, ext_size);
+  EXPECT_EQ(objs[0].first->size, objs[0].second);
+};
+
+TEST(ObjectManagerTest, CreatesObjectsFromSampleSource) {
+  auto sampler = make_shared<SimpleSampler>(365);
+  ObjectManager o_m = ObjectManager(make_shared<EventManager>(), sampler);
+  o_m.set_sample_source(make_shared<PipelinedSampleSource>(sampler, 7));
+  SampleStream stream(sampler, 7);
+  for (int batch : {1, 50, 3}) {
+    object_lst objs = o_m.create_new_object(batch);
+    ASSERT_EQ(objs.size(), batch);
+    for (auto &record : objs) {
+      obj_sample s = stream.next();
+      EXPECT_EQ(record.second, std::llround(s.size));
+      EXPECT_FLOAT_EQ(record.first->life, s.life + (s.noise - 12) / 24.0);
+    }
+  }
+  EXPECT_EQ(o_m.get_num_objs(), 54);
+}
+
 /****************************************
  * StripeManager
  ****************************************/
@@ -113,6 +168,39 @@ TEST(StripeManagerTest, DeleteStripe) {
             s_m.stripes->end());
 };
 
+TEST(StripeManagerTest, StripeSlotsGroupedByLocality) {
+  ExtentManager e_m = ExtentManager(10, nullptr);
+  stripe_ptr s = make_shared<Stripe>(0, 2, 2, 10, 0);
+  vector<ext_ptr> exts;
+  for (int i = 0; i < 3; i++) {
+    exts.push_back(e_m.create_extent());
+    s->add_extent(exts.back());
+  }
+  EXPECT_EQ(s->first_free_slot(), 3);
+  EXPECT_EQ(exts[1]->locality, 0);
+  EXPECT_EQ(exts[2]->locality, 1);
+  EXPECT_EQ(s->locality_valid[0], 20);
+  EXPECT_EQ(s->locality_valid[1], 10);
+
+  exts[1]->obsolete_space += 4;
+  s->update_obsolete(4, exts[1]->locality);
+  EXPECT_EQ(s->obsolete, 4);
+  EXPECT_EQ(s->locality_obsolete[0], 4);
+  EXPECT_EQ(s->locality_valid[0], 16);
+
+  // A freed slot is the first to be reused
+  s->del_extent(exts[1]);
+  EXPECT_EQ(s->slots[1], nullptr);
+  EXPECT_EQ(s->obsolete, 0);
+  EXPECT_EQ(s->locality_obsolete[0], 0);
+  EXPECT_EQ(s->locality_valid[0], 10);
+  ext_ptr e = e_m.create_extent();
+  s->add_extent(e);
+  EXPECT_EQ(e->slot, 1);
+  EXPECT_EQ(s->localities[0], 2);
+  EXPECT_EQ(s->free_space, 1);
+};
+
 /****************************************
  * ExtentManager
  ****************************************/
@@ -140,6 +228,35 @@ TEST(ExtentManagerTest, DeleteExtent) {
   EXPECT_EQ(std::find(e_m.exts.begin(), e_m.exts.end(), e3), e_m.exts.end());
 };
 
+TEST(ExtentManagerTest, MemoryUsageGrowsWithObjects) {
+  ExtentManager e_m = ExtentManager(100, nullptr);
+  ext_ptr e1 = e_m.create_extent();
+  ext_ptr e2 = e_m.create_extent();
+  mem_usage before = e_m.memory_usage();
+  EXPECT_EQ(before.count, 2);
+  EXPECT_GE(before.bytes, 2 * sizeof(Extent));
+  e1->add_object(make_shared<ExtentObject>(0, 10, 1), 10);
+  mem_usage after = e_m.memory_usage();
+  EXPECT_EQ(after.count, 2);
+  EXPECT_GT(after.bytes, before.bytes);
+};
+
+TEST(ExtentManagerTest, ExtentTracksLargestObject) {
+  ExtentManager e_m = ExtentManager(100, nullptr);
+  ext_ptr e = e_m.create_extent();
+  auto o1 = make_shared<ExtentObject>(0, 30, 1);
+  auto o2 = make_shared<ExtentObject>(1, 20, 1);
+  EXPECT_EQ(e->largest_obj, -1);
+  e->add_object(o1, 30);
+  e->add_object(o2, 20);
+  e->add_object(o2, 15);
+  EXPECT_EQ(e->largest_obj, 35);
+  e->del_object(o2);
+  EXPECT_EQ(e->largest_obj, 30);
+  e->del_object(o1);
+  EXPECT_EQ(e->largest_obj, -1);
+};
+
 TEST(ExtentManagerTest, GetExtTypes) {
   ExtentManager e_m = ExtentManager(100, nullptr);
   ext_ptr e1 = e_m.create_extent(5);
@@ -581,6 +698,51 @@ TEST(StriperTest, SimpleStriperCreateStripeWithSingleExtentStack) {
   EXPECT_EQ(costs.writes, 735);
 }
 
+TEST(StripeManagerTest, StripesPlacedOnStorageNodes) {
+  // 2 localities of 2 data extents, 1 local and 1 global parity
+  StripeManager s_m = StripeManager(2, 1, 1, 2, 0);
+  s_m.nodes = make_shared<StorageNodes>(4, placement_policy::round_robin);
+  stripe_ptr s1 = s_m.create_new_stripe(10);
+  stripe_ptr s2 = s_m.create_new_stripe(10);
+  EXPECT_EQ(s1->nodes, (vector<int>{0, 1, 2, 3, 0, 1}));
+  EXPECT_EQ(s2->nodes, (vector<int>{2, 3, 0, 1, 2, 3}));
+  EXPECT_EQ(s_m.nodes->get_nodes()[0].stored, 30);
+  s_m.delete_stripe(s1);
+  EXPECT_EQ(s_m.nodes->get_nodes()[0].stored, 10);
+  EXPECT_EQ(s_m.nodes->get_nodes()[1].stored, 10);
+  EXPECT_EQ(s_m.nodes->get_nodes()[2].stored, 20);
+
+  // The data reads of a stripe GC go to its data nodes and the parity
+  // updates to its parity nodes
+  s_m.nodes->end_cycle();
+  s_m.nodes->add_gc_traffic(*s2, 30, 10, 15, 5);
+  EXPECT_EQ(s_m.nodes->end_cycle(), 20);
+  auto &nodes = s_m.nodes->get_nodes();
+  EXPECT_EQ(nodes[0].gc_traffic, 10);
+  EXPECT_EQ(nodes[1].gc_traffic, 10);
+  EXPECT_EQ(nodes[2].gc_traffic, 20);
+  EXPECT_EQ(nodes[3].gc_traffic, 20);
+  // Writing the two stripes
+  EXPECT_EQ(nodes[0].striping_traffic + nodes[1].striping_traffic +
+                nodes[2].striping_traffic + nodes[3].striping_traffic,
+            120);
+}
+
+TEST(StripeManagerTest, PlacementPolicies) {
+  StorageNodes random(10, placement_policy::random, 1);
+  vector<int> nodes = random.choose_nodes(10);
+  EXPECT_EQ(std::set<int>(nodes.begin(), nodes.end()).size(), 10);
+
+  // Load-aware placement fills up the emptiest nodes first
+  StorageNodes load_aware(6, placement_policy::load_aware);
+  Stripe s1(1, 4, 1, 10, 0), s2(2, 4, 1, 10, 0);
+  load_aware.place_stripe(s1, 4);
+  load_aware.place_stripe(s2, 4);
+  EXPECT_EQ(s1.nodes, (vector<int>{0, 1, 2, 3}));
+  EXPECT_EQ(s2.nodes, (vector<int>{4, 5, 0, 1}));
+  EXPECT_EQ(load_aware.choose_nodes(2), (vector<int>{2, 3}));
+}
+
 TEST(StriperTest, SimpleStriperCreateStripeWithMultiExtentStack) {
   int ext_size = 3*1024;
   auto s_m = make_shared<StripeManager>(7, 2, 2, 2, 0.0);
@@ -693,6 +855,132 @@ TEST(StriperTest, StriperWithECWithExtentStackRandomizer) {
   cout << total.stripes << ", " << total.reads << ", " << total.writes << endl;
 }
 
+TEST(StriperTest, ReplacementCostsFromTable) {
+  int ext_size = 100;
+  auto s_m = make_shared<StripeManager>(7, 2, 2, 2, 0.0);
+  auto e_m = make_shared<ExtentManager>(ext_size, nullptr);
+  auto striper = make_shared<StriperWithEC>(make_shared<ExtentStackStriper>(
+      make_shared<SimpleStriper>(s_m, e_m)));
+  auto efficient = make_shared<EfficientStriperWithEC>(
+      make_shared<ExtentStackStriper>(make_shared<SimpleStriper>(s_m, e_m)));
+
+  // 3 extents of the first locality, none of the second
+  repl_data some;
+  some.add_locality(3, 7);
+  some.add_locality(0, 7);
+  some.obsolete = 250;
+  some.valid = 50;
+  repl_costs costs = striper->cost_to_replace_extents(ext_size, some);
+  EXPECT_EQ(costs.global_parity_reads, 200);
+  EXPECT_EQ(costs.global_parity_writes, 200);
+  EXPECT_EQ(costs.local_parity_reads, 100);
+  EXPECT_EQ(costs.local_parity_writes, 100);
+  EXPECT_EQ(costs.obsolete_data_reads, 250);
+  EXPECT_EQ(costs.valid_obj_reads, 50);
+  EXPECT_EQ(costs.absent_data_reads, 0);
+  // Updating the parities reads 550, less than the 1100 of the rest
+  costs = efficient->cost_to_replace_extents(ext_size, some);
+  EXPECT_EQ(costs.obsolete_data_reads, 250);
+  EXPECT_EQ(costs.absent_data_reads, 0);
+
+  // All but one extent, recomputing the parities reads less
+  repl_data most;
+  most.add_locality(7, 7);
+  most.add_locality(6, 7);
+  most.obsolete = 1200;
+  costs = efficient->cost_to_replace_extents(ext_size, most);
+  EXPECT_EQ(costs.global_parity_reads, 0);
+  EXPECT_EQ(costs.local_parity_reads, 0);
+  EXPECT_EQ(costs.local_parity_writes, 200);
+  EXPECT_EQ(costs.obsolete_data_reads, 0);
+  EXPECT_EQ(costs.absent_data_reads, 100);
+  EXPECT_EQ(efficient->num_times_alternatives, 1);
+
+  // The whole stripe only writes new parities
+  repl_data all;
+  all.add_locality(7, 7);
+  all.add_locality(7, 7);
+  all.obsolete = 1400;
+  costs = striper->cost_to_replace_extents(ext_size, all);
+  EXPECT_EQ(costs.global_parity_reads, 0);
+  EXPECT_EQ(costs.global_parity_writes, 200);
+  EXPECT_EQ(costs.local_parity_writes, 200);
+  EXPECT_EQ(costs.obsolete_data_reads, 0);
+  EXPECT_EQ(striper->num_times_default, 1);
+}
+
+
+/****************************************
+ * DeviceModel
+ ****************************************/
+TEST(DeviceModelTest, BusyTimeAndLatency) {
+  device_params params;
+  params.read_throughput = 200;
+  params.write_throughput = 100;
+  params.queue_depth = 1;
+  params.base_latency = 1;
+  params.slo_latency = 5;
+  DeviceModel model(params);
+  EXPECT_DOUBLE_EQ(model.latency(0), 1);
+  EXPECT_DOUBLE_EQ(model.latency(0.5), 2);
+
+  // A lightly loaded node with most of the foreground traffic and a busy
+  // one where GC leaves the foreground writes queueing
+  vector<node_cycle_traffic> traffic(2);
+  traffic[0].striping_writes = 90;
+  traffic[1].gc_reads = 1000;
+  traffic[1].gc_writes = 300;
+  traffic[1].striping_writes = 10;
+  for (int i = 0; i < 10; i++)
+    model.add_cycle(traffic, 10);
+  device_result r = model.result();
+  EXPECT_DOUBLE_EQ(r.gc_busy_time, 10 * (5 + 3));
+  EXPECT_DOUBLE_EQ(r.busy_time, 10 * (0.9 + 5 + 3 + 0.1));
+  EXPECT_DOUBLE_EQ(r.max_utilization, 0.81);
+  EXPECT_NEAR(r.latency_p50, model.latency(0.09), 0.05);
+  EXPECT_NEAR(r.latency_p99, model.latency(0.81), 0.05 * model.latency(0.81));
+  EXPECT_DOUBLE_EQ(r.slo_violation, 0.1);
+}
+
+/****************************************
+ * FlashTranslationLayer
+ ****************************************/
+TEST(FtlTest, WriteAmplification) {
+  // 3 blocks of 4 pages for 8 logical pages
+  ftl_params params = {1, 4, 0.5, 8};
+  FlashTranslationLayer ftl(params);
+  EXPECT_EQ(ftl.flash_blocks(), 3);
+  std::uint32_t a = ftl.write_extent(4);
+  std::uint32_t b = ftl.write_extent(4);
+  ftl.trim_extent(a, 4);
+  // Reuses the trimmed extent's logical pages after erasing its block
+  std::uint32_t c = ftl.write_extent(4);
+  EXPECT_EQ(c, a);
+  EXPECT_EQ(ftl.result().erases, 1);
+  EXPECT_DOUBLE_EQ(ftl.result().device_waf, 1);
+  // Fills the last block, then the overwrites of b make the FTL erase the
+  // empty block of the old c and copy the 3 valid pages left of b
+  ftl.rewrite_extent(c, 4, 4);
+  ftl.rewrite_extent(b, 4, 2);
+  ftl_result r = ftl.result();
+  EXPECT_DOUBLE_EQ(r.host_writes, 18);
+  EXPECT_DOUBLE_EQ(r.flash_writes, 21);
+  EXPECT_EQ(r.erases, 3);
+  EXPECT_EQ(r.max_block_erases, 2);
+  EXPECT_EQ(r.extra_blocks, 0);
+
+  // Stripes write their extents to the FTLs of their nodes and trim them
+  // once deleted
+  StripeManager s_m = StripeManager(2, 1, 1, 2, 0);
+  s_m.nodes = make_shared<StorageNodes>(4, placement_policy::round_robin);
+  s_m.nodes->set_ftl({5, 4, 0.25, 40});
+  stripe_ptr s1 = s_m.create_new_stripe(10);
+  EXPECT_EQ(s1->ftl_extents.size(), 6);
+  s_m.nodes->add_gc_traffic(*s1, 0, 20, 0, 10);
+  EXPECT_DOUBLE_EQ(s_m.nodes->get_ftl_result().host_writes, 60 + 20 + 10);
+  s_m.delete_stripe(s1);
+  EXPECT_TRUE(s1->ftl_extents.empty());
+}
 
 /****************************************
  * ObjectPacker
@@ -733,6 +1021,811 @@ TEST(ObjectPackerTest, SimpleObjectPacker) {
   EXPECT_EQ(o_p->get_current_exts()->size(), 1);
 }
 
+TEST(ObjectPackerTest, BatchedGenerationHitsTargets) {
+  // Extents of about 30 mean sized objects, so that objects are sampled and
+  // packed in batches
+  const int ext_size = 1000000;
+  auto sampler = make_shared<SimpleSampler>(365);
+  auto o_m = make_shared<ObjectManager>(make_shared<EventManager>(), sampler);
+  o_m->set_sample_source(make_shared<SampleStream>(sampler, 3));
+  o_m->create_new_object(100);
+  ASSERT_GT(o_m->mean_obj_size(), 0);
+  auto e_m = make_shared<ExtentManager>(ext_size, nullptr);
+  auto pool = make_shared<object_lst>();
+  auto o_p = make_shared<SimpleObjectPacker>(
+      o_m, e_m, pool, make_shared<current_extents>(), 10, 10, false);
+  auto e_s = make_shared<SingleExtentStack<>>(
+      make_shared<StripeManager>(7, 2, 2, 2, 0.0));
+  for (int num_exts : {4, 9, 10}) {
+    o_p->generate_exts_at_key(e_s, num_exts, 0);
+    EXPECT_EQ(e_s->get_length_at_key(0), num_exts);
+  }
+  EXPECT_LT(o_m->get_num_objs(), 100 + 2 * 10 * ext_size / o_m->mean_obj_size());
+
+  const double space = 5.0 * ext_size;
+  auto objs = std::set<obj_ptr>();
+  o_p->pack_objects(e_s, objs);
+  o_p->generate_objs(space);
+  capacity_t generated = 0;
+  for (auto &r : *pool) {
+    generated += r.second;
+  }
+  EXPECT_GE(generated, space);
+  EXPECT_LT(generated, 1.1 * space);
+}
+
+TEST(ObjectPackerTest, MixedObjObjectPackerGenerateExtsAtKeyKeepsRest) {
+  int ext_size = 100;
+  auto o_m =
+      make_shared<ObjectManager>(make_shared<EventManager>(),
+                    make_shared<DeterministicDistributionSampler>(365));
+  auto e_m = make_shared<ExtentManager>(ext_size, nullptr);
+  auto pool = make_shared<object_lst>();
+  auto o_p = make_shared<MixedObjObjectPacker>(
+      o_m, e_m, pool, make_shared<current_extents>(), 10, 10, false);
+  auto e_s = make_shared<SingleExtentStack<>>(
+      make_shared<StripeManager>(7, 2, 2, 2, 0.0));
+  for (int i = 0; i < 10; i++)
+    o_p->add_obj(obj_record(make_shared<ExtentObject>(i, 50, 1), 50));
+  o_p->generate_exts_at_key(e_s, 2, 0);
+  // Four 50 sized objects fill two extents, the rest stays in the pool
+  EXPECT_EQ(e_s->get_length_at_key(0), 2);
+  EXPECT_EQ(pool->size(), 6);
+
+  auto objs = std::set<obj_ptr>();
+  o_p->pack_objects(e_s, objs);
+  EXPECT_EQ(pool->size(), 0);
+  EXPECT_EQ(e_s->get_length_at_key(0), 5);
+}
+
+/****************************************
+ * StripingProcessCoordinator
+ ****************************************/
+TEST(CoordinatorTest, RepackSealedExtentsOncePerCycle) {
+  int ext_size = 100;
+  auto s_m = make_shared<StripeManager>(7, 2, 2, 2, 0.0);
+  auto o_m =
+      make_shared<ObjectManager>(make_shared<EventManager>(),
+                    make_shared<DeterministicDistributionSampler>(365));
+  auto e_m = make_shared<ExtentManager>(ext_size, nullptr);
+  auto o_p = make_shared<SimpleObjectPacker>(
+      o_m, e_m, make_shared<object_lst>(), make_shared<current_extents>(), 10,
+      10, false);
+  auto e_s = make_shared<SingleExtentStack<>>(s_m);
+  auto striper =
+      make_shared<ExtentStackStriper>(make_shared<SimpleStriper>(s_m, e_m));
+  StripingProcessCoordinator coordinator(o_p, o_p, striper, striper, e_s, e_s,
+                                         s_m, 365);
+  vector<obj_ptr> survivors;
+  for (int i = 0; i < 3; i++) {
+    auto survivor = make_shared<ExtentObject>(2 * i, 30, 1);
+    auto dead = make_shared<ExtentObject>(2 * i + 1, 70, 1);
+    ext_ptr e = e_m->create_extent();
+    e->add_object(survivor, 30);
+    e->add_object(dead, 70);
+    e_s->add_extent(0, e);
+    survivors.push_back(survivor);
+
+    e->del_object(dead);
+    coordinator.del_sealed_extent(e);
+    coordinator.object_deleted(dead);
+  }
+  // A survivor that dies before the repack is not written again
+  coordinator.object_deleted(survivors[2]);
+  EXPECT_EQ(e_s->get_length_at_key(0), 0);
+  EXPECT_EQ(o_p->get_current_exts()->size(), 0);
+
+  coordinator.repack_sealed_extents();
+  // The two remaining survivors share a single new extent
+  EXPECT_EQ(e_s->get_length_at_key(0), 0);
+  ASSERT_EQ(o_p->get_current_exts()->size(), 1);
+  ext_ptr current = o_p->get_current_exts()->begin()->second;
+  EXPECT_EQ(current->free_space, 40);
+  EXPECT_EQ(survivors[0]->extents.front(), current);
+  EXPECT_EQ(survivors[1]->extents.front(), current);
+  EXPECT_TRUE(survivors[2]->extents.empty());
+}
+
+TEST(CoordinatorTest, StripingIdleWithoutObjectsOrStripes) {
+  int ext_size = 100;
+  auto s_m = make_shared<StripeManager>(7, 2, 2, 2, 0.0);
+  auto o_m =
+      make_shared<ObjectManager>(make_shared<EventManager>(),
+                    make_shared<DeterministicDistributionSampler>(365));
+  auto e_m = make_shared<ExtentManager>(ext_size, nullptr);
+  auto idle_p = make_shared<SimpleObjectPacker>(
+      o_m, e_m, make_shared<object_lst>(), make_shared<current_extents>(), 0,
+      10, false);
+  auto busy_p = make_shared<SimpleObjectPacker>(
+      o_m, e_m, make_shared<object_lst>(), make_shared<current_extents>(), 10,
+      10, false);
+  auto e_s = make_shared<SingleExtentStack<>>(s_m);
+  auto striper =
+      make_shared<ExtentStackStriper>(make_shared<SimpleStriper>(s_m, e_m));
+  StripingProcessCoordinator idle(idle_p, idle_p, striper, striper, e_s, e_s,
+                                  s_m, 365);
+  StripingProcessCoordinator busy(busy_p, busy_p, striper, striper, e_s, e_s,
+                                  s_m, 365);
+  EXPECT_TRUE(idle.striping_idle());
+  EXPECT_FALSE(busy.striping_idle());
+
+  // Enough sealed extents for a stripe is work even without new objects
+  for (int i = 0; i < s_m->num_data_exts_per_stripe; i++)
+    e_s->add_extent(0, e_m->create_extent());
+  EXPECT_FALSE(idle.striping_idle());
+  idle.generate_stripes();
+  EXPECT_TRUE(idle.striping_idle());
+  EXPECT_EQ(s_m->get_num_stripes(), 1);
+}
+
+/****************************************
+ * GarbageCollectionStrategy
+ ****************************************/
+// Collects a stripe by reclaiming all of its obsolete data for 100 units of
+// GC traffic
+class FixedCostGCStrategy : public GarbageCollectionStrategy {
+public:
+  using GarbageCollectionStrategy::GarbageCollectionStrategy;
+  vector<int> collected;
+
+  stripe_gc_ret stripe_gc(stripe_ptr stripe) override {
+    stripe_gc_ret ret;
+    collected.push_back(stripe->id);
+    ret.temp_space = stripe->obsolete;
+    ret.user_reads = 100;
+    return ret;
+  }
+  gc_handler_ret gc_handler(set<stripe_ptr> &stripe_set) override {
+    return gc_handler_ret();
+  }
+};
+
+TEST(GCStrategyTest, BandwidthBudgetCarriesBacklogOver) {
+  int ext_size = 100;
+  auto s_m = make_shared<StripeManager>(7, 2, 2, 2, 0.0);
+  auto e_m = make_shared<ExtentManager>(ext_size, nullptr);
+  auto striper = make_shared<StriperWithEC>(make_shared<ExtentStackStriper>(
+      make_shared<SimpleStriper>(s_m, e_m)));
+  BandwidthBudgetGCStrategy<FixedCostGCStrategy> strategy(
+      150, 10, 10, e_m, nullptr, striper);
+  set<stripe_ptr> stripe_set;
+  for (int obsolete : {300, 700, 200}) {
+    stripe_ptr s = s_m->create_new_stripe(ext_size);
+    for (int i = 0; i < s->num_slots(); i++) {
+      ext_ptr e = e_m->create_extent();
+      s->add_extent(e);
+      if (i < obsolete / ext_size) {
+        e->obsolete_space = ext_size;
+        s->update_obsolete(ext_size, e->locality);
+      }
+    }
+    stripe_set.insert(s);
+  }
+
+  // Stripes with more obsolete data reclaim more per byte of traffic, and
+  // only one fits into the budget of each cycle
+  gc_handler_ret ret = strategy.gc_handler(stripe_set);
+  EXPECT_EQ(ret.reclaimed_space, 700);
+  EXPECT_EQ(ret.backlog_stripes, 2);
+  EXPECT_EQ(ret.backlog_space, 500);
+  set<stripe_ptr> none;
+  ret = strategy.gc_handler(none);
+  EXPECT_EQ(ret.reclaimed_space, 300);
+  EXPECT_EQ(ret.bandwidth(), 100);
+  EXPECT_EQ(ret.gc_budget, 150);
+  ret = strategy.gc_handler(none);
+  EXPECT_EQ(ret.reclaimed_space, 200);
+  EXPECT_EQ(ret.backlog_stripes, 0);
+  EXPECT_EQ(strategy.collected, vector<int>({2, 1, 3}));
+}
+
+TEST(GCStrategyTest, CostBenefitPrefersOldColdStripes) {
+  int ext_size = 100;
+  auto s_m = make_shared<StripeManager>(7, 2, 2, 2, 0.0);
+  auto e_m = make_shared<ExtentManager>(ext_size, nullptr);
+  auto striper = make_shared<StriperWithEC>(make_shared<ExtentStackStriper>(
+      make_shared<SimpleStriper>(s_m, e_m)));
+  CostBenefitGCStrategy<FixedCostGCStrategy> strategy(1, 10, 10, e_m, nullptr,
+                                                      striper);
+  set<stripe_ptr> stripe_set;
+  vector<std::pair<int, float>> stripes = {{300, 0}, {700, 9}, {200, 0}};
+  for (auto &obsolete_time : stripes) {
+    stripe_ptr s = s_m->create_new_stripe(ext_size);
+    for (int i = 0; i < s->num_slots(); i++) {
+      ext_ptr e = e_m->create_extent();
+      e->timestamp = obsolete_time.second;
+      s->add_extent(e);
+      if (i < obsolete_time.first / ext_size) {
+        e->obsolete_space = ext_size;
+        s->update_obsolete(ext_size, e->locality);
+      }
+    }
+    stripe_set.insert(s);
+  }
+
+  // The young stripe has the most obsolete data but is only picked once it
+  // has aged, without being touched again
+  configtime = 10;
+  strategy.gc_handler(stripe_set);
+  set<stripe_ptr> none;
+  strategy.gc_handler(none);
+  EXPECT_EQ(strategy.num_candidates(), 1);
+  configtime = 30;
+  strategy.gc_handler(none);
+  EXPECT_EQ(strategy.collected, vector<int>({1, 3, 2}));
+  EXPECT_EQ(strategy.num_candidates(), 0);
+  configtime = 0;
+}
+
+TEST(GCStrategyTest, CostBenefitRescoresOlderCandidates) {
+  int ext_size = 100;
+  auto s_m = make_shared<StripeManager>(7, 2, 2, 2, 0.0);
+  auto e_m = make_shared<ExtentManager>(ext_size, nullptr);
+  auto striper = make_shared<StriperWithEC>(make_shared<ExtentStackStriper>(
+      make_shared<SimpleStriper>(s_m, e_m)));
+  CostBenefitGCStrategy<FixedCostGCStrategy> strategy(1, 10, 10, e_m, nullptr,
+                                                      striper);
+  auto make_stripe = [&](int obsolete, float timestamp) {
+    stripe_ptr s = s_m->create_new_stripe(ext_size);
+    for (int i = 0; i < s->num_slots(); i++) {
+      ext_ptr e = e_m->create_extent();
+      e->timestamp = timestamp;
+      s->add_extent(e);
+      if (i < obsolete / ext_size) {
+        e->obsolete_space = ext_size;
+        s->update_obsolete(ext_size, e->locality);
+      }
+    }
+    return s;
+  };
+
+  // The first stripe is scored on day 10 and loses to the second one. The
+  // third one has more obsolete data and is scored on day 20, when it is
+  // younger than the first one has become since it was scored.
+  configtime = 10;
+  set<stripe_ptr> stripe_set = {make_stripe(400, 0),
+                                make_stripe(700, 0)};
+  strategy.gc_handler(stripe_set);
+  configtime = 20;
+  stripe_set = {make_stripe(500, 9)};
+  strategy.gc_handler(stripe_set);
+  set<stripe_ptr> none;
+  strategy.gc_handler(none);
+  EXPECT_EQ(strategy.collected, vector<int>({2, 1, 3}));
+  configtime = 0;
+}
+
+// Stripes whose extents each hold a surviving and a deleted object, along
+// with everything a StripeLevelNoExtsGCStrategy needs to collect them
+struct gc_world {
+  shared_ptr<StripeManager> s_m;
+  shared_ptr<ExtentManager> e_m;
+  shared_ptr<StripeLevelNoExtsGCStrategy> strategy;
+  set<stripe_ptr> stripe_set;
+  vector<obj_ptr> survivors;
+
+  gc_world(int num_stripes) {
+    int ext_size = 100;
+    s_m = make_shared<StripeManager>(7, 2, 2, 2, 0.0);
+    e_m = make_shared<ExtentManager>(ext_size, nullptr);
+    auto o_m = make_shared<ObjectManager>(
+        make_shared<EventManager>(),
+        make_shared<SanityCheckSampler1>(365, ext_size), false);
+    auto o_p = make_shared<SimpleObjectPacker>(
+        o_m, e_m, make_shared<object_lst>(), make_shared<current_extents>(),
+        10, 10, false);
+    auto gc_o_p = make_shared<SimpleGCObjectPacker>(
+        o_m, e_m, make_shared<object_lst>(), make_shared<current_extents>(),
+        10, 10, false);
+    auto striper =
+        make_shared<ExtentStackStriper>(make_shared<SimpleStriper>(s_m, e_m));
+    auto coordinator = make_shared<StripingProcessCoordinator>(
+        o_p, gc_o_p, striper, striper, make_shared<SingleExtentStack<>>(s_m),
+        make_shared<SingleExtentStack<>>(s_m), s_m, 365);
+    strategy = make_shared<StripeLevelNoExtsGCStrategy>(
+        10, 10, e_m, coordinator, striper, s_m);
+    int id = 0;
+    for (int i = 0; i < num_stripes; i++) {
+      stripe_ptr s = s_m->create_new_stripe(ext_size);
+      for (int j = 0; j < s->num_slots(); j++) {
+        ext_ptr e = e_m->create_extent();
+        auto survivor = make_shared<ExtentObject>(id++, 30 + j, 1);
+        auto dead = make_shared<ExtentObject>(id++, 70 - j, 1);
+        e->add_object(survivor, 30 + j);
+        e->add_object(dead, 70 - j);
+        s->add_extent(e);
+        e->del_object(dead);
+        s->update_obsolete(70 - j, e->locality);
+        survivors.push_back(survivor);
+      }
+      stripe_set.insert(s);
+    }
+  }
+
+  // Extent ids every survivor was repacked into
+  vector<vector<int>> placement() {
+    vector<vector<int>> ret;
+    for (auto &obj : survivors) {
+      vector<int> ids;
+      for (auto &e : obj->extents)
+        ids.push_back(e->id);
+      ret.push_back(ids);
+    }
+    return ret;
+  }
+};
+
+TEST(GCStrategyTest, ParallelPlanningMatchesSerialGC) {
+  gc_world serial(40), parallel(40);
+  parallel.strategy->set_thread_pool(make_shared<ThreadPool>(4));
+  gc_handler_ret s_ret = serial.strategy->gc_handler(serial.stripe_set);
+  gc_handler_ret p_ret = parallel.strategy->gc_handler(parallel.stripe_set);
+
+  EXPECT_GT(s_ret.reclaimed_space, 0);
+  EXPECT_EQ(s_ret.reclaimed_space, p_ret.reclaimed_space);
+  EXPECT_EQ(s_ret.total_num_exts_replaced, p_ret.total_num_exts_replaced);
+  EXPECT_EQ(s_ret.total_valid_obj_transfers, p_ret.total_valid_obj_transfers);
+  EXPECT_EQ(s_ret.bandwidth(), p_ret.bandwidth());
+  EXPECT_EQ(serial.stripe_set.size(), parallel.stripe_set.size());
+  EXPECT_EQ(serial.s_m->get_num_stripes(), parallel.s_m->get_num_stripes());
+  EXPECT_EQ(serial.placement(), parallel.placement());
+}
+
+TEST(ThreadPoolTest, ParallelForRunsEveryIndexOnce) {
+  ThreadPool pool(4);
+  for (int round = 0; round < 3; round++) {
+    vector<int> hits(1000, 0);
+    pool.parallel_for(hits.size(), [&](size_t i) { hits[i]++; });
+    EXPECT_EQ(hits, vector<int>(1000, 1));
+  }
+}
+
+/****************************************
+ * DataCenter
+ ****************************************/
+// Object packer whose new objects can be stopped, leaving the data center to
+// drain through its deletions
+class DrainingObjectPacker : public SimpleObjectPacker {
+public:
+  using SimpleObjectPacker::SimpleObjectPacker;
+  void stop_arrivals() { this->num_objs_in_pool = 0; }
+};
+
+// Event handler result of a data center that gets new objects for the first
+// 5 days and then only deletes them until day 30
+eh_result draining_run(bool skip_idle_cycles) {
+  const float simul_time = 30;
+  const float cycle = 1.0 / 12.0;
+  const int ext_size = 3 * 1024;
+  auto mngrs = create_managers(1, 2.0 / 14.0, 2.0 / 14.0, 1,
+                               make_shared<SimpleSampler>(simul_time),
+                               ext_size, &Extent::get_default_key,
+                               18.0 / 14.0);
+  auto s_m = std::get<shared_ptr<StripeManager>>(mngrs);
+  auto e_m = std::get<shared_ptr<ExtentManager>>(mngrs);
+  auto o_m = std::get<shared_ptr<ObjectManager>>(mngrs);
+  auto striper = make_shared<StriperWithEC>(make_shared<ExtentStackStriper>(
+      make_shared<SimpleStriper>(s_m, e_m)));
+  auto gc_striper = make_shared<StriperWithEC>(make_shared<ExtentStackStriper>(
+      make_shared<SimpleStriper>(s_m, e_m)));
+  auto packer = make_shared<DrainingObjectPacker>(
+      o_m, e_m, make_shared<object_lst>(), make_shared<current_extents>(), 20,
+      10, true);
+  auto gc_packer = make_shared<SimpleGCObjectPacker>(
+      o_m, e_m, make_shared<object_lst>(), make_shared<current_extents>(), 20,
+      10, true);
+  auto coordinator = make_shared<StripingProcessCoordinator>(
+      packer, gc_packer, striper, gc_striper,
+      make_shared<SingleExtentStack<>>(s_m),
+      make_shared<SingleExtentStack<>>(s_m), s_m, simul_time);
+  auto gc_strategy = make_shared<StripeLevelNoExtsGCStrategy>(
+      10, 10, e_m, coordinator, gc_striper, s_m);
+  DataCenter dc(1000000000UL, cycle, striper, s_m, e_m, o_m,
+                std::get<shared_ptr<EventManager>>(mngrs), gc_strategy,
+                coordinator, simul_time, cycle);
+  dc.set_sample_stream(7);
+  dc.set_skip_idle_cycles(skip_idle_cycles);
+
+  configtime = 0;
+  dc.start_run();
+  while (dc.running()) {
+    if (configtime >= 5)
+      packer->stop_arrivals();
+    dc.run_cycle();
+    configtime += cycle;
+  }
+  eh_result ret = dc.finish_run();
+  configtime = 0;
+  return ret;
+}
+
+TEST(DataCenterTest, SkippingIdleCyclesKeepsResults) {
+  eh_result skipped = draining_run(true);
+  eh_result run = draining_run(false);
+  EXPECT_GT(run.total_reclaimed_space, 0);
+  EXPECT_EQ(skipped.total_obsolete, run.total_obsolete);
+  EXPECT_EQ(skipped.total_used_space, run.total_used_space);
+  EXPECT_EQ(skipped.dc_size, run.dc_size);
+  EXPECT_EQ(skipped.total_reclaimed_space, run.total_reclaimed_space);
+  EXPECT_EQ(skipped.new_obj_writes, run.new_obj_writes);
+  EXPECT_EQ(skipped.total_global_parity_writes,
+            run.total_global_parity_writes);
+  EXPECT_EQ(skipped.max_obs_perc, run.max_obs_perc);
+  EXPECT_EQ(skipped.obs_percentages, run.obs_percentages);
+}
+
+// Regular runs keep getting new objects, so only their deletion and GC
+// phases are skipped, in the cycles without deletions
+TEST(DataCenterTest, SkippingGCInRegularRunsKeepsResults) {
+  const float simul_time = 20;
+  const float cycle = 1.0 / 12.0;
+  auto sampler = make_shared<SimpleSampler>(simul_time);
+  for (string name : {"stripe_level_with_no_exts_config",
+                      "stripe_level_with_extents_gc_budget_config",
+                      "no_exts_mix_objs_config"}) {
+    SCOPED_TRACE(name);
+    vector<string> metrics;
+    for (bool skip : {true, false}) {
+      DataCenter dc = parse_config(name)(1000000000UL, cycle, simul_time, 3 * 1024, 10, 10,
+                             sampler, 100, cycle, 20);
+      dc.set_sample_stream(7);
+      dc.set_skip_idle_cycles(skip);
+      generator.seed(7);
+      srand(7);
+      sim_metric res = dc.run_simulation();
+      EXPECT_GT(res.total_reclaimed_space, 0);
+      metric_writer writer;
+      visit_metric_fields(res, writer);
+      metrics.push_back(writer.buf);
+    }
+    EXPECT_TRUE(metrics[0] == metrics[1]);
+  }
+}
+
+TEST(DataCenterTest, SamplePipelineKeepsResults) {
+  const float simul_time = 20;
+  const float cycle = 1.0 / 12.0;
+  auto sampler = make_shared<SimpleSampler>(simul_time);
+  vector<string> metrics;
+  for (bool pipelined : {true, false}) {
+    DataCenter dc = stripe_level_with_no_exts_config(
+        1000000000UL, cycle, simul_time, 3 * 1024, 10, 10, sampler, 100, cycle,
+        20);
+    dc.set_sample_pipeline(pipelined);
+    generator.seed(7);
+    srand(7);
+    sim_metric res = dc.run_simulation();
+    EXPECT_GT(res.num_objs, 0);
+    metric_writer writer;
+    visit_metric_fields(res, writer);
+    metrics.push_back(writer.buf);
+  }
+  EXPECT_TRUE(metrics[0] == metrics[1]);
+}
+
+// Stripe level GC that adds up the GC traffic of every cycle
+class GCTrafficCountingStrategy : public StripeLevelNoExtsGCStrategy {
+public:
+  using StripeLevelNoExtsGCStrategy::StripeLevelNoExtsGCStrategy;
+  capacity_t gc_traffic = 0;
+
+  gc_handler_ret gc_handler(set<stripe_ptr> &stripe_set) override {
+    gc_handler_ret ret = StripeLevelNoExtsGCStrategy::gc_handler(stripe_set);
+    gc_traffic += ret.bandwidth();
+    return ret;
+  }
+};
+
+TEST(DataCenterTest, NodeGCTrafficAddsUpToGCBandwidth) {
+  const float simul_time = 20;
+  const float cycle = 1.0 / 12.0;
+  const int ext_size = 3 * 1024;
+  // The coding overhead follows from the parities, so that the striping
+  // costs match the extents placed on the nodes
+  auto mngrs = create_managers(4, 1, 1, 1,
+                               make_shared<SimpleSampler>(simul_time),
+                               ext_size, &Extent::get_default_key);
+  auto s_m = std::get<shared_ptr<StripeManager>>(mngrs);
+  auto e_m = std::get<shared_ptr<ExtentManager>>(mngrs);
+  auto o_m = std::get<shared_ptr<ObjectManager>>(mngrs);
+  auto striper = make_shared<StriperWithEC>(make_shared<ExtentStackStriper>(
+      make_shared<SimpleStriper>(s_m, e_m)));
+  auto gc_striper = make_shared<StriperWithEC>(make_shared<ExtentStackStriper>(
+      make_shared<SimpleStriper>(s_m, e_m)));
+  auto coordinator = make_shared<StripingProcessCoordinator>(
+      make_shared<SimpleObjectPacker>(o_m, e_m, make_shared<object_lst>(),
+                                      make_shared<current_extents>(), 20, 10,
+                                      true),
+      make_shared<SimpleGCObjectPacker>(o_m, e_m, make_shared<object_lst>(),
+                                        make_shared<current_extents>(), 20, 10,
+                                        true),
+      striper, gc_striper, make_shared<SingleExtentStack<>>(s_m),
+      make_shared<SingleExtentStack<>>(s_m), s_m, simul_time);
+  auto gc_strategy = make_shared<GCTrafficCountingStrategy>(
+      10, 10, e_m, coordinator, gc_striper, s_m);
+  DataCenter dc(1000000000UL, cycle, striper, s_m, e_m, o_m,
+                std::get<shared_ptr<EventManager>>(mngrs), gc_strategy,
+                coordinator, simul_time, cycle);
+  auto nodes = make_shared<StorageNodes>(30, placement_policy::round_robin);
+  dc.set_storage_nodes(nodes);
+  dc.set_sample_stream(7);
+  dc.event_handler();
+  configtime = 0;
+
+  // Collected stripes are rewritten to new stripes, whose placement charges
+  // the GC writes to the nodes
+  long double node_gc_traffic = 0;
+  for (auto &node : nodes->get_nodes())
+    node_gc_traffic += node.gc_traffic;
+  ASSERT_GT(gc_strategy->gc_traffic, 0);
+  EXPECT_NEAR(node_gc_traffic, gc_strategy->gc_traffic,
+              1e-6 * gc_strategy->gc_traffic);
+}
+
+/****************************************
+ * ShardedDataCenter
+ ****************************************/
+TEST(ShardedDataCenterTest, MergedMetricsAddUpOverShards) {
+  const float simul_time = 20;
+  const float cycle = 1.0 / 12.0;
+  auto sampler = make_shared<SimpleSampler>(simul_time);
+  vector<unsigned long> shard_sizes;
+  vector<int> shard_objs;
+  auto make_shard = [&](unsigned long size, int num_objs) {
+    shard_sizes.push_back(size);
+    shard_objs.push_back(num_objs);
+    return stripe_level_with_no_exts_config(size, cycle, simul_time, 3 * 1024,
+                                            10, 10, sampler, 100, cycle,
+                                            num_objs);
+  };
+  ShardedDataCenter dc(3, 3000000000UL, 100, make_shard, 7);
+  EXPECT_EQ(shard_sizes, vector<unsigned long>(3, 1000000000UL));
+  EXPECT_EQ(shard_objs, (vector<int>{34, 33, 33}));
+
+  sim_metric res = dc.run_simulation();
+  auto &shards = dc.get_shard_metrics();
+  int num_objs = 0;
+  unsigned long dc_size = 0;
+  long double gc_bandwidth = 0;
+  double user_bandwidth = 0;
+  for (auto &m : shards) {
+    EXPECT_GT(m.num_objs, 0);
+    num_objs += m.num_objs;
+    dc_size += m.dc_size;
+    gc_bandwidth += m.total_gc_bandwidth;
+    user_bandwidth += m.total_user_data_reads + m.total_user_data_writes;
+    EXPECT_EQ(m.obs_percentages.size(), res.obs_percentages.size());
+  }
+  EXPECT_EQ(res.num_objs, num_objs);
+  EXPECT_EQ(res.dc_size, dc_size);
+  EXPECT_DOUBLE_EQ(res.total_gc_bandwidth, gc_bandwidth);
+  EXPECT_DOUBLE_EQ(res.gc_ratio, gc_bandwidth / user_bandwidth);
+  EXPECT_EQ(dc.imbalance(&sim_metric::num_objs).mean, num_objs / 3.0);
+}
+
+TEST(ShardedDataCenterTest, SampledLanesScaleUpWithErrorBounds) {
+  const float simul_time = 20;
+  const float cycle = 1.0 / 12.0;
+  auto sampler = make_shared<SimpleSampler>(simul_time);
+  vector<unsigned long> lane_sizes;
+  vector<int> lane_objs;
+  auto make_lane = [&](unsigned long size, int num_objs) {
+    lane_sizes.push_back(size);
+    lane_objs.push_back(num_objs);
+    return stripe_level_with_no_exts_config(size, cycle, simul_time, 3 * 1024,
+                                            10, 10, sampler, 100, cycle,
+                                            num_objs);
+  };
+  ShardedDataCenter dc(3, 8000000000UL, 400, make_lane, 7, 8);
+  EXPECT_TRUE(dc.sampled());
+  EXPECT_EQ(lane_sizes, vector<unsigned long>(3, 1000000000UL));
+  EXPECT_EQ(lane_objs, vector<int>(3, 50));
+
+  sim_metric res = dc.run_simulation();
+  EXPECT_EQ(res.num_lanes, 8);
+  EXPECT_EQ(res.sampled_lanes, 3);
+  int num_objs = 0;
+  for (auto &m : dc.get_shard_metrics())
+    num_objs += m.num_objs;
+  EXPECT_NEAR(res.num_objs, num_objs * 8 / 3.0, 1);
+  for (string key : {"gc ratio", "obsolete percentage", "gc bandwidth",
+                     "dc size"}) {
+    ASSERT_TRUE(res.error_bounds.count(key)) << key;
+    EXPECT_GE(res.error_bounds[key], 0) << key;
+  }
+  EXPECT_GT(res.error_bounds["dc size"], 0);
+  EXPECT_LT(res.error_bounds["dc size"], res.dc_size);
+}
+
+TEST(ShardedDataCenterTest, MergedMetricsDoNotDependOnThreads) {
+  const float simul_time = 10;
+  const float cycle = 1.0 / 12.0;
+  auto sampler = make_shared<SimpleSampler>(simul_time);
+  for (auto &config : config_registry) {
+    SCOPED_TRACE(config.first);
+    auto make_shard = [&](unsigned long size, int num_objs) {
+      return config.second(size, cycle, simul_time, 3 * 1024, 10, 10, sampler,
+                           100, cycle, num_objs);
+    };
+    vector<string> merged;
+    for (unsigned num_threads : {1, 3}) {
+      ShardedDataCenter dc(3, 1500000000UL, 60, make_shard, 7, 0,
+                           num_threads);
+      sim_metric res = dc.run_simulation();
+      EXPECT_GT(res.num_objs, 0);
+      metric_writer writer;
+      visit_metric_fields(res, writer);
+      merged.push_back(writer.buf);
+    }
+    EXPECT_TRUE(merged[0] == merged[1]);
+  }
+}
+
+TEST(ShardedDataCenterTest, SampledLanesDoNotDependOnThreads) {
+  const float simul_time = 10;
+  const float cycle = 1.0 / 12.0;
+  auto sampler = make_shared<SimpleSampler>(simul_time);
+  for (auto config : {no_exts_mix_objs_config,
+                      stripe_level_with_extents_separate_pools_config}) {
+    auto make_lane = [&](unsigned long size, int num_objs) {
+      return config(size, cycle, simul_time, 3 * 1024, 10, 10, sampler, 100,
+                    cycle, num_objs);
+    };
+    vector<string> merged;
+    for (unsigned num_threads : {1, 3}) {
+      ShardedDataCenter dc(3, 4000000000UL, 160, make_lane, 7, 8,
+                           num_threads);
+      sim_metric res = dc.run_simulation();
+      EXPECT_EQ(res.sampled_lanes, 3);
+      EXPECT_GT(res.num_objs, 0);
+      EXPECT_GT(res.error_bounds["dc size"], 0);
+      EXPECT_LT(res.error_bounds["dc size"], res.dc_size);
+      metric_writer writer;
+      visit_metric_fields(res, writer);
+      merged.push_back(writer.buf);
+    }
+    EXPECT_TRUE(merged[0] == merged[1]);
+  }
+}
+
+// Simple sampler that can only sample in batches
+class BatchSampler : public SimpleSampler {
+public:
+  using SimpleSampler::SimpleSampler;
+  bool streamable() override { return false; }
+};
+
+TEST(ShardedDataCenterTest, RejectsBatchSamplers) {
+  auto sampler = make_shared<BatchSampler>(20);
+  auto make_shard = [&](unsigned long size, int num_objs) {
+    return stripe_level_with_no_exts_config(size, 1.0 / 12.0, 20, 3 * 1024,
+                                            10, 10, sampler, 100, 1.0 / 12.0,
+                                            num_objs);
+  };
+  EXPECT_EXIT(ShardedDataCenter(3, 3000000000UL, 100, make_shard, 7),
+              ::testing::ExitedWithCode(1), "one object at a time");
+}
+
+TEST(ShardedDataCenterTest, Imbalance) {
+  shard_imbalance s = get_imbalance({1, 2, 3});
+  EXPECT_DOUBLE_EQ(s.mean, 2);
+  EXPECT_DOUBLE_EQ(s.min, 1);
+  EXPECT_DOUBLE_EQ(s.max, 3);
+  EXPECT_DOUBLE_EQ(s.cv, std::sqrt(2.0 / 3.0) / 2);
+  EXPECT_DOUBLE_EQ(s.max_over_mean, 1.5);
+}
+
+/****************************************
+ * What-if branches
+ ****************************************/
+TEST(WhatIfTest, BranchesRunFromWarmedUpState) {
+  const float simul_time = 20;
+  const float cycle = 1.0 / 12.0;
+  auto sampler = make_shared<SimpleSampler>(simul_time);
+  DataCenter dc = stripe_level_with_no_exts_config(
+      1000000000UL, cycle, simul_time, 3 * 1024, 10, 10, sampler, 100, cycle,
+      40);
+  dc.set_sample_stream(7, true);
+  vector<what_if_branch> branches = {threshold_branch(10, 10),
+                                     threshold_branch(50, 50),
+                                     threshold_branch(90, 90)};
+  auto results = run_what_if(dc, 10, branches, 2);
+
+  // The parent stays at the end of the warm-up
+  EXPECT_GE(configtime, 10);
+  EXPECT_LT(configtime, 10 + cycle * 2);
+  ASSERT_EQ(results.size(), 3);
+  for (size_t i = 0; i < results.size(); i++) {
+    EXPECT_TRUE(results[i].ok);
+    EXPECT_EQ(results[i].name, branches[i].name);
+    EXPECT_GT(results[i].metric.num_objs, 0);
+    EXPECT_GT(results[i].metric.obs_percentages.size(), 0);
+  }
+  // A higher threshold leaves more obsolete data behind
+  EXPECT_LT(results[0].metric.total_obsolete, results[2].metric.total_obsolete);
+}
+
+TEST(WhatIfTest, MetricRoundTrip) {
+  sim_metric m;
+  m.gc_amplification = 3;
+  m.total_gc_bandwidth = 1.5e12;
+  m.obs_percentages = {1.0, 2.5};
+  m.types["small"] = 4;
+  m.obs_by_ext_types["large"] = 0.25;
+  metric_writer writer;
+  visit_metric_fields(m, writer);
+
+  sim_metric r;
+  metric_reader reader(writer.buf);
+  visit_metric_fields(r, reader);
+  EXPECT_TRUE(reader.ok && reader.at_end());
+  EXPECT_EQ(r.gc_amplification, 3);
+  EXPECT_EQ(r.total_gc_bandwidth, m.total_gc_bandwidth);
+  EXPECT_EQ(r.obs_percentages, m.obs_percentages);
+  EXPECT_EQ(r.types, m.types);
+  EXPECT_EQ(r.obs_by_ext_types, m.obs_by_ext_types);
+
+  // Truncated input is detected
+  string truncated = writer.buf.substr(0, writer.buf.size() - 1);
+  metric_reader short_reader(truncated);
+  visit_metric_fields(r, short_reader);
+  EXPECT_FALSE(short_reader.ok);
+}
+
+/****************************************
+ * SteadyStateMonitor
+ ****************************************/
+TEST(SteadyStateTest, ConvergesOnceMetricsLevelOff) {
+  SteadyStateMonitor monitor(12, 8, 0.02, 30);
+  std::mt19937 rng(1);
+  std::normal_distribution<double> noise(0, 0.5);
+  double time = 0;
+  // Obsolete percentage climbs for 100 days and then levels off at 20%
+  for (; time < 100; time += 1.0 / 12) {
+    monitor.add_cycle(time, time / 5 + noise(rng), 3e6, 1e7);
+    ASSERT_FALSE(monitor.converged()) << time;
+  }
+  for (; time < 365 && !monitor.converged(); time += 1.0 / 12)
+    monitor.add_cycle(time, 20 + noise(rng), 3e6 + 1e5 * noise(rng), 1e7);
+
+  ASSERT_TRUE(monitor.converged());
+  steady_state_result res = monitor.result();
+  EXPECT_GT(res.time, 100);
+  EXPECT_LT(res.time, 100 + 8 * 2);
+  EXPECT_NEAR(res.obs_perc.mean, 20, res.obs_perc.error + 0.1);
+  EXPECT_LE(res.obs_perc.error, 0.02 * 20);
+  EXPECT_NEAR(res.gc_ratio.mean, 0.3, 0.01);
+}
+
+/****************************************
+ * TimeSeriesWriter
+ ****************************************/
+TEST(TimeSeriesTest, WritesAllRowsInOrder) {
+  const string filename = "time_series_test.csv";
+  {
+    TimeSeriesWriter writer(filename, 3);
+    for (int i = 0; i < 10; i++) {
+      cycle_record rec;
+      rec.time = i;
+      rec.num_stripes = i * 2;
+      writer.append(rec);
+    }
+    writer.close();
+  }
+  std::ifstream in(filename);
+  string line;
+  std::getline(in, line);
+  EXPECT_EQ(line.substr(0, 5), "time,");
+  int rows = 0;
+  while (std::getline(in, line)) {
+    EXPECT_EQ(std::stoi(line.substr(0, line.find(','))), rows);
+    EXPECT_EQ(std::stoi(line.substr(line.rfind(',') + 1)), rows * 2);
+    rows++;
+  }
+  EXPECT_EQ(rows, 10);
+  std::remove(filename.c_str());
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,100 @@
+#ifndef __THREAD_POOL_H_
+#define __THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Fixed set of worker threads for data parallel loops. parallel_for hands
+ * out the indices of a loop one at a time to the workers and to the calling
+ * thread, and returns once all of them are done, so the caller sees the
+ * results of every iteration afterwards. Only one loop runs at a time.
+ */
+class ThreadPool {
+  std::vector<std::thread> workers;
+  std::mutex mtx;
+  std::condition_variable work_cv, done_cv;
+  bool stopping = false;
+  // Loop currently being run and the number of workers still inside it
+  std::function<void(size_t)> body;
+  size_t num_iterations = 0;
+  std::atomic<size_t> next_index{0};
+  unsigned long generation = 0;
+  int busy_workers = 0;
+
+  void run_iterations() {
+    size_t i;
+    while ((i = next_index.fetch_add(1)) < num_iterations)
+      body(i);
+  }
+
+  void worker_loop() {
+    unsigned long seen = 0;
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+      work_cv.wait(lock, [&] { return stopping || generation != seen; });
+      if (stopping)
+        break;
+      seen = generation;
+      lock.unlock();
+      run_iterations();
+      lock.lock();
+      if (--busy_workers == 0)
+        done_cv.notify_one();
+    }
+  }
+
+public:
+  ThreadPool(unsigned num_threads) {
+    // The calling thread takes part in every loop
+    for (unsigned i = 1; i < num_threads; i++)
+      workers.emplace_back(&ThreadPool::worker_loop, this);
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      stopping = true;
+    }
+    work_cv.notify_all();
+    for (auto &w : workers)
+      w.join();
+  }
+
+  unsigned num_threads() { return workers.size() + 1; }
+
+  /*
+   * Calls fn(i) for every i in [0, n). Iterations may run in any order and
+   * concurrently, so fn must only write to state owned by its index.
+   */
+  template <typename Fn> void parallel_for(size_t n, Fn &&fn) {
+    if (workers.empty() || n < 2) {
+      for (size_t i = 0; i < n; i++)
+        fn(i);
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      body = std::ref(fn);
+      num_iterations = n;
+      next_index = 0;
+      busy_workers = workers.size();
+      generation++;
+    }
+    work_cv.notify_all();
+    run_iterations();
+    std::unique_lock<std::mutex> lock(mtx);
+    done_cv.wait(lock, [this] { return busy_workers == 0; });
+    body = nullptr;
+  }
+};
+
+#endif // __THREAD_POOL_H_
@@ -0,0 +1,135 @@
+#ifndef __TIME_SERIES_H_
+#define __TIME_SERIES_H_
+
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Metrics sampled at the end of a single event_handler cycle
+struct cycle_record {
+  double time = 0;
+  double obs_perc = 0;
+  double dc_size = 0;
+  double used_space = 0;
+  double added_obsolete = 0;
+  double reclaimed_space = 0;
+  double gc_bandwidth = 0;
+  double user_writes = 0;
+  int num_exts_gced = 0;
+  // Fraction of the GC budget spent and the obsolete space and stripes left
+  // in the backlog, for budgeted GC strategies
+  double gc_budget_utilization = 0;
+  double gc_backlog = 0;
+  long gc_backlog_stripes = 0;
+  // GC traffic of the busiest storage node, if the nodes are modelled
+  double max_node_gc_traffic = 0;
+  int num_stripes = 0;
+};
+
+/*
+ * Append-only CSV sink for per-cycle metrics. The simulation thread only
+ * appends rows to an in-memory buffer; full buffers are handed to a
+ * background writer thread, so the event loop never waits on file I/O.
+ */
+class TimeSeriesWriter {
+  std::ofstream file;
+  std::vector<cycle_record> buffer;
+  std::vector<cycle_record> pending;
+  size_t batch_size;
+  std::mutex mtx;
+  std::condition_variable cv;
+  bool stopping;
+  std::thread writer;
+
+  void write_rows(const std::vector<cycle_record> &rows) {
+    for (auto &r : rows) {
+      file << r.time << "," << r.obs_perc << "," << r.dc_size << ","
+           << r.used_space << "," << r.added_obsolete << ","
+           << r.reclaimed_space << "," << r.gc_bandwidth << ","
+           << r.user_writes << "," << r.num_exts_gced << ","
+           << r.gc_budget_utilization << "," << r.gc_backlog << ","
+           << r.gc_backlog_stripes << "," << r.max_node_gc_traffic << ","
+           << r.num_stripes << "\n";
+    }
+  }
+
+  void writer_loop() {
+    std::vector<cycle_record> rows;
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+      cv.wait(lock, [this] { return stopping || !pending.empty(); });
+      if (pending.empty() && stopping)
+        break;
+      rows.swap(pending);
+      lock.unlock();
+      write_rows(rows);
+      rows.clear();
+      lock.lock();
+    }
+    file.flush();
+  }
+
+public:
+  TimeSeriesWriter(const std::string &filename, size_t batch_size = 4096)
+      : file(filename), batch_size(batch_size), stopping(false) {
+    buffer.reserve(batch_size);
+    file << std::setprecision(10);
+    file << "time,obsolete percentage,dc size,used space,added obsolete,"
+            "reclaimed space,gc bandwidth,user writes,exts gced,"
+            "gc budget utilization,gc backlog,gc backlog stripes,"
+            "max node gc traffic,number of stripes\n";
+    writer = std::thread(&TimeSeriesWriter::writer_loop, this);
+  }
+
+  TimeSeriesWriter(const TimeSeriesWriter &) = delete;
+  TimeSeriesWriter &operator=(const TimeSeriesWriter &) = delete;
+
+  ~TimeSeriesWriter() { close(); }
+
+  void append(const cycle_record &r) {
+    buffer.push_back(r);
+    if (buffer.size() >= batch_size)
+      flush();
+  }
+
+  /*
+   * Hands the buffered rows to the writer thread. If the writer is still
+   * busy with the previous batch, the rows are queued behind it instead of
+   * waiting for it to finish.
+   */
+  void flush() {
+    if (buffer.empty())
+      return;
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      if (pending.empty())
+        pending.swap(buffer);
+      else
+        pending.insert(pending.end(), buffer.begin(), buffer.end());
+    }
+    buffer.clear();
+    cv.notify_one();
+  }
+
+  /*
+   * Flushes the remaining rows and joins the writer thread.
+   */
+  void close() {
+    if (!writer.joinable())
+      return;
+    flush();
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      stopping = true;
+    }
+    cv.notify_one();
+    writer.join();
+    file.close();
+  }
+};
+
+#endif // __TIME_SERIES_H_
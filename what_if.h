@@ -0,0 +1,314 @@
+#ifndef __WHAT_IF_H_
+#define __WHAT_IF_H_
+
+#include "config.h"
+#include "data_center.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <sys/wait.h>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+using std::function;
+using std::string;
+using std::vector;
+
+/*
+ * Flat byte encoding of a sim_metric, used to send the metrics of a forked
+ * branch back to its parent. Both directions go through
+ * visit_metric_fields, so the writer and the reader always agree on the
+ * layout.
+ */
+class metric_writer {
+public:
+  string buf;
+
+  template <typename T>
+  typename std::enable_if<std::is_arithmetic<T>::value>::type
+  operator()(const T &v) {
+    buf.append(reinterpret_cast<const char *>(&v), sizeof(T));
+  }
+
+  void operator()(const string &s) {
+    (*this)(s.size());
+    buf.append(s);
+  }
+
+  template <typename T> void operator()(const vector<T> &v) {
+    (*this)(v.size());
+    for (auto &e : v)
+      (*this)(e);
+  }
+
+  template <typename T> void operator()(const unordered_map<string, T> &m) {
+    (*this)(m.size());
+    for (auto &it : m) {
+      (*this)(it.first);
+      (*this)(it.second);
+    }
+  }
+};
+
+class metric_reader {
+  const string &buf;
+  size_t pos = 0;
+
+public:
+  // Turns false once the reader runs out of bytes
+  bool ok = true;
+
+  metric_reader(const string &buf) : buf(buf) {}
+
+  bool at_end() { return pos == buf.size(); }
+
+  template <typename T>
+  typename std::enable_if<std::is_arithmetic<T>::value>::type
+  operator()(T &v) {
+    if (!ok || buf.size() - pos < sizeof(T)) {
+      ok = false;
+      return;
+    }
+    memcpy(&v, buf.data() + pos, sizeof(T));
+    pos += sizeof(T);
+  }
+
+  void operator()(string &s) {
+    size_t n = 0;
+    (*this)(n);
+    if (!ok || buf.size() - pos < n) {
+      ok = false;
+      return;
+    }
+    s.assign(buf, pos, n);
+    pos += n;
+  }
+
+  template <typename T> void operator()(vector<T> &v) {
+    size_t n = 0;
+    (*this)(n);
+    v.clear();
+    for (size_t i = 0; i < n && ok; i++) {
+      T e{};
+      (*this)(e);
+      v.push_back(e);
+    }
+  }
+
+  template <typename T> void operator()(unordered_map<string, T> &m) {
+    size_t n = 0;
+    (*this)(n);
+    m.clear();
+    for (size_t i = 0; i < n && ok; i++) {
+      string key;
+      T val{};
+      (*this)(key);
+      (*this)(val);
+      m[key] = val;
+    }
+  }
+};
+
+template <typename Metric, typename Visitor>
+void visit_metric_fields(Metric &m, Visitor &v) {
+  v(m.gc_amplification);
+  v(m.total_obsolete);
+  v(m.total_used_space);
+  v(m.obs_percentages);
+  v(m.max_obs_perc);
+  v(m.gc_ratio);
+  v(m.total_reclaimed_space);
+  v(m.parity_reads);
+  v(m.parity_writes);
+  v(m.total_user_data_reads);
+  v(m.total_user_data_writes);
+  v(m.total_gc_bandwidth);
+  v(m.total_bandwidth);
+  v(m.total_absent_data_reads);
+  v(m.total_obsolete_data_reads);
+  v(m.total_pool_to_parity_calculator);
+  v(m.total_parity_calculator_to_storage_node);
+  v(m.total_storage_node_to_parity_calculator);
+  v(m.num_objs);
+  v(m.num_exts);
+  v(m.num_stripes);
+  v(m.dc_size);
+  v(m.total_leftovers);
+  v(m.ave_exts_gced);
+  v(m.types);
+  v(m.cost_by_ext);
+  v(m.obs_by_ext_types);
+  v(m.gced_by_type);
+  v(m.gc_budget_utilization);
+  v(m.max_gc_backlog);
+  v(m.steady_state.converged);
+  v(m.steady_state.time);
+  v(m.steady_state.obs_perc.mean);
+  v(m.steady_state.obs_perc.error);
+  v(m.steady_state.gc_ratio.mean);
+  v(m.steady_state.gc_ratio.error);
+  v(m.num_lanes);
+  v(m.sampled_lanes);
+  v(m.error_bounds);
+  v(m.peak_node_traffic);
+  v(m.peak_node_gc_traffic);
+  v(m.node_gc_imbalance);
+  v(m.device.busy_time);
+  v(m.device.gc_busy_time);
+  v(m.device.max_utilization);
+  v(m.device.latency_p50);
+  v(m.device.latency_p99);
+  v(m.device.latency_p999);
+  v(m.device.slo_violation);
+  v(m.ftl.host_writes);
+  v(m.ftl.flash_writes);
+  v(m.ftl.device_waf);
+  v(m.ftl.end_to_end_waf);
+  v(m.ftl.erases);
+  v(m.ftl.max_block_erases);
+  v(m.ftl.mean_block_erases);
+  v(m.ftl.extra_blocks);
+}
+
+// One variation of the warmed-up data center to run to completion
+struct what_if_branch {
+  string name;
+  function<void(DataCenter &)> apply;
+};
+
+struct what_if_result {
+  string name;
+  // False if the branch did not run to completion or its metrics got lost
+  bool ok = false;
+  sim_metric metric;
+};
+
+// Branch that collects with different GC thresholds
+inline what_if_branch threshold_branch(short primary_threshold,
+                                       short secondary_threshold) {
+  return {std::to_string(primary_threshold) + "-" +
+              std::to_string(secondary_threshold),
+          [=](DataCenter &dc) {
+            dc.set_gc_thresholds(primary_threshold, secondary_threshold);
+          }};
+}
+
+/*
+ * Runs the data center up to warmup_time, then fork()s a child process per
+ * branch that applies the branch to its copy of the data center and runs
+ * it to the end of the simulation. The children share the warmed-up state
+ * copy-on-write, so the warm-up is simulated once and every branch only
+ * copies the pages it changes. Each child sends its metrics back through a
+ * pipe.
+ *
+ * At most max_children branches run at the same time, 0 runs all of them
+ * at once. The data center itself is left at the end of the warm-up.
+ */
+inline vector<what_if_result>
+run_what_if(DataCenter &dc, float warmup_time,
+            const vector<what_if_branch> &branches, int max_children = 0) {
+  configtime = 0.0;
+  dc.start_run();
+  while (dc.running() && configtime < warmup_time) {
+    dc.run_cycle();
+    configtime += dc.get_gc_cycle();
+  }
+  // fork() only copies the calling thread, and buffered output would be
+  // printed once by every child
+  dc.pause_threads();
+  fflush(stdout);
+  cout.flush();
+
+  struct child {
+    size_t branch;
+    pid_t pid;
+    int fd;
+  };
+  vector<what_if_result> results(branches.size());
+  vector<child> children;
+  if (max_children <= 0)
+    max_children = branches.size();
+
+  auto reap = [&](child &c) {
+    string buf;
+    char chunk[4096];
+    ssize_t n;
+    while ((n = read(c.fd, chunk, sizeof(chunk))) != 0) {
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0)
+        break;
+      buf.append(chunk, n);
+    }
+    close(c.fd);
+    int status = 0;
+    waitpid(c.pid, &status, 0);
+    what_if_result &res = results[c.branch];
+    metric_reader reader(buf);
+    visit_metric_fields(res.metric, reader);
+    res.ok = WIFEXITED(status) && WEXITSTATUS(status) == 0 && reader.ok &&
+             reader.at_end();
+    if (!res.ok)
+      cerr << "What-if branch " << res.name << " failed" << endl;
+  };
+
+  for (size_t i = 0; i < branches.size(); i++) {
+    results[i].name = branches[i].name;
+    if ((int)children.size() == max_children) {
+      reap(children.front());
+      children.erase(children.begin());
+    }
+    int fds[2];
+    if (pipe(fds) != 0) {
+      perror("pipe");
+      continue;
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+      perror("fork");
+      close(fds[0]);
+      close(fds[1]);
+      continue;
+    }
+    if (pid == 0) {
+      close(fds[0]);
+      cout << "What-if branch " << branches[i].name << endl;
+      branches[i].apply(dc);
+      dc.resume_threads();
+      while (dc.running()) {
+        dc.run_cycle();
+        configtime += dc.get_gc_cycle();
+      }
+      sim_metric m = dc.get_sim_metric(dc.finish_run());
+      metric_writer writer;
+      visit_metric_fields(m, writer);
+      const char *p = writer.buf.data();
+      size_t left = writer.buf.size();
+      while (left > 0) {
+        ssize_t n = write(fds[1], p, left);
+        if (n < 0 && errno == EINTR)
+          continue;
+        if (n < 0)
+          _exit(1);
+        p += n;
+        left -= n;
+      }
+      close(fds[1]);
+      fflush(stdout);
+      cout.flush();
+      // Skip the destructors and exit handlers of the parent's state
+      _exit(0);
+    }
+    close(fds[1]);
+    children.push_back({i, pid, fds[0]});
+  }
+  for (auto &c : children)
+    reap(c);
+  dc.resume_threads();
+  return results;
+}
+
+#endif // __WHAT_IF_H_